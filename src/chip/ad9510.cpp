@@ -5,11 +5,15 @@
 //============================================================================
 #include "ad9510.h"
 
+#include <algorithm>
+
 #define MAX_REPEAT 10
 
 wb_data AD9510_drv::data_;
 commLink* AD9510_drv::commLink_;
 string AD9510_drv::spi_id_;
+map<uint32_t, struct ad9510_regs> AD9510_drv::regs_;
+map<vector<uint64_t>, struct ad9510_pll_plan> AD9510_drv::plans_;
 
 void AD9510_drv::AD9510_setCommLink(commLink* comm, string spi_id) {
 
@@ -20,7 +24,7 @@ void AD9510_drv::AD9510_setCommLink(commLink* comm, string spi_id) {
 
 }
 
-wb_data AD9510_drv::AD9510_spi_write(uint32_t chip_select, uint8_t reg, uint8_t val) {
+int AD9510_drv::AD9510_spi_write(uint32_t chip_select, uint8_t reg, uint8_t val) {
 
   //data->data_read.clear();
   //data_.data_read.clear();
@@ -37,13 +41,13 @@ wb_data AD9510_drv::AD9510_spi_write(uint32_t chip_select, uint8_t reg, uint8_t
   //data_.data_send[2] = 0x00;// instruction header (write)
 
   //return spi_int->int_send_data(&data_);
-  commLink_->fmc_send(spi_id_,&data_);
-
-  return data_;
+  return commLink_->fmc_send(spi_id_,&data_);
 
 }
 
-wb_data AD9510_drv::AD9510_spi_read(uint32_t chip_select, uint8_t reg) {
+int AD9510_drv::AD9510_spi_read(uint32_t chip_select, uint8_t reg, uint8_t* val) {
+
+  int err;
 
   data_.data_read.clear();
 
@@ -59,25 +63,164 @@ wb_data AD9510_drv::AD9510_spi_read(uint32_t chip_select, uint8_t reg) {
 
   //cout << "data1234 " << hex << data_.data_send[0] << endl;
 
-  commLink_->fmc_send_read(spi_id_,&data_);
+  err = commLink_->fmc_send_read(spi_id_,&data_);
+  if (err)
+    return err;
+
+  if (data_.data_read.empty())
+    return 1;
+
+  *val = data_.data_read[0] & 0xFF;
+
+  return 0;
+
+}
+
+// Streaming transfer (W1:W0 = 11 for more than 3 bytes), MSB first
+// bytes - data bytes in transfer order (from address addr down)
+// whole transfer (instruction + data) is packed to TX regs, first byte in
+// highest bits, received bytes are in the same positions of RX regs
+void AD9510_drv::AD9510_stream_frame(uint32_t chip_select, int rd, uint16_t addr,
+    const vector<uint8_t>& bytes, wb_data* data) {
+
+  unsigned int i, bits, pos, num = bytes.size();
+  uint16_t instr;
+
+  instr = (rd ? 0x8000 : 0x0000) | ((num > 3 ? 3 : num - 1) << 13) | (addr & 0x1FFF);
+  bits = 16 + 8 * num;
+
+  data->extra.resize(2);
+  data->extra[0] = chip_select;
+  data->extra[1] = bits;
+  data->data_send.assign((bits + 31) / 32, 0);
+
+  pos = bits - 8;
+  data->data_send[pos / 32] |= (uint32_t)(instr >> 8) << (pos % 32);
+  pos -= 8;
+  data->data_send[pos / 32] |= (uint32_t)(instr & 0xFF) << (pos % 32);
+
+  for (i = 0; i < num; i++) {
+    pos -= 8;
+    if (!rd)
+      data->data_send[pos / 32] |= (uint32_t)bytes[i] << (pos % 32);
+  }
+}
+
+int AD9510_drv::AD9510_spi_stream(uint32_t chip_select, int rd, uint16_t addr, vector<uint8_t>& bytes) {
+
+  wb_data data;
+  unsigned int i, pos, num = bytes.size();
+  int err;
+
+  if (num == 0 || num > AD9510_SPI_MAX_BYTES)
+    return 1;
+
+  AD9510_stream_frame(chip_select, rd, addr, bytes, &data);
+
+  if (!rd)
+    return commLink_->fmc_send(spi_id_, &data);
+
+  err = commLink_->fmc_send_read(spi_id_, &data);
+  if (err)
+    return err;
+
+  if (data.data_read.size() < data.data_send.size())
+    return 1;
+
+  pos = 8 * num;
+  for (i = 0; i < num; i++) {
+    pos -= 8;
+    bytes[i] = (data.data_read[pos / 32] >> (pos % 32)) & 0xFF;
+  }
+
+  return 0;
+}
+
+// val[i] is written to reg + i, chunks are sent from the highest address
+// (address decrements in MSB first mode)
+void AD9510_drv::AD9510_write_jobs(uint32_t chip_select, uint16_t reg, const vector<uint8_t>& val,
+    vector<struct wb_job>& jobs) {
+
+  struct wb_job job;
+  vector<uint8_t> bytes;
+  unsigned int hi, lo, i;
+
+  job.int_name = spi_id_;
+  job.type = WB_JOB_SEND;
+  job.status = 0;
+
+  for (hi = val.size(); hi > 0; hi = lo) {
+
+    lo = hi > AD9510_SPI_MAX_BYTES ? hi - AD9510_SPI_MAX_BYTES : 0;
+
+    bytes.clear();
+    for (i = hi; i > lo; i--)
+      bytes.push_back(val[i - 1]);
 
-  return data_;
+    AD9510_stream_frame(chip_select, 0, reg + hi - 1, bytes, &job.data);
+    jobs.push_back(job);
+  }
+}
+
+int AD9510_drv::AD9510_spi_write_block(uint32_t chip_select, uint16_t reg, const vector<uint8_t>& val) {
+
+  vector<struct wb_job> jobs;
+  unsigned int i;
+  int err;
 
+  AD9510_write_jobs(chip_select, reg, val, jobs);
+
+  for (i = 0; i < jobs.size(); i++) {
+    err = commLink_->fmc_send(spi_id_, &jobs[i].data);
+    if (err)
+      return err;
+  }
+
+  return 0;
+}
+
+int AD9510_drv::AD9510_spi_read_block(uint32_t chip_select, uint16_t reg, unsigned int len, vector<uint8_t>& val) {
+
+  vector<uint8_t> bytes;
+  unsigned int hi, lo, i;
+  int err;
+
+  val.assign(len, 0);
+
+  for (hi = len; hi > 0; hi = lo) {
+
+    lo = hi > AD9510_SPI_MAX_BYTES ? hi - AD9510_SPI_MAX_BYTES : 0;
+
+    bytes.assign(hi - lo, 0);
+
+    err = AD9510_spi_stream(chip_select, 1, reg + hi - 1, bytes);
+    if (err)
+      return err;
+
+    for (i = 0; i < bytes.size(); i++)
+      val[hi - 1 - i] = bytes[i];
+  }
+
+  return 0;
 }
 
 // provide chip select and reg address
 int AD9510_drv::AD9510_reg_update(uint32_t chip_select) {
 
-  wb_data ad9510_data;
-  int repeat = 0;
+  uint8_t val;
+  int repeat = 0, err;
 
-  AD9510_spi_write(chip_select, 0x5A, 0x01);
+  err = AD9510_spi_write(chip_select, 0x5A, 0x01);
+  if (err)
+    return err;
 
   // check if updated
   while (1) {
-    ad9510_data = AD9510_spi_read(chip_select, 0x5A);
+    err = AD9510_spi_read(chip_select, 0x5A, &val);
+    if (err)
+      return err;
 
-    if ( (ad9510_data.data_read[0] & 0x01) == 0)
+    if ( (val & 0x01) == 0)
       break;
 
     repeat++;
@@ -93,41 +236,222 @@ int AD9510_drv::AD9510_reg_update(uint32_t chip_select) {
   return 0;
 }
 
-int AD9510_drv::AD9510_config_si570(uint32_t chip_select) {
+// registers kept in image (reserved registers are skipped)
+static const uint8_t ad9510_ranges[][2] = {
+  { 0x04, 0x0D }, // PLL (A, B, R counters, PLL control)
+  { 0x34, 0x36 }, // delay OUT5
+  { 0x38, 0x3A }, // delay OUT6
+  { 0x3C, 0x43 }, // outputs OUT0 - OUT7
+  { 0x45, 0x45 }, // clock select
+  { 0x48, 0x58 }  // dividers, function pin
+};
 
-  //wb_data ad9510_data;
-  wb_data data;
+#define AD9510_NUM_RANGES (sizeof(ad9510_ranges)/sizeof(ad9510_ranges[0]))
 
-  // reset on startup done by function pin
+int AD9510_drv::AD9510_image_reset(uint32_t chip_select) {
+
+  struct ad9510_regs* regs = &regs_[chip_select];
+  vector<uint8_t> val;
+  unsigned int i, j;
+  int err;
+
+  regs->valid = 0;
 
   // reset registers (don't turn off Long Instruction bit)
-  AD9510_spi_write(chip_select, 0x00, 0x30);
-  AD9510_reg_update(chip_select);
+  err = AD9510_spi_write(chip_select, 0x00, 0x30);
+  if (err)
+    return err;
   // wait
   usleep(10000);
-  //sleep(1);
   // turn off reset
-  AD9510_spi_write(chip_select, 0x00, 0x10);
-  AD9510_reg_update(chip_select);
+  err = AD9510_spi_write(chip_select, 0x00, 0x10);
+  if (err)
+    return err;
   // wait
   usleep(10000);
-  //sleep(1);
 
-  // testing end
+  // chip state after reset (defaults)
+  for (i = 0; i < AD9510_NUM_RANGES; i++) {
+
+    err = AD9510_spi_read_block(chip_select, ad9510_ranges[i][0],
+        ad9510_ranges[i][1] - ad9510_ranges[i][0] + 1, val);
+    if (err)
+      return err;
+
+    for (j = 0; j < val.size(); j++) {
+      regs->chip[ad9510_ranges[i][0] + j] = val[j];
+      regs->image[ad9510_ranges[i][0] + j] = val[j];
+    }
+  }
+
+  regs->valid = 1;
+
+  return 0;
+}
+
+void AD9510_drv::AD9510_image_set(uint32_t chip_select, uint8_t reg, uint8_t val) {
+
+  if (reg < AD9510_NUM_REGS)
+    regs_[chip_select].image[reg] = val;
+}
+
+void AD9510_drv::AD9510_image_set_block(uint32_t chip_select, uint8_t reg, const uint8_t* val, unsigned int len) {
+
+  unsigned int i;
+
+  for (i = 0; i < len; i++)
+    AD9510_image_set(chip_select, reg + i, val[i]);
+}
+
+uint8_t AD9510_drv::AD9510_image_get(uint32_t chip_select, uint8_t reg) {
+
+  if (reg >= AD9510_NUM_REGS)
+    return 0;
+
+  return regs_[chip_select].image[reg];
+}
+
+int AD9510_drv::AD9510_image_commit(uint32_t chip_select, vector<struct wb_job>* side_jobs) {
+
+  struct ad9510_regs* regs = &regs_[chip_select];
+  vector<struct wb_job> jobs;
+  unsigned int i, j, lo, hi, reg, end, num;
+  int err = 0;
+
+  for (i = 0; i < AD9510_NUM_RANGES; i++) {
+
+    reg = ad9510_ranges[i][0];
+
+    while (reg <= ad9510_ranges[i][1]) {
+
+      // first changed register
+      if (regs->valid && regs->image[reg] == regs->chip[reg]) {
+        reg++;
+        continue;
+      }
+
+      // extend run, unchanged gaps shorter than instruction are sent too
+      lo = reg;
+      hi = reg;
+      for (end = reg + 1; end <= ad9510_ranges[i][1] && end <= hi + AD9510_MERGE_GAP + 1; end++)
+        if (!regs->valid || regs->image[end] != regs->chip[end])
+          hi = end;
+
+      AD9510_write_jobs(chip_select, lo, vector<uint8_t>(regs->image + lo, regs->image + hi + 1), jobs);
+
+      reg = hi + 1;
+    }
+  }
+
+  num = jobs.size();
+
+  if (side_jobs != NULL)
+    jobs.insert(jobs.end(), side_jobs->begin(), side_jobs->end());
+
+  if (!jobs.empty())
+    commLink_->fmc_schedule(jobs);
+
+  if (side_jobs != NULL)
+    copy(jobs.begin() + num, jobs.end(), side_jobs->begin());
+
+  // side jobs errors are left to caller
+  for (j = 0; j < num && err == 0; j++)
+    err = jobs[j].status;
+
+  if (err) {
+    // part of the runs may be written
+    regs->valid = 0;
+    return err;
+  }
+
+  for (i = 0; i < AD9510_NUM_RANGES; i++)
+    for (reg = ad9510_ranges[i][0]; reg <= ad9510_ranges[i][1]; reg++)
+      regs->chip[reg] = regs->image[reg];
+
+  regs->valid = 1;
+
+  if (num == 0)
+    return 0;
+
+  return AD9510_reg_update(chip_select);
+}
+
+int AD9510_drv::AD9510_image_check(uint32_t chip_select) {
+
+  struct ad9510_regs* regs = &regs_[chip_select];
+  vector<uint8_t> val;
+  unsigned int i, j, reg;
+  int err, mismatch = 0;
+
+  for (i = 0; i < AD9510_NUM_RANGES; i++) {
+
+    err = AD9510_spi_read_block(chip_select, ad9510_ranges[i][0],
+        ad9510_ranges[i][1] - ad9510_ranges[i][0] + 1, val);
+    if (err)
+      return err;
+
+    for (j = 0; j < val.size(); j++) {
+
+      reg = ad9510_ranges[i][0] + j;
+
+      printf("AD9510 assert, reg: 0x%02x val: 0x%02x =? 0x%02x...", reg, val[j], regs->image[reg]);
+
+      if (val[j] != regs->image[reg]) {
+        printf("failed!\n");
+        mismatch = 1;
+        continue;
+      }
+
+      printf("passed!\n");
+    }
+  }
+
+  // chip state differs from image, read again on next reset
+  if (mismatch)
+    regs->valid = 0;
+
+  return mismatch;
+}
+
+// configuration is applied with outputs held in sync (one update),
+// sync is released with second update: register 0x58 is buffered like
+// the others, soft sync bit takes effect only on IO update, so assert
+// and release can't share one update (outputs would not be synchronised)
+int AD9510_drv::AD9510_image_commit_sync(uint32_t chip_select, vector<struct wb_job>* side_jobs) {
+
+  int err;
+
+  // Function pin is SYNCB, software sync
+  AD9510_image_set(chip_select, 0x58, 0x24); //0010 0100
+
+  err = AD9510_image_commit(chip_select, side_jobs);
+  if (err)
+    return err;
+
+  usleep(10000);
+
+  AD9510_image_set(chip_select, 0x58, 0x20); //0010 0000
+
+  return AD9510_image_commit(chip_select);
+}
+
+int AD9510_drv::AD9510_config_si570(uint32_t chip_select) {
+
+  int err;
+
+  // reset on startup done by function pin
+
+  err = AD9510_image_reset(chip_select);
+  if (err)
+    return err;
+
   // PLL power down (PLL is not used) - default
   // output OUT0 - OUT3 - power on
   // voltage output 810mV
 
-  AD9510_spi_write(chip_select, 0x3C, 0x08);
-  AD9510_spi_write(chip_select, 0x3D, 0x08);
-  AD9510_spi_write(chip_select, 0x3E, 0x08);
-  AD9510_spi_write(chip_select, 0x3F, 0x08);
-
   // output OUT4 - OUT7 - power down
-  AD9510_spi_write(chip_select, 0x40, 0x03);
-  AD9510_spi_write(chip_select, 0x41, 0x03);
-  AD9510_spi_write(chip_select, 0x42, 0x03);
-  AD9510_spi_write(chip_select, 0x43, 0x03);
+  static const uint8_t out_regs[] = { 0x08, 0x08, 0x08, 0x08, 0x03, 0x03, 0x03, 0x03 }; // 0x3C - 0x43
+  AD9510_image_set_block(chip_select, 0x3C, out_regs, sizeof(out_regs));
 
   // Clock selection (distribution mode)
   // CLK1 - power down
@@ -135,7 +459,7 @@ int AD9510_drv::AD9510_config_si570(uint32_t chip_select) {
   // Clock select = CLK2
   // Prescaler Clock -  Power-Down
   // REFIN - Power-Down
-  AD9510_spi_write(chip_select, 0x45, 0x1A);
+  AD9510_image_set(chip_select, 0x45, 0x1A);
 
   // Clock dividers OUT0 - OUT3
   // divide = off (bypassed, ratio 1)
@@ -145,15 +469,9 @@ int AD9510_drv::AD9510_config_si570(uint32_t chip_select) {
   // start high
   // sync
 
-  AD9510_spi_write(chip_select, 0x48, 0x00); // divide by 2 (off)
-  AD9510_spi_write(chip_select, 0x4A, 0x00); // divide by 2 (off)
-  AD9510_spi_write(chip_select, 0x4C, 0x00); // divide by 2 (off)
-  AD9510_spi_write(chip_select, 0x4E, 0x00); // divide by 2 (off)
-
-  AD9510_spi_write(chip_select, 0x49, 0x90); // phase offset = 0 , divider off
-  AD9510_spi_write(chip_select, 0x4B, 0x90); // phase
-  AD9510_spi_write(chip_select, 0x4D, 0x90); // phase
-  AD9510_spi_write(chip_select, 0x4F, 0x90); // phase
+  // divide by 2 (off), phase offset = 0 , divider off
+  static const uint8_t div_regs[] = { 0x00, 0x90, 0x00, 0x90, 0x00, 0x90, 0x00, 0x90 }; // 0x48 - 0x4F
+  AD9510_image_set_block(chip_select, 0x48, div_regs, sizeof(div_regs));
 
   // Clock dividers OUT0 - OUT3 - not used config
   // divide = 2
@@ -163,98 +481,45 @@ int AD9510_drv::AD9510_config_si570(uint32_t chip_select) {
   // start high
   // sync
   /*
-    AD9510_spi_write(chip_select, 0x48, 0x00); // divide
-    AD9510_spi_write(chip_select, 0x4A, 0x00); // divide
-    AD9510_spi_write(chip_select, 0x4C, 0x00); // divide
-    AD9510_spi_write(chip_select, 0x4E, 0x00); // divide
+    AD9510_image_set(chip_select, 0x48, 0x00); // divide
+    AD9510_image_set(chip_select, 0x4A, 0x00); // divide
+    AD9510_image_set(chip_select, 0x4C, 0x00); // divide
+    AD9510_image_set(chip_select, 0x4E, 0x00); // divide
   //
-    AD9510_spi_write(chip_select, 0x49, 0x10); // phase
-    AD9510_spi_write(chip_select, 0x4B, 0x10); // phase
-    AD9510_spi_write(chip_select, 0x4D, 0x10); // phase
-    AD9510_spi_write(chip_select, 0x4F, 0x10); // phase
+    AD9510_image_set(chip_select, 0x49, 0x10); // phase
+    AD9510_image_set(chip_select, 0x4B, 0x10); // phase
+    AD9510_image_set(chip_select, 0x4D, 0x10); // phase
+    AD9510_image_set(chip_select, 0x4F, 0x10); // phase
   */
-  // Function pin is SYNCB
-  AD9510_spi_write(chip_select, 0x58, 0x20);
-
-  AD9510_reg_update(chip_select);
-
-  usleep(10000);
-
-  // software sync
-  AD9510_spi_write(chip_select, 0x58, 0x24);
-  AD9510_reg_update(chip_select);
-
-  usleep(10000);
 
-  AD9510_spi_write(chip_select, 0x58, 0x20);
-  AD9510_reg_update(chip_select);
+  err = AD9510_image_commit_sync(chip_select);
+  if (err)
+    return err;
 
   // Check configuration
-
-  AD9510_assert(chip_select, 0x3C, 0x08);
-  AD9510_assert(chip_select, 0x3D, 0x08);
-  AD9510_assert(chip_select, 0x3E, 0x08);
-  AD9510_assert(chip_select, 0x3F, 0x08);
-
-  AD9510_assert(chip_select, 0x40, 0x03);
-  AD9510_assert(chip_select, 0x41, 0x03);
-  AD9510_assert(chip_select, 0x42, 0x03);
-  AD9510_assert(chip_select, 0x43, 0x03);
-
-  AD9510_assert(chip_select, 0x45, 0x1A);
-
-  AD9510_assert(chip_select, 0x48, 0x00);
-  AD9510_assert(chip_select, 0x4A, 0x00);
-  AD9510_assert(chip_select, 0x4C, 0x00);
-  AD9510_assert(chip_select, 0x4E, 0x00);
-
-  AD9510_assert(chip_select, 0x49, 0x90);
-  AD9510_assert(chip_select, 0x4B, 0x90);
-  AD9510_assert(chip_select, 0x4D, 0x90);
-  AD9510_assert(chip_select, 0x4F, 0x90);
-
-  return 0;
+  return AD9510_image_check(chip_select);
 }
 
 int AD9510_drv::AD9510_config_si570_fmc_adc_130m_4ch(uint32_t chip_select) {
 
-  wb_data data;
+  int err;
 
   // reset on startup done by function pin
 
-  // reset registers (don't turn off Long Instruction bit)
-  AD9510_spi_write(chip_select, 0x00, 0x30);
-  AD9510_reg_update(chip_select);
-  // wait
-  usleep(10000);
-  //sleep(1);
-  // turn off reset
-  AD9510_spi_write(chip_select, 0x00, 0x10);
-  AD9510_reg_update(chip_select);
-  // wait
-  usleep(10000);
-  //sleep(1);
+  err = AD9510_image_reset(chip_select);
+  if (err)
+    return err;
 
-  // testing end
   // PLL power down (PLL is not used) - default
   // output OUT0 - OUT3 - power on
   // voltage output 810mV
-  AD9510_spi_write(chip_select, 0x3C, 0x08);
-  AD9510_spi_write(chip_select, 0x3D, 0x08);
-  AD9510_spi_write(chip_select, 0x3E, 0x08);
-  AD9510_spi_write(chip_select, 0x3F, 0x08);
-
   // OUT4 power up
   // LVDS, 3.5mA, 100ohm termination, power on
-  //AD9510_spi_write(chip_select, 0x40, 0x03);
-  AD9510_spi_write(chip_select, 0x40, 0x02);
   // output OUT5 - OUT6 - power down
-  AD9510_spi_write(chip_select, 0x41, 0x03);
-  AD9510_spi_write(chip_select, 0x42, 0x03);
-
   // output OUT7 - power on (clock copy, LVDS)
   // LVDS, 3.5mA, 100ohm termination, power on
-  AD9510_spi_write(chip_select, 0x43, 0x02);
+  static const uint8_t out_regs[] = { 0x08, 0x08, 0x08, 0x08, 0x02, 0x03, 0x03, 0x02 }; // 0x3C - 0x43
+  AD9510_image_set_block(chip_select, 0x3C, out_regs, sizeof(out_regs));
 
    // Clock selection (distribution mode)
   // CLK1 - power on
@@ -262,7 +527,7 @@ int AD9510_drv::AD9510_config_si570_fmc_adc_130m_4ch(uint32_t chip_select) {
   // Clock select = CLK1
   // Prescaler Clock -  Power-Down
   // REFIN - Power-Down
-  AD9510_spi_write(chip_select, 0x45, 0x1D);
+  AD9510_image_set(chip_select, 0x45, 0x1D);
 
   // Clock selection (distribution mode)
   // CLK1 - power down
@@ -270,7 +535,7 @@ int AD9510_drv::AD9510_config_si570_fmc_adc_130m_4ch(uint32_t chip_select) {
   // Clock select = CLK2
   // Prescaler Clock -  Power-Down
   // REFIN - Power-Down
-  //AD9510_spi_write(chip_select, 0x45, 0x1A);
+  //AD9510_image_set(chip_select, 0x45, 0x1A);
 
   // Clock dividers OUT0 - OUT3 and OUT7
   // divide = off (bypassed, ratio 1)
@@ -279,154 +544,263 @@ int AD9510_drv::AD9510_config_si570_fmc_adc_130m_4ch(uint32_t chip_select) {
   // phase offset = 0
   // start high
   // sync
-  AD9510_spi_write(chip_select, 0x48, 0x00); // divide by 2 (off)
-  AD9510_spi_write(chip_select, 0x4A, 0x00); // divide by 2 (off)
-  AD9510_spi_write(chip_select, 0x4C, 0x00); // divide by 2 (off)
-  AD9510_spi_write(chip_select, 0x4E, 0x00); // divide by 2 (off)
-  AD9510_spi_write(chip_select, 0x50, 0x00); // divide by 2 (off)
-  AD9510_spi_write(chip_select, 0x56, 0x00); // divider
+  // divide by 2 (off), phase offset = 0 , divider off
+  static const uint8_t div_regs[] = { 0x00, 0x90, 0x00, 0x90, 0x00, 0x90, 0x00, 0x90, 0x00, 0x90 }; // 0x48 - 0x51
+  static const uint8_t div7_regs[] = { 0x00, 0x90 }; // 0x56 - 0x57
+  AD9510_image_set_block(chip_select, 0x48, div_regs, sizeof(div_regs));
+  AD9510_image_set_block(chip_select, 0x56, div7_regs, sizeof(div7_regs));
 
-  AD9510_spi_write(chip_select, 0x49, 0x90); // phase offset = 0 , divider off
-  AD9510_spi_write(chip_select, 0x4B, 0x90); // phase
-  AD9510_spi_write(chip_select, 0x4D, 0x90); // phase
-  AD9510_spi_write(chip_select, 0x4F, 0x90); // phase
-  AD9510_spi_write(chip_select, 0x51, 0x90); // phase
-  AD9510_spi_write(chip_select, 0x57, 0x90); // phase
+  err = AD9510_image_commit_sync(chip_select);
+  if (err)
+    return err;
 
-  // Function pin is SYNCB
-  AD9510_spi_write(chip_select, 0x58, 0x20);
+  // Check configuration
+  return AD9510_image_check(chip_select);
+}
 
-  AD9510_reg_update(chip_select);
+// Prescaler modes (register 0x0A, bits 4:2), max input frequency
+static const struct {
+  uint8_t code;
+  uint32_t p;
+  int dm;
+  uint64_t max_in;
+} ad9510_prescalers[] = {
+  { 0x00, 1, 0, 300000000ULL },  // FD 1
+  { 0x01, 2, 0, 600000000ULL },  // FD 2
+  { 0x07, 3, 0, 900000000ULL },  // FD 3
+  { 0x02, 2, 1, 200000000ULL },  // DM 2/3
+  { 0x03, 4, 1, 1000000000ULL }, // DM 4/5
+  { 0x04, 8, 1, 2400000000ULL }, // DM 8/9
+  { 0x05, 16, 1, 3000000000ULL }, // DM 16/17
+  { 0x06, 32, 1, 3000000000ULL }  // DM 32/33
+};
 
-  usleep(10000);
+#define AD9510_NUM_PRESCALERS (sizeof(ad9510_prescalers)/sizeof(ad9510_prescalers[0]))
 
-  // software sync
-  AD9510_spi_write(chip_select, 0x58, 0x24);
-  AD9510_reg_update(chip_select);
+// ratio = freq / div_freq (rounded), error within AD9510_PLL_TOL_PPM
+static int ad9510_ratio(uint64_t freq, uint64_t div_freq, uint32_t* ratio) {
 
-  usleep(10000);
+  uint64_t r, diff;
 
-  AD9510_spi_write(chip_select, 0x58, 0x20);
-  AD9510_reg_update(chip_select);
+  if (div_freq == 0)
+    return 1;
 
-  // Check configuration
+  r = (freq + div_freq / 2) / div_freq;
+  if (r == 0)
+    return 1;
+
+  diff = (r * div_freq > freq) ? r * div_freq - freq : freq - r * div_freq;
+
+  if (diff * 1000000ULL > freq * AD9510_PLL_TOL_PPM)
+    return 1;
+
+  *ratio = r;
+
+  return 0;
+}
+
+int AD9510_drv::AD9510_pll_solve(uint64_t ref_freq, uint64_t vco_freq, const vector<uint64_t>& out_freq,
+    struct ad9510_pll_plan* plan) {
+
+  map<vector<uint64_t>, struct ad9510_pll_plan>::iterator it;
+  vector<uint64_t> key;
+  struct ad9510_pll_plan found;
+  uint32_t r, n, b, i;
+
+  key.push_back(ref_freq);
+  key.push_back(vco_freq);
+  key.insert(key.end(), out_freq.begin(), out_freq.end());
+
+  it = plans_.find(key);
+  if (it != plans_.end()) {
+    *plan = it->second;
+    return 0;
+  }
+
+  if (ref_freq == 0 || vco_freq == 0 || out_freq.size() > AD9510_NUM_OUTPUTS) {
+    cout << "AD9510 PLL: invalid frequency plan" << endl;
+    return 1;
+  }
+
+  // output dividers: bypass or 2 - 32
+  for (i = 0; i < AD9510_NUM_OUTPUTS; i++) {
+
+    found.div[i] = 0;
+
+    if (i >= out_freq.size() || out_freq[i] == 0)
+      continue;
+
+    if (ad9510_ratio(vco_freq, out_freq[i], &found.div[i]) != 0 || found.div[i] > AD9510_MAX_DIV) {
+      cout << "AD9510 PLL: no divider for output " << dec << i << " (" << out_freq[i] << " Hz)" << endl;
+      return 1;
+    }
+  }
+
+  // lowest R gives highest PFD frequency and lowest N (lowest jitter),
+  // fixed divide modes are tried first
+  found.pfd = 0;
+
+  for (r = 1; r <= AD9510_MAX_R && found.pfd == 0; r++) {
+
+    if (ref_freq / r > AD9510_MAX_PFD_FREQ)
+      continue;
+
+    if (ad9510_ratio(vco_freq * r, ref_freq, &n) != 0)
+      continue;
+
+    for (i = 0; i < AD9510_NUM_PRESCALERS; i++) {
+
+      if (vco_freq > ad9510_prescalers[i].max_in ||
+          vco_freq / ad9510_prescalers[i].p > AD9510_MAX_PRESCALER_OUT)
+        continue;
+
+      b = n / ad9510_prescalers[i].p;
+
+      found.a = 0;
+
+      if (ad9510_prescalers[i].dm)
+        found.a = n % ad9510_prescalers[i].p;
+      else if (n % ad9510_prescalers[i].p)
+        continue;
 
-  AD9510_assert(chip_select, 0x3C, 0x08);
-  AD9510_assert(chip_select, 0x3D, 0x08);
-  AD9510_assert(chip_select, 0x3E, 0x08);
-  AD9510_assert(chip_select, 0x3F, 0x08);
-
-  AD9510_assert(chip_select, 0x40, 0x02);
-  AD9510_assert(chip_select, 0x41, 0x03);
-  AD9510_assert(chip_select, 0x42, 0x03);
-  AD9510_assert(chip_select, 0x43, 0x02);
-
-  //AD9510_assert(chip_select, 0x45, 0x1A);
-  AD9510_assert(chip_select, 0x45, 0x1D);
-
-  AD9510_assert(chip_select, 0x48, 0x00);
-  AD9510_assert(chip_select, 0x4A, 0x00);
-  AD9510_assert(chip_select, 0x4C, 0x00);
-  AD9510_assert(chip_select, 0x4E, 0x00);
-  AD9510_assert(chip_select, 0x50, 0x00);
-  AD9510_assert(chip_select, 0x56, 0x00);
-
-  AD9510_assert(chip_select, 0x49, 0x90);
-  AD9510_assert(chip_select, 0x4B, 0x90);
-  AD9510_assert(chip_select, 0x4D, 0x90);
-  AD9510_assert(chip_select, 0x4F, 0x90);
-  AD9510_assert(chip_select, 0x51, 0x90);
-  AD9510_assert(chip_select, 0x57, 0x90);
+      // B = 1 only with B counter bypassed (FD mode), A <= B in DM mode
+      if (b > AD9510_MAX_B || (b < AD9510_MIN_B && (ad9510_prescalers[i].dm || b != 1)) ||
+          found.a > b)
+        continue;
+
+      found.r = r;
+      found.p_code = ad9510_prescalers[i].code;
+      found.p = ad9510_prescalers[i].p;
+      found.dm = ad9510_prescalers[i].dm;
+      found.b = b;
+      found.pfd = ref_freq / r;
+      break;
+    }
+  }
+
+  if (found.pfd == 0) {
+    cout << "AD9510 PLL: no counter setting for VCO " << dec << vco_freq <<
+        " Hz, reference " << ref_freq << " Hz" << endl;
+    return 1;
+  }
+
+  cout << "AD9510 PLL: R = " << dec << found.r << ", P = " << found.p << (found.dm ? " (DM)" : " (FD)") <<
+      ", B = " << found.b << ", A = " << found.a << ", PFD = " << found.pfd << " Hz" << endl;
+
+  plans_[key] = found;
+  *plan = found;
 
   return 0;
 }
 
+void AD9510_drv::AD9510_image_set_plan(uint32_t chip_select, const struct ad9510_pll_plan* plan) {
+
+  unsigned int i, lo, hi;
+
+  // A counter, B counter (MSB, LSB)
+  AD9510_image_set(chip_select, 0x04, plan->a & 0x3F);
+  AD9510_image_set(chip_select, 0x05, (plan->b >> 8) & 0x1F);
+  AD9510_image_set(chip_select, 0x06, plan->b & 0xFF);
+
+  // Pre scaler, B counter bypass (B = 1), PLL in normal operation 00
+  AD9510_image_set(chip_select, 0x0A, (plan->b == 1 ? 0x40 : 0x00) | (plan->p_code << 2) | 0x00);
+
+  // R divider (MSB, LSB)
+  AD9510_image_set(chip_select, 0x0B, (plan->r >> 8) & 0x3F);
+  AD9510_image_set(chip_select, 0x0C, plan->r & 0xFF);
+
+  for (i = 0; i < AD9510_NUM_OUTPUTS; i++) {
+
+    if (plan->div[i] == 0)
+      continue;
+
+    if (plan->div[i] == 1) {
+      // divider off (bypassed), phase offset = 0, start high
+      AD9510_image_set(chip_select, 0x48 + 2 * i, 0x00);
+      AD9510_image_set(chip_select, 0x49 + 2 * i, 0x90);
+      continue;
+    }
+
+    // divide = lo + hi cycles (duty cycle 50%), phase offset = 0, start high
+    hi = plan->div[i] / 2;
+    lo = plan->div[i] - hi;
+    AD9510_image_set(chip_select, 0x48 + 2 * i, ((lo - 1) << 4) | (hi - 1));
+    AD9510_image_set(chip_select, 0x49 + 2 * i, 0x10);
+  }
+}
+
 int AD9510_drv::AD9510_config_si570_pll_fmc_adc_130m_4ch(uint32_t chip_select) {
 
-  wb_data data;
+  struct ad9510_pll_plan plan;
+  unsigned int i;
+
+  // R divider = 1, prescaler = divide by 1 (FD), B counter = 10, A counter = 0
+  plan.r = 1;
+  plan.p_code = 0x00;
+  plan.p = 1;
+  plan.dm = 0;
+  plan.b = 10;
+  plan.a = 0;
+  plan.pfd = 0;
+
+  // OUT0 - OUT4 and OUT7 - divider off (bypassed, ratio 1)
+  for (i = 0; i < AD9510_NUM_OUTPUTS; i++)
+    plan.div[i] = (i == 5 || i == 6) ? 0 : 1;
+
+  return AD9510_config_pll_plan(chip_select, &plan);
+}
+
+int AD9510_drv::AD9510_config_si570_pll_fmc_adc_130m_4ch(uint32_t chip_select, uint64_t ref_freq,
+    uint64_t vco_freq, const vector<uint64_t>& out_freq, vector<struct wb_job>* side_jobs) {
+
+  struct ad9510_pll_plan plan;
+
+  if (AD9510_pll_solve(ref_freq, vco_freq, out_freq, &plan) != 0)
+    return 1;
+
+  return AD9510_config_pll_plan(chip_select, &plan, side_jobs);
+}
+
+int AD9510_drv::AD9510_config_pll_plan(uint32_t chip_select, const struct ad9510_pll_plan* plan,
+    vector<struct wb_job>* side_jobs) {
+
+  int err;
 
   // reset on startup done by function pin
 
-  // reset registers (don't turn off Long Instruction bit)
-  AD9510_spi_write(chip_select, 0x00, 0x30);
-  //AD9510_reg_update(chip_select);
-  // wait
-  usleep(10000);
-  //sleep(1);
-  // turn off reset
-  AD9510_spi_write(chip_select, 0x00, 0x10);
-  //AD9510_reg_update(chip_select);
-  // wait
-  usleep(10000);
-  //sleep(1);
-
-  // A counter = 0 - N divider
-  AD9510_spi_write(chip_select, 0x04, 0x00);
-  // B counter (MSB) = 0 - N divider
-  AD9510_spi_write(chip_select, 0x05, 0x00);
-   // B counter (LSB) = 74 - N divider
-  //AD9510_spi_write(chip_select, 0x06, 0x4A);
-   // B counter (LSB) = 35 - N divider
-  //AD9510_spi_write(chip_select, 0x06, 0x23);
-  // B counter (LSB) = 10 - N divider
-  AD9510_spi_write(chip_select, 0x06, 0x0A);
-  // B counter (LSB) = 5 - N divider
-  //AD9510_spi_write(chip_select, 0x06, 0x05);
-  // B counter (LSB) = 4 - N divider
-  //AD9510_spi_write(chip_select, 0x06, 0x04);
-  // B counter (LSB) = 2 - N divider. Invalid!
-  //AD9510_spi_write(chip_select, 0x06, 0x02);
-  // B counter (LSB) = 1 - N divider. Invalid!
-  //AD9510_spi_write(chip_select, 0x06, 0x01);
+  err = AD9510_image_reset(chip_select);
+  if (err)
+    return err;
+
+  // A, B, R counters and prescaler
+  AD9510_image_set_plan(chip_select, plan);
 
   // Mux Status Pin. PLL Mux Select = Digital Lock Detect, CP Mode = Normal operation, PFD polarity = 1 (positive)
-  AD9510_spi_write(chip_select, 0x08, 0x04 | 0x03 | 0x40);
+  AD9510_image_set(chip_select, 0x08, 0x04 | 0x03 | 0x40);
   // Mux Status Pin. N divider Output, CP Mode = Normal operation, PFD polarity = 1 (positive)
-  //AD9510_spi_write(chip_select, 0x08, 0x08 | 0x03 | 0x40);
+  //AD9510_image_set(chip_select, 0x08, 0x08 | 0x03 | 0x40);
   // Mux Status Pin. R divider Output, CP Mode = Normal operation, PFD polarity = 1 (positive)
-  //AD9510_spi_write(chip_select, 0x08, 0x10 | 0x03 | 0x40);
+  //AD9510_image_set(chip_select, 0x08, 0x10 | 0x03 | 0x40);
   // Mux Status Pin. PFD Up output, CP Mode = Normal operation, PFD polarity = 1 (positive)
-  //AD9510_spi_write(chip_select, 0x08,  0x20 | 0x40 | 0x10 | 0x03);
+  //AD9510_image_set(chip_select, 0x08,  0x20 | 0x40 | 0x10 | 0x03);
   // Mux Status Pin. PFD Down output, CP Mode = Normal operation, PFD polarity = 1 (positive)
-  //AD9510_spi_write(chip_select, 0x08,  0x20 | 0x04 | 0x40 | 0x10 | 0x03);
+  //AD9510_image_set(chip_select, 0x08,  0x20 | 0x04 | 0x40 | 0x10 | 0x03);
 
   // Charge Pump Current. I = 0.6mA
-  //AD9510_spi_write(chip_select, 0x09, 0x00);
+  //AD9510_image_set(chip_select, 0x09, 0x00);
   // Charge Pump Current. I = 4.8mA
-  AD9510_spi_write(chip_select, 0x09, 0x70);
+  AD9510_image_set(chip_select, 0x09, 0x70);
 
-  // Pre scaler = divide by 2, mode = FD, PLL in normal operation 00
-  //AD9510_spi_write(chip_select, 0x0A, 0x04 | 0x00);
-  // Pre scaler = divide by 1, mode = FD, PLL in normal operation 00
-  AD9510_spi_write(chip_select, 0x0A, 0x00 | 0x00);
-  //AD9510_spi_write(chip_select, 0x0A, 0x08);
-
-  // R divider = 1
-  AD9510_spi_write(chip_select, 0x0B, 0x00);
-  AD9510_spi_write(chip_select, 0x0C, 0x01);
-
-  // testing end
   // PLL power up
   // output OUT0 - OUT3 - power on
   // voltage output 810mV
-  AD9510_spi_write(chip_select, 0x3C, 0x08);
-  AD9510_spi_write(chip_select, 0x3D, 0x08);
-  AD9510_spi_write(chip_select, 0x3E, 0x08);
-  AD9510_spi_write(chip_select, 0x3F, 0x08);
-
   // OUT4 power up
   // LVDS, 3.5mA, 100ohm termination, power on
-  //AD9510_spi_write(chip_select, 0x40, 0x03);
-  AD9510_spi_write(chip_select, 0x40, 0x02);
   // output OUT5 - OUT6 - power down
-  AD9510_spi_write(chip_select, 0x41, 0x03);
-  AD9510_spi_write(chip_select, 0x42, 0x03);
-  //AD9510_spi_write(chip_select, 0x41, 0x08);
-  //AD9510_spi_write(chip_select, 0x42, 0x08);
-
   // output OUT7 - power on (clock copy, LVDS)
   // LVDS, 3.5mA, 100ohm termination, power on
-  AD9510_spi_write(chip_select, 0x43, 0x02);
+  static const uint8_t out_regs[] = { 0x08, 0x08, 0x08, 0x08, 0x02, 0x03, 0x03, 0x02 }; // 0x3C - 0x43
+  AD9510_image_set_block(chip_select, 0x3C, out_regs, sizeof(out_regs));
 
   // Clock selection (distribution mode)
   // CLK1 - power down
@@ -434,7 +808,7 @@ int AD9510_drv::AD9510_config_si570_pll_fmc_adc_130m_4ch(uint32_t chip_select) {
   // Clock select = CLK2
   // Prescaler Clock - Power-Down
   // REFIN - Power-Down
-  //AD9510_spi_write(chip_select, 0x45, 0x1A);
+  //AD9510_image_set(chip_select, 0x45, 0x1A);
 
   // Clock selection (distribution mode)
   // CLK1 - power down
@@ -442,7 +816,7 @@ int AD9510_drv::AD9510_config_si570_pll_fmc_adc_130m_4ch(uint32_t chip_select) {
   // Clock select = CLK2
   // Prescaler Clock - Power-Up
   // REFIN - Power-Up
-  AD9510_spi_write(chip_select, 0x45, 0x02);
+  AD9510_image_set(chip_select, 0x45, 0x02);
 
   // Clock selection (distribution mode)
   // CLK1 - power on
@@ -450,113 +824,42 @@ int AD9510_drv::AD9510_config_si570_pll_fmc_adc_130m_4ch(uint32_t chip_select) {
   // Clock select = CLK1
   // Prescaler Clock -  Power-Down
   // REFIN - Power-Down
-  //AD9510_spi_write(chip_select, 0x45, 0x1D);
+  //AD9510_image_set(chip_select, 0x45, 0x1D);
 
-  AD9510_reg_update(chip_select);
-
-  // Clock dividers OUT0 - OUT3 and OUT7
-  // divide = off (bypassed, ratio 1)
+  // Clock dividers OUT0 - OUT4 and OUT7 from plan
   // duty cycle 50%
-  // lo-hi 0x00
   // phase offset = 0
   // start high
   // sync
-  AD9510_spi_write(chip_select, 0x48, 0x00); // divide by 2 (off)
-  AD9510_spi_write(chip_select, 0x4A, 0x00); // divide by 2 (off)
-  AD9510_spi_write(chip_select, 0x4C, 0x00); // divide by 2 (off)
-  AD9510_spi_write(chip_select, 0x4E, 0x00); // divide by 2 (off)
-  AD9510_spi_write(chip_select, 0x50, 0x00); // divide by 2 (off)
-  AD9510_spi_write(chip_select, 0x56, 0x00); // divider
 
-  AD9510_spi_write(chip_select, 0x49, 0x90); // phase offset = 0 , divider off
-  AD9510_spi_write(chip_select, 0x4B, 0x90); // phase
-  AD9510_spi_write(chip_select, 0x4D, 0x90); // phase
-  AD9510_spi_write(chip_select, 0x4F, 0x90); // phase
-  AD9510_spi_write(chip_select, 0x51, 0x90); // phase
-  AD9510_spi_write(chip_select, 0x57, 0x90); // phase
-
-  // Function pin is SYNCB
-  AD9510_spi_write(chip_select, 0x58, 0x20); //0010 0000
-
-  AD9510_reg_update(chip_select);
-
-  usleep(10000);
-
-  // software sync
-  AD9510_spi_write(chip_select, 0x58, 0x24); //0010 0100
-  AD9510_reg_update(chip_select);
-
-  usleep(10000);
-
-  AD9510_spi_write(chip_select, 0x58, 0x20); //0010 0000
-  AD9510_reg_update(chip_select);
+  err = AD9510_image_commit_sync(chip_select, side_jobs);
+  if (err)
+    return err;
 
   // Check configuration
-
-  AD9510_assert(chip_select, 0x04, 0x00);
-  AD9510_assert(chip_select, 0x05, 0x00);
-  AD9510_assert(chip_select, 0x06, 0x0A);
-  //AD9510_assert(chip_select, 0x06, 0x4A);
-  //AD9510_assert(chip_select, 0x06, 0x23);
-  //AD9510_assert(chip_select, 0x06, 0x05);
-  //AD9510_assert(chip_select, 0x06, 0x02);
-  //AD9510_assert(chip_select, 0x06, 0x01);
-  //AD9510_assert(chip_select, 0x08, 0x04 | 0x00);
-  AD9510_assert(chip_select, 0x08, 0x04 | 0x03 | 0x40);
-
-  AD9510_assert(chip_select, 0x09, 0x00);
-
-  //AD9510_assert(chip_select, 0x0A, 0x04 | 0x00);
-  AD9510_assert(chip_select, 0x0A, 0x00 | 0x00);
-  //AD9510_assert(chip_select, 0x0A, 0x08);
-
-  AD9510_assert(chip_select, 0x0B, 0x00);
-  AD9510_assert(chip_select, 0x0C, 0x01);
-
-  AD9510_assert(chip_select, 0x3C, 0x08);
-  AD9510_assert(chip_select, 0x3C, 0x08);
-  AD9510_assert(chip_select, 0x3D, 0x08);
-  AD9510_assert(chip_select, 0x3E, 0x08);
-  AD9510_assert(chip_select, 0x3F, 0x08);
-
-  //AD9510_assert(chip_select, 0x40, 0x03);
-  AD9510_assert(chip_select, 0x40, 0x02);
-  AD9510_assert(chip_select, 0x41, 0x03);
-  AD9510_assert(chip_select, 0x42, 0x03);
-  AD9510_assert(chip_select, 0x43, 0x02);
-
-  //AD9510_assert(chip_select, 0x45, 0x1A);
-  AD9510_assert(chip_select, 0x45, 0x02);
-  //AD9510_assert(chip_select, 0x45, 0x1D);
-
-  AD9510_assert(chip_select, 0x48, 0x00);
-  AD9510_assert(chip_select, 0x4A, 0x00);
-  AD9510_assert(chip_select, 0x4C, 0x00);
-  AD9510_assert(chip_select, 0x4E, 0x00);
-  AD9510_assert(chip_select, 0x56, 0x00);
-
-  AD9510_assert(chip_select, 0x49, 0x90);
-  AD9510_assert(chip_select, 0x4B, 0x90);
-  AD9510_assert(chip_select, 0x4D, 0x90);
-  AD9510_assert(chip_select, 0x4F, 0x90);
-  AD9510_assert(chip_select, 0x57, 0x90);
-
-  return 0;
+  return AD9510_image_check(chip_select);
 }
 
-void AD9510_drv::AD9510_assert(uint32_t chip_select, uint8_t reg, uint8_t val) {
+int AD9510_drv::AD9510_assert(uint32_t chip_select, uint8_t reg, uint8_t val) {
 
-  wb_data data;
+  uint8_t data;
+  int err;
 
-  data = AD9510_spi_read(chip_select, reg);
+  err = AD9510_spi_read(chip_select, reg, &data);
+  if (err) {
+    printf("AD9510 assert, reg: 0x%02x read error\n", reg);
+    return err;
+  }
 
   //cout << "AD9510 assert, reg: 0x" << hex << unsigned(reg) <<
-  //    " val: 0x" << hex << unsigned(data_.data_read[0] & 0xFF) << " =? 0x" << hex << unsigned(val) << "...";
+  //    " val: 0x" << hex << unsigned(data) << " =? 0x" << hex << unsigned(val) << "...";
 
-  printf("AD9510 assert, reg: 0x%02x val: 0x%02x =? 0x%02x...", reg, data.data_read[0] & 0xFF, val);
+  printf("AD9510 assert, reg: 0x%02x val: 0x%02x =? 0x%02x...", reg, data, val);
 
-  assert( (data.data_read[0] & 0xFF) == val);
+  assert(data == val);
 
   printf("passed!\n");
 
+  return 0;
+
 }
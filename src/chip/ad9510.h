@@ -6,19 +6,84 @@
 #ifndef AD9510_H_
 #define AD9510_H_
 
+#include <map>
+
 #include "data.h"
 #include "commLink.h"
 
 #define AD9510_PLL_STATUS_MASK 0x04
 
+// data bytes per SPI transfer (16 bit instruction, up to 127 bits shifted)
+#define AD9510_SPI_MAX_BYTES 13
+
+// register image (0x00 - 0x5A)
+#define AD9510_NUM_REGS 0x5B
+// unchanged registers between two changed ones sent in one block
+// (cheaper than new instruction)
+#define AD9510_MERGE_GAP 2
+
+// PLL and output divider limits
+#define AD9510_NUM_OUTPUTS 8
+#define AD9510_MAX_R 16383
+#define AD9510_MIN_B 3
+#define AD9510_MAX_B 8191
+#define AD9510_MAX_DIV 32
+#define AD9510_MAX_PFD_FREQ 100000000ULL
+#define AD9510_MAX_PRESCALER_OUT 300000000ULL
+// max frequency ratio error (frequencies given in Hz)
+#define AD9510_PLL_TOL_PPM 1ULL
+
+// PLL frequency plan (N = P * B + A)
+struct ad9510_pll_plan {
+  uint32_t r;
+  uint32_t p_code;                  // prescaler mode (reg 0x0A, bits 4:2)
+  uint32_t p;
+  int dm;                           // dual modulus mode
+  uint32_t b;                       // 1 - B counter bypassed
+  uint32_t a;
+  uint32_t div[AD9510_NUM_OUTPUTS]; // output divider, 0 - output not used
+  uint64_t pfd;                     // phase detector frequency
+};
+
+struct ad9510_regs {
+  uint8_t image[AD9510_NUM_REGS]; // wanted configuration
+  uint8_t chip[AD9510_NUM_REGS];  // last known chip state
+  int valid;                      // chip state known
+};
+
 class AD9510_drv {
 public:
 
   static void AD9510_setCommLink(commLink* comm, string spi_id);
 
   // only one byte read/write
-  static wb_data AD9510_spi_write(uint32_t chip_select, uint8_t reg, uint8_t val);
-  static wb_data AD9510_spi_read(uint32_t chip_select, uint8_t reg);
+  // return - 0 ok, != 0 SPI error (val not changed)
+  static int AD9510_spi_write(uint32_t chip_select, uint8_t reg, uint8_t val);
+  static int AD9510_spi_read(uint32_t chip_select, uint8_t reg, uint8_t* val);
+
+  // register block write/read (streaming instruction, auto address),
+  // up to AD9510_SPI_MAX_BYTES registers per SPI transfer
+  // return - 0 ok, != 0 SPI error
+  static int AD9510_spi_write_block(uint32_t chip_select, uint16_t reg, const vector<uint8_t>& val);
+  static int AD9510_spi_read_block(uint32_t chip_select, uint16_t reg, unsigned int len, vector<uint8_t>& val);
+
+  // Register image. Configuration is built in the image, AD9510_image_commit
+  // writes only registers differing from last known chip state (register
+  // blocks) and issues one IO update
+  // soft reset, chip state (defaults) read back to image
+  static int AD9510_image_reset(uint32_t chip_select);
+  static void AD9510_image_set(uint32_t chip_select, uint8_t reg, uint8_t val);
+  static void AD9510_image_set_block(uint32_t chip_select, uint8_t reg, const uint8_t* val, unsigned int len);
+  static uint8_t AD9510_image_get(uint32_t chip_select, uint8_t reg);
+  // side_jobs - transfers on other interfaces run together with register
+  // writes (commLink::fmc_schedule), statuses are returned in side_jobs
+  // return - 0 ok, != 0 SPI error (chip state is read again on next reset)
+  static int AD9510_image_commit(uint32_t chip_select, vector<struct wb_job>* side_jobs = NULL);
+  // commit with outputs held in software sync, then release sync
+  static int AD9510_image_commit_sync(uint32_t chip_select, vector<struct wb_job>* side_jobs = NULL);
+  // read back and compare all image registers
+  // return - 0 ok, != 0 SPI error or register differs (all registers reported)
+  static int AD9510_image_check(uint32_t chip_select);
 
   // provide chip select and reg address
   static int AD9510_reg_update(uint32_t chip_select); // transfers registers to internal regs of AD9510 chip
@@ -40,13 +105,42 @@ public:
   // FPGA working on copy of ADC clock (FPGA_CLK, output 7 from AD9510 chip)
   static int AD9510_config_si570_pll_fmc_adc_130m_4ch(uint32_t chip_select);
 
-  static void AD9510_assert(uint32_t chip_select, uint8_t reg, uint8_t val);
+  // Configuration as above, PLL counters and output dividers from solver
+  // ref_freq - PLL reference (REFIN) [Hz]
+  // vco_freq - Si571 clk (CLK2) [Hz]
+  // out_freq - OUT0 - OUT7 frequencies [Hz], 0 - output not used
+  // side_jobs - as for AD9510_image_commit
+  static int AD9510_config_si570_pll_fmc_adc_130m_4ch(uint32_t chip_select, uint64_t ref_freq,
+      uint64_t vco_freq, const vector<uint64_t>& out_freq, vector<struct wb_job>* side_jobs = NULL);
+
+  // PLL counters and output dividers for wanted frequencies (highest PFD
+  // frequency, plans are memoised)
+  // return - 0 ok, 1 no valid setting
+  static int AD9510_pll_solve(uint64_t ref_freq, uint64_t vco_freq, const vector<uint64_t>& out_freq,
+      struct ad9510_pll_plan* plan);
+  // counters and dividers to register image
+  static void AD9510_image_set_plan(uint32_t chip_select, const struct ad9510_pll_plan* plan);
+
+  // return - 0 value checked, != 0 SPI error (nothing to check)
+  static int AD9510_assert(uint32_t chip_select, uint8_t reg, uint8_t val);
 
 private:
 
+  static int AD9510_config_pll_plan(uint32_t chip_select, const struct ad9510_pll_plan* plan,
+      vector<struct wb_job>* side_jobs = NULL);
+  static int AD9510_spi_stream(uint32_t chip_select, int rd, uint16_t addr, vector<uint8_t>& bytes);
+  // transfer frame (instruction + data bytes) in TX regs
+  static void AD9510_stream_frame(uint32_t chip_select, int rd, uint16_t addr,
+      const vector<uint8_t>& bytes, wb_data* data);
+  // register block write split to SPI transfers (jobs appended)
+  static void AD9510_write_jobs(uint32_t chip_select, uint16_t reg, const vector<uint8_t>& val,
+      vector<struct wb_job>& jobs);
+
   static wb_data data_;
   static commLink* commLink_;
   static string spi_id_;
+  static map<uint32_t, struct ad9510_regs> regs_;
+  static map<vector<uint64_t>, struct ad9510_pll_plan> plans_;
 
 };
 
@@ -7,12 +7,23 @@
 
 #define MAX_REPEAT 10
 
+// ADC conversion time of one channel (us), with margin
+#define AMC7823_CONV_TIME_US 8
+// DAV checks (one per conversion time) before conversion error
+#define AMC7823_DAV_POLLS (100 * MAX_REPEAT)
+// SPI core shifts up to 128 bits (command + 7 registers) per frame
+#define AMC7823_FRAME_BITS 128
+#define AMC7823_FRAME_REGS (AMC7823_FRAME_BITS / 16 - 1)
+
 // Register map
 // PAGE 1
 #define DAC_CONF 0x09
 #define AMC_CONF 0x0A
 #define ADC_CTRL 0x0B
 #define PWR_DWN_CTRL 0x0D
+// ADC_CTRL fields (CMODE = 0 - direct mode, internal trigger)
+#define ADC_CTRL_SA(x) (((x) & 0x0F) << 8) // start channel
+#define ADC_CTRL_EA(x) (((x) & 0x0F) << 4) // end channel
 // PAGE 0
 #define ADC0_DATA 0x00
 #define ADC1_DATA 0x01
@@ -28,6 +39,8 @@ wb_data AMC7823_drv::data_;
 commLink* AMC7823_drv::commLink_;
 string AMC7823_drv::spi_id_;
 string AMC7823_drv::gpio_id_;
+uint8_t AMC7823_drv::ch_start_ = 0;
+uint8_t AMC7823_drv::ch_end_ = 8;
 
 void AMC7823_drv::AMC7823_setCommLink(commLink* comm, string spi_id, string gpio_id) {
 
@@ -39,7 +52,7 @@ void AMC7823_drv::AMC7823_setCommLink(commLink* comm, string spi_id, string gpio
 
 }
 
-void AMC7823_drv::AMC7823_spi_write(uint32_t chip_select, uint8_t page, uint8_t reg, uint16_t val) {
+int AMC7823_drv::AMC7823_spi_write(uint32_t chip_select, uint8_t page, uint8_t reg, uint16_t val) {
 
   // chip address
   data_.extra[0] = chip_select;
@@ -53,12 +66,12 @@ void AMC7823_drv::AMC7823_spi_write(uint32_t chip_select, uint8_t page, uint8_t
   data_.data_send[0] = data_.data_send[0] << 16; // command word;
   data_.data_send[0] |= val; // add data (second word)
 
-  commLink_->fmc_send(spi_id_, &data_);
-
-  return;
+  return commLink_->fmc_send(spi_id_, &data_);
 }
 
-uint16_t AMC7823_drv::AMC7823_spi_read(uint32_t chip_select, uint8_t page, uint8_t reg) {
+int AMC7823_drv::AMC7823_spi_read(uint32_t chip_select, uint8_t page, uint8_t reg, uint16_t* val) {
+
+  int err;
 
   // chip address
   data_.extra[0] = chip_select;
@@ -71,17 +84,78 @@ uint16_t AMC7823_drv::AMC7823_spi_read(uint32_t chip_select, uint8_t page, uint8
   data_.data_send[0] |= (0x1 << 15) | ( (page & 0x03) << 12) | ( (reg & 0x1F) << 6);
   data_.data_send[0] = data_.data_send[0] << 16; // command word (read)
 
-  commLink_->fmc_send_read(spi_id_, &data_);
+  err = commLink_->fmc_send_read(spi_id_, &data_);
+  if (err)
+    return err;
+
+  if (data_.data_read.empty())
+    return 1;
+
   //cout << "data_amc spi: " << hex << data_.data_read[0] << endl;
-  return data_.data_read[0];
+  *val = data_.data_read[0];
+
+  return 0;
+
+}
+
+int AMC7823_drv::AMC7823_spi_read_block(uint32_t chip_select, uint8_t page, uint8_t first, uint8_t last,
+    vector<uint16_t>& val) {
+
+  wb_data data;
+  unsigned int n, bits, pos, k;
+  int err;
+
+  val.clear();
+
+  data.extra.resize(2);
+  data.extra[0] = chip_select;
 
+  // one frame per AMC7823_FRAME_REGS registers, chip select held within frame
+  while (first <= last) {
+
+    n = last - first + 1;
+    if (n > AMC7823_FRAME_REGS)
+      n = AMC7823_FRAME_REGS;
+
+    // command word + n data words, MSB first
+    bits = 16 * (n + 1);
+    // char_len = 0 - whole shift register
+    data.extra[1] = bits % AMC7823_FRAME_BITS;
+
+    // command word (read), start and end address
+    data.data_send.assign((bits + 31) / 32, 0);
+    pos = bits - 16;
+    data.data_send[pos / 32] |= ((0x1 << 15) | ((page & 0x03) << 12) | ((first & 0x1F) << 6) |
+        ((first + n - 1) & 0x1F)) << (pos % 32);
+
+    err = commLink_->fmc_send_read(spi_id_, &data);
+    if (err)
+      return err;
+
+    if (data.data_read.size() < (bits + 31) / 32)
+      return 1;
+
+    // register k is the (n - 1 - k)th word from the end of the frame
+    for (k = 0; k < n; k++) {
+      pos = 16 * (n - 1 - k);
+      val.push_back(data.data_read[pos / 32] >> (pos % 32));
+    }
+
+    first += n;
+  }
+
+  return 0;
 }
 
 int AMC7823_drv::AMC7823_checkReset(uint32_t chip_select) {
 
   uint16_t data;
 
-  data = AMC7823_spi_read(chip_select, 0x1, AMC_CONF); // default 0x4000
+  if (AMC7823_spi_read(chip_select, 0x1, AMC_CONF, &data) != 0) { // default 0x4000
+    cout << "AMC7823 read error" << endl;
+    return -1;
+  }
+
   //cout << "AMC data: 0x" << hex << data << endl;
   if (data & 0x4000) {
     cout << "AMC7823 reset done" << endl;
@@ -93,92 +167,129 @@ int AMC7823_drv::AMC7823_checkReset(uint32_t chip_select) {
 
 }
 
-void AMC7823_drv::AMC7823_config(uint32_t chip_select) {
+int AMC7823_drv::AMC7823_config(uint32_t chip_select) {
 
   uint16_t data;
+  int err;
+
+  err = AMC7823_spi_read(chip_select, 0x1, AMC_CONF, &data);
+  if (err)
+    return err;
 
-  data = AMC7823_spi_read(chip_select, 0x1, AMC_CONF);
   data &= 0x6000;
 
   // Internal refernece 1.25V, ADC input range 0 to 2.5V
   // ADC internal trigger mode
-  AMC7823_spi_write(chip_select, 0x1, AMC_CONF, data);
-  AMC7823_assert(chip_select, 0x1, AMC_CONF, data);
+  err = AMC7823_spi_write(chip_select, 0x1, AMC_CONF, data);
+  if (err)
+    return err;
+
+  err = AMC7823_assert(chip_select, 0x1, AMC_CONF, data);
+  if (err)
+    return err;
 
   // ADC direct mode (internal trigger)
   // read data from ADC0 to ADC8
   // writing to this register starts conversion (wait for DAV pin)
-  data = 0x0080;
-  AMC7823_spi_write(chip_select, 0x1, ADC_CTRL, data);
-  AMC7823_assert(chip_select, 0x1, ADC_CTRL, data);
+  ch_start_ = 0;
+  ch_end_ = 8;
+  data = ADC_CTRL_SA(ch_start_) | ADC_CTRL_EA(ch_end_);
+  err = AMC7823_spi_write(chip_select, 0x1, ADC_CTRL, data);
+  if (err)
+    return err;
+
+  return AMC7823_assert(chip_select, 0x1, ADC_CTRL, data);
 
 }
 
-void AMC7823_drv::AMC7823_powerUp(uint32_t chip_select) {
+int AMC7823_drv::AMC7823_setChannels(uint32_t chip_select, uint8_t start, uint8_t end) {
+
+  if (start > end || end > 8) {
+    cout << "AMC7823 wrong channel range: " << dec << unsigned(start) << "-" << unsigned(end) << endl;
+    return 1;
+  }
+
+  ch_start_ = start;
+  ch_end_ = end;
+
+  // starts conversion as well
+  return AMC7823_spi_write(chip_select, 0x1, ADC_CTRL, ADC_CTRL_SA(start) | ADC_CTRL_EA(end));
+
+}
+
+int AMC7823_drv::AMC7823_powerUp(uint32_t chip_select) {
 
   uint16_t data;
+  int err;
 
   // Power management
   // ADC - on
   // other - off
   data = 0x8000;
-  AMC7823_spi_write(chip_select, 0x1, PWR_DWN_CTRL, data);
-  AMC7823_assert(chip_select, 0x1, PWR_DWN_CTRL, data);
+  err = AMC7823_spi_write(chip_select, 0x1, PWR_DWN_CTRL, data);
+  if (err)
+    return err;
+
+  return AMC7823_assert(chip_select, 0x1, PWR_DWN_CTRL, data);
 
 }
 
-// ADC0, ADC1, ADC2, ADC3, on-chip temp
-vector<uint16_t> AMC7823_drv::AMC7823_getADCData(uint32_t ctrl_reg, uint32_t chip_select) {
+int AMC7823_drv::AMC7823_readADC(const struct gpio_field& dav, uint32_t chip_select, vector<uint16_t>& adc_data) {
 
-  uint16_t data;
-  vector<uint16_t> adc_data;
-  int repeat = 0;
+  unsigned int conv_us = (ch_end_ - ch_start_ + 1) * AMC7823_CONV_TIME_US;
+  gpio_int* gpio = (gpio_int*)commLink_->getIntDrv(gpio_id_);
+  uint32_t dav_val;
+  int repeat = 0, err;
+
+  adc_data.clear();
+
+  if (gpio == NULL) {
+    cout << "Interface not found!" << endl;
+    return 1;
+  }
 
   // trigger
-  data = 0x0080;
-  AMC7823_spi_write(chip_select, 0x1, ADC_CTRL, data);
+  err = AMC7823_spi_write(chip_select, 0x1, ADC_CTRL, ADC_CTRL_SA(ch_start_) | ADC_CTRL_EA(ch_end_));
+  if (err)
+    return err;
 
-  // wait for data (DAV pin) - conversion done
+  // wait for data (DAV pin) - conversion done, first check after whole range
   while (1) {
 
-    data_.wb_addr = ctrl_reg;
-    commLink_->fmc_read(gpio_id_, &data_);
+    usleep(repeat ? AMC7823_CONV_TIME_US : conv_us);
 
-    if ((data_.data_read[0] & 0x1) == 0) // DAV = 0 - conversion done
+    err = gpio->gpio_get(dav, &dav_val);
+    if (err)
+      return err;
+
+    if (dav_val == 0) // DAV = 0 - conversion done
       break;
 
     repeat++;
 
-    if (repeat > MAX_REPEAT) {
+    if (repeat > AMC7823_DAV_POLLS) {
       cout << "AMC7823 ADC conversion error!" << endl;
-      break;
+      return 1;
     }
-
-    usleep(100000);
   }
 
-  // read regs
-  //cout << "Reading data==========================================" << endl;
-
-  data = AMC7823_spi_read(chip_select, 0x0, ADC0_DATA);
-  adc_data.push_back(data);
-
-  data = AMC7823_spi_read(chip_select, 0x0, ADC1_DATA);
-  adc_data.push_back(data);
+  return AMC7823_spi_read_block(chip_select, 0x0, ADC0_DATA + ch_start_, ADC0_DATA + ch_end_, adc_data);
+}
 
-  data = AMC7823_spi_read(chip_select, 0x0, ADC2_DATA);
-  adc_data.push_back(data);
+// ADC0, ADC1, ADC2, ADC3, on-chip temp
+vector<uint16_t> AMC7823_drv::AMC7823_getADCData(const struct gpio_field& dav, uint32_t chip_select) {
 
-  data = AMC7823_spi_read(chip_select, 0x0, ADC3_DATA);
-  adc_data.push_back(data);
+  vector<uint16_t> adc, adc_data;
 
-  data = AMC7823_spi_read(chip_select, 0x0, ADC8_DATA);
-  adc_data.push_back(data);
+  // all channels in one burst
+  if ((ch_start_ != 0 || ch_end_ != 8) && AMC7823_setChannels(chip_select, 0, 8) != 0)
+    return adc_data;
 
-  //cout << "Reading data==========================================" << endl;
+  if (AMC7823_readADC(dav, chip_select, adc) != 0 || adc.size() != 9)
+    return adc_data;
 
-  //for (int i = 0; i < adc_data.size(); i++)
-  //  cout << "dane " << hex << adc_data[i] << endl;
+  adc_data.assign(adc.begin() + ADC0_DATA, adc.begin() + ADC3_DATA + 1);
+  adc_data.push_back(adc[ADC8_DATA]);
 
   return adc_data;
 }
@@ -196,11 +307,16 @@ float AMC7823_drv::AMC7823_tempConvert(uint16_t temp) {
 
 }
 
-void AMC7823_drv::AMC7823_assert(uint32_t chip_select, uint8_t page, uint8_t reg, uint16_t val) {
+int AMC7823_drv::AMC7823_assert(uint32_t chip_select, uint8_t page, uint8_t reg, uint16_t val) {
 
   uint16_t data;
+  int err;
 
-  data = AMC7823_spi_read(chip_select, page, reg);
+  err = AMC7823_spi_read(chip_select, page, reg, &data);
+  if (err) {
+    printf("AMC7823 assert, page: 0x%02x reg: 0x%02x read error\n", page, reg);
+    return err;
+  }
 
   //cout << "AMC7823 assert, reg: 0x" << hex << reg <<
   //    " val: 0x" << hex << unsigned(data) << " =? 0x" << hex << unsigned(val) << "...";
@@ -212,4 +328,6 @@ void AMC7823_drv::AMC7823_assert(uint32_t chip_select, uint8_t page, uint8_t reg
 
   printf("passed!\n");
 
+  return 0;
+
 }
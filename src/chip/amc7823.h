@@ -8,6 +8,7 @@
 
 #include "data.h"
 #include "commLink.h"
+#include "interface/gpio.h"
 
 class AMC7823_drv {
 public:
@@ -15,21 +16,39 @@ public:
   static void AMC7823_setCommLink(commLink* comm, string spi_id, string gpio_id);
 
   // only one word transfers
-  static void AMC7823_spi_write(uint32_t chip_select, uint8_t page, uint8_t reg, uint16_t val);
-  static uint16_t AMC7823_spi_read(uint32_t chip_select, uint8_t page, uint8_t reg);
+  // return - 0 ok, != 0 SPI error (val not changed)
+  static int AMC7823_spi_write(uint32_t chip_select, uint8_t page, uint8_t reg, uint16_t val);
+  static int AMC7823_spi_read(uint32_t chip_select, uint8_t page, uint8_t reg, uint16_t* val);
+  // block read of consecutive registers first..last (chip auto-increments address)
+  // return - 0 ok, otherwise SPI error
+  static int AMC7823_spi_read_block(uint32_t chip_select, uint8_t page, uint8_t first, uint8_t last,
+      vector<uint16_t>& val);
 
   // 1 - reset done
   // 0 - still in reset mode
+  // -1 - SPI error
   static int AMC7823_checkReset(uint32_t chip_select);
-  static void AMC7823_config(uint32_t chip_select);
-  static void AMC7823_powerUp(uint32_t chip_select);
+  // return - 0 ok, != 0 SPI error
+  static int AMC7823_config(uint32_t chip_select);
+  static int AMC7823_powerUp(uint32_t chip_select);
+
+  // channel range converted by one trigger (ADC0..ADC8, 8 - on-chip temp)
+  static int AMC7823_setChannels(uint32_t chip_select, uint8_t start, uint8_t end);
+
+  // burst measurement: conversion of channel range, DAV polled at conversion
+  // time granularity, ADC registers read with block reads
+  // dav - DAV pin field in FPGA control register (active low)
+  // adc_data[i] - channel start + i
+  // return - 0 ok, 1 conversion timeout, otherwise SPI error
+  static int AMC7823_readADC(const struct gpio_field& dav, uint32_t chip_select, vector<uint16_t>& adc_data);
 
   // perform ADC data measurement
   // ADC0, ADC1, ADC2, ADC3, on-chip temp
-  static vector<uint16_t> AMC7823_getADCData(uint32_t ctrl_reg, uint32_t chip_select);
+  static vector<uint16_t> AMC7823_getADCData(const struct gpio_field& dav, uint32_t chip_select);
   static float AMC7823_tempConvert(uint16_t temp);
 
-  static void AMC7823_assert(uint32_t chip_select, uint8_t page, uint8_t reg, uint16_t val);
+  // return - 0 value checked, != 0 SPI error (nothing to check)
+  static int AMC7823_assert(uint32_t chip_select, uint8_t page, uint8_t reg, uint16_t val);
 
 private:
 
@@ -37,6 +56,8 @@ private:
   static commLink* commLink_;
   static string spi_id_;
   static string gpio_id_;
+  static uint8_t ch_start_;
+  static uint8_t ch_end_;
 
 };
 
@@ -5,6 +5,8 @@
 //============================================================================
 #include "eeprom_24a64.h"
 
+#include <sys/time.h>
+
 #define MAX_REPEAT 10
 
 wb_data EEPROM_drv::data_;
@@ -16,7 +18,7 @@ void EEPROM_drv::EEPROM_setCommLink(commLink* comm, string i2c_id) {
 	commLink_ = comm;
 	i2c_id_ = i2c_id;
 	data_.data_send.resize(1);
-	data_.extra.resize(1);
+	data_.extra.resize(2);
 
 }
 
@@ -56,3 +58,122 @@ int EEPROM_drv::EEPROM_sendData(uint32_t chip_addr) {
 
 	return 0;
 }
+
+int EEPROM_drv::EEPROM_readData(uint32_t chip_addr, uint16_t mem_addr, unsigned int len,
+                                vector<uint32_t>& val) {
+
+	vector<struct wb_msg> msgs(2);
+	int err = 0;
+
+	// memory address, MSB first
+	msgs[0].addr = chip_addr;
+	msgs[0].flags = 0;
+	msgs[0].buf.push_back((mem_addr >> 8) & 0xFF);
+	msgs[0].buf.push_back(mem_addr & 0xFF);
+
+	msgs[1].addr = chip_addr;
+	msgs[1].flags = WB_MSG_RD;
+	msgs[1].buf.resize(len);
+
+	err = commLink_->fmc_transfer(i2c_id_, msgs);
+	if (err != 0) {
+		cout << "EEPROM: Error while reading data" << endl;
+		return err;
+	}
+
+	val = msgs[1].buf;
+
+	return 0;
+}
+
+int EEPROM_drv::EEPROM_writeData(uint32_t chip_addr, uint16_t mem_addr, const vector<uint32_t>& val) {
+
+	vector<struct wb_msg> msgs(1);
+	unsigned int pos, len;
+	int err = 0;
+
+	for (pos = 0; pos < val.size(); pos += len) {
+
+		len = EEPROM_PAGE_SIZE - (mem_addr + pos) % EEPROM_PAGE_SIZE;
+		if (len > val.size() - pos)
+			len = val.size() - pos;
+
+		// memory address, MSB first, then data of one page
+		msgs[0].addr = chip_addr;
+		msgs[0].flags = 0;
+		msgs[0].buf.clear();
+		msgs[0].buf.push_back(((mem_addr + pos) >> 8) & 0xFF);
+		msgs[0].buf.push_back((mem_addr + pos) & 0xFF);
+		msgs[0].buf.insert(msgs[0].buf.end(), val.begin() + pos, val.begin() + pos + len);
+
+		err = commLink_->fmc_transfer(i2c_id_, msgs);
+		if (err != 0) {
+			cout << "EEPROM: Error while writing data" << endl;
+			return err;
+		}
+
+		err = EEPROM_waitWrite(chip_addr);
+		if (err != 0)
+			return err;
+	}
+
+	return 0;
+}
+
+int EEPROM_drv::EEPROM_waitWrite(uint32_t chip_addr) {
+
+	vector<struct wb_msg> msgs(1);
+	struct timeval start, now;
+
+	msgs[0].addr = chip_addr;
+	msgs[0].flags = WB_MSG_PROBE;
+
+	gettimeofday(&start, NULL);
+
+	// address only write, acknowledged when write cycle is over
+	while (commLink_->fmc_transfer(i2c_id_, msgs) != 0) {
+
+		gettimeofday(&now, NULL);
+
+		if ((now.tv_sec - start.tv_sec) * 1000000 + (now.tv_usec - start.tv_usec) > EEPROM_POLL_TIMEOUT) {
+			cout << "EEPROM: Write cycle not finished" << endl;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+int EEPROM_drv::EEPROM_read(uint32_t chip_addr, uint16_t offset, unsigned int len, vector<uint8_t>& buf) {
+
+	vector<uint32_t> val;
+	int err = 0;
+
+	buf.clear();
+
+	if (offset + len > EEPROM_SIZE) {
+		cout << "EEPROM: Read out of range" << endl;
+		return 1;
+	}
+
+	if (len == 0)
+		return 0;
+
+	err = EEPROM_readData(chip_addr, offset, len, val);
+	if (err != 0)
+		return err;
+
+	buf.assign(val.begin(), val.end());
+
+	return 0;
+}
+
+int EEPROM_drv::EEPROM_write(uint32_t chip_addr, uint16_t offset, const vector<uint8_t>& buf) {
+
+	if (offset + buf.size() > EEPROM_SIZE) {
+		cout << "EEPROM: Write out of range" << endl;
+		return 1;
+	}
+
+	return EEPROM_writeData(chip_addr, offset, vector<uint32_t>(buf.begin(), buf.end()));
+}
@@ -9,6 +9,11 @@
 #include "data.h"
 #include "commLink.h"
 
+#define EEPROM_SIZE 0x2000 // bytes (64 kbit)
+#define EEPROM_PAGE_SIZE 32 // bytes, write must not cross page boundary
+#define EEPROM_WRITE_TIME 5000 // maximum write cycle time [us]
+#define EEPROM_POLL_TIMEOUT (2 * EEPROM_WRITE_TIME) // ack polling gives up [us]
+
 class EEPROM_drv {
 public:
 
@@ -20,12 +25,27 @@ public:
   // only check if EEPROM is present
   static int EEPROM_sendData(uint32_t chip_addr);
 
-  // not implemented
-  static int EEPROM_readData(uint32_t chip_addr);
+  // read len bytes starting at memory address mem_addr
+  // (address write, then read with repeated start)
+  static int EEPROM_readData(uint32_t chip_addr, uint16_t mem_addr, unsigned int len,
+                                vector<uint32_t>& val);
+
+  // write bytes starting at memory address mem_addr
+  // (split to page writes, end of each write cycle found by ack polling)
+  static int EEPROM_writeData(uint32_t chip_addr, uint16_t mem_addr, const vector<uint32_t>& val);
+
+  // Block access (offset + length within EEPROM_SIZE)
+  // read - one sequential read, write - page writes
+  // return - 0 ok, != 0 error
+  static int EEPROM_read(uint32_t chip_addr, uint16_t offset, unsigned int len, vector<uint8_t>& buf);
+  static int EEPROM_write(uint32_t chip_addr, uint16_t offset, const vector<uint8_t>& buf);
 
 
 private:
 
+  // waits for end of write cycle (chip does not acknowledge its address until then)
+  static int EEPROM_waitWrite(uint32_t chip_addr);
+
   static wb_data data_;
   static commLink* commLink_;
   static string i2c_id_;
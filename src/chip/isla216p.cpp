@@ -4,6 +4,8 @@
 // Description : Software driver for ISLA216P chip (ADC)
 //============================================================================
 #include "isla216p.h"
+#include "interface/gpio.h"
+#include "reg_map/fmc_config_250m_4ch.h"
 
 #define MAX_REPEAT 10
 
@@ -11,6 +13,7 @@ wb_data ISLA216P_drv::data_;
 commLink* ISLA216P_drv::commLink_;
 string ISLA216P_drv::spi_id_;
 string ISLA216P_drv::gpio_id_;
+int ISLA216P_drv::three_wire_;
 
 void ISLA216P_drv::ISLA216P_setCommLink(commLink* comm, string spi_id, string gpio_id) {
 
@@ -21,7 +24,12 @@ void ISLA216P_drv::ISLA216P_setCommLink(commLink* comm, string spi_id, string gp
   data_.extra.resize(2);
 }
 
-wb_data ISLA216P_drv::ISLA216P_spi_write(uint32_t chip_select, uint8_t reg, uint8_t val) {
+void ISLA216P_drv::ISLA216P_set3Wire(int enable) {
+
+  three_wire_ = enable;
+}
+
+int ISLA216P_drv::ISLA216P_spi_write(uint32_t chip_select, uint8_t reg, uint8_t val) {
 
   // chip address
   data_.extra[0] = chip_select;
@@ -36,16 +44,28 @@ wb_data ISLA216P_drv::ISLA216P_spi_write(uint32_t chip_select, uint8_t reg, uint
 
   //cout << "SPI writing: " << hex << data_.data_send[0] << endl;
 
-  commLink_->fmc_send(spi_id_, &data_);
+  return commLink_->fmc_send(spi_id_, &data_);
 
-  return data_;
+}
+
+// 1 if exactly one chip is selected
+int ISLA216P_drv::ISLA216P_single_chip(uint32_t chip_select) {
 
+  return chip_select != 0 && (chip_select & (chip_select - 1)) == 0;
 }
 
-wb_data ISLA216P_drv::ISLA216P_spi_read(uint32_t chip_select, uint8_t reg) {
+int ISLA216P_drv::ISLA216P_spi_read(uint32_t chip_select, uint8_t reg, uint8_t* val) {
+
+  int err;
 
   // chip address
   data_.data_read.clear();
+
+  if (!ISLA216P_single_chip(chip_select)) {
+    cout << "ISLA216P read error: one chip must be selected (0x" << hex << chip_select << ")" << endl;
+    return 1;
+  }
+
   data_.extra[0] = chip_select;
   // number of bits to read/write
   // 3 x 8 bits
@@ -55,19 +75,143 @@ wb_data ISLA216P_drv::ISLA216P_spi_read(uint32_t chip_select, uint8_t reg) {
   //data_.data_send[1] = reg; // register address (instruction header)
   //data_.data_send[2] = 0x80;// instruction header (read)
 
-  commLink_->fmc_send_read(spi_id_, &data_);
+  err = commLink_->fmc_send_read(spi_id_, &data_);
+  if (err)
+    return err;
+
+  if (data_.data_read.empty())
+    return 1;
+
+  *val = data_.data_read[0] & 0xFF;
+
+  return 0;
+
+}
+
+// Streaming transfer (W1:W0 = 11 for more than 3 bytes), MSB first
+// bytes - data bytes in transfer order (from address addr down)
+// whole transfer (instruction + data) is packed to TX regs, first byte in
+// highest bits, received bytes are in the same positions of RX regs
+int ISLA216P_drv::ISLA216P_spi_stream(uint32_t chip_select, int rd, uint16_t addr, vector<uint8_t>& bytes) {
+
+  wb_data data;
+  unsigned int i, bits, pos, num = bytes.size();
+  uint16_t instr;
+  int err;
+
+  if (num == 0 || num > ISLA216P_SPI_MAX_BYTES)
+    return 1;
+
+  // SDO lines are shared, reads only from one chip
+  if (rd && !ISLA216P_single_chip(chip_select))
+    return 1;
+
+  instr = (rd ? 0x8000 : 0x0000) | ((num > 3 ? 3 : num - 1) << 13) | (addr & 0x1FFF);
+  bits = 16 + 8 * num;
+
+  data.extra.resize(2);
+  data.extra[0] = chip_select;
+  data.extra[1] = bits;
+  data.data_send.assign((bits + 31) / 32, 0);
+
+  pos = bits - 8;
+  data.data_send[pos / 32] |= (uint32_t)(instr >> 8) << (pos % 32);
+  pos -= 8;
+  data.data_send[pos / 32] |= (uint32_t)(instr & 0xFF) << (pos % 32);
+
+  for (i = 0; i < num; i++) {
+    pos -= 8;
+    if (!rd)
+      data.data_send[pos / 32] |= (uint32_t)bytes[i] << (pos % 32);
+  }
+
+  if (!rd)
+    return commLink_->fmc_send(spi_id_, &data);
 
-  return data_;
+  err = commLink_->fmc_send_read(spi_id_, &data);
+  if (err)
+    return err;
 
+  if (data.data_read.size() < data.data_send.size())
+    return 1;
+
+  pos = 8 * num;
+  for (i = 0; i < num; i++) {
+    pos -= 8;
+    bytes[i] = (data.data_read[pos / 32] >> (pos % 32)) & 0xFF;
+  }
+
+  return 0;
+}
+
+// val[i] is written to reg + i, chunks are sent from the highest address
+// (address decrements in MSB first mode)
+int ISLA216P_drv::ISLA216P_spi_write_block(uint32_t chip_select, uint16_t reg, const vector<uint8_t>& val) {
+
+  vector<uint8_t> bytes;
+  unsigned int hi, lo, i;
+  int err;
+
+  for (hi = val.size(); hi > 0; hi = lo) {
+
+    lo = hi > ISLA216P_SPI_MAX_BYTES ? hi - ISLA216P_SPI_MAX_BYTES : 0;
+
+    bytes.clear();
+    for (i = hi; i > lo; i--)
+      bytes.push_back(val[i - 1]);
+
+    err = ISLA216P_spi_stream(chip_select, 0, reg + hi - 1, bytes);
+    if (err)
+      return err;
+  }
+
+  return 0;
+}
+
+// val[i] is value of reg + i
+int ISLA216P_drv::ISLA216P_spi_read_block(uint32_t chip_select, uint16_t reg, unsigned int len, vector<uint8_t>& val) {
+
+  vector<uint8_t> bytes;
+  unsigned int hi, lo, i;
+  int err;
+
+  val.assign(len, 0);
+
+  for (hi = len; hi > 0; hi = lo) {
+
+    lo = hi > ISLA216P_SPI_MAX_BYTES ? hi - ISLA216P_SPI_MAX_BYTES : 0;
+
+    bytes.assign(hi - lo, 0);
+
+    err = ISLA216P_spi_stream(chip_select, 1, reg + hi - 1, bytes);
+    if (err)
+      return err;
+
+    for (i = 0; i < bytes.size(); i++)
+      val[hi - 1 - i] = bytes[i];
+  }
+
+  return 0;
 }
 
 int ISLA216P_drv::ISLA216P_AutoCalibration(uint32_t ctrl_reg) {
 
-  ISLA216P_reset(ctrl_reg, 0x01); // turn off reset
-  sleep(1); // according to datasheet, maximum setup time for 250MHz clock is 200ms, maximum 550ms
-  ISLA216P_reset(ctrl_reg, 0x00); // turn on reset
+  struct gpio_field reset = { ctrl_reg, WB_ADC_ISLA_CTRL_RESET };
+  gpio_int* gpio = (gpio_int*)commLink_->getIntDrv(gpio_id_);
+  int err;
+
+  if (gpio == NULL) {
+    cout << "Interface not found!" << endl;
+    return 1;
+  }
+
+  err = gpio->gpio_set(reset, 1); // turn off reset
+  if (err)
+    return err;
   sleep(1); // according to datasheet, maximum setup time for 250MHz clock is 200ms, maximum 550ms
-  ISLA216P_reset(ctrl_reg, 0x01); // turn off reset
+  err = gpio->gpio_pulse(reset, 0, 1, 1000000); // turn on reset, turn off reset
+  if (err)
+    return err;
   sleep(1); // according to datasheet, maximum setup time for 250MHz clock is 200ms, maximum 550ms
 
   cout << "ISLA216P ADC chip auto-calibration done! Check status" << endl;
@@ -77,22 +221,27 @@ int ISLA216P_drv::ISLA216P_AutoCalibration(uint32_t ctrl_reg) {
 
 int ISLA216P_drv::ISLA216P_checkCalibration(uint32_t chip_select) {
 
-  int repeat = 0;
+  uint8_t val;
+  int repeat = 0, err;
 
   while (1) {
 
     // read reg
-    data_ = ISLA216P_spi_read(chip_select, 0xB6);
-    cout << "data isla " << hex << data_.data_read[0] << endl;
+    err = ISLA216P_spi_read(chip_select, 0xB6, &val);
+    if (err)
+      return err;
+
+    cout << "data isla " << hex << unsigned(val) << endl;
 
-    if (data_.data_read[0] & 0x01) // cal_status must be 1 - calibration done
+    if (val & 0x01) // cal_status must be 1 - calibration done
       break;
 
     sleep(1);
     repeat++;
 
-    if (repeat < MAX_REPEAT) {
+    if (repeat >= MAX_REPEAT) {
       cout << "EEROR: ISLA216P ADC chip calibration status: not done!" << endl;
+      return 1;
     }
   }
 
@@ -102,38 +251,45 @@ int ISLA216P_drv::ISLA216P_checkCalibration(uint32_t chip_select) {
 
 }
 
-// as described in wb_regs
-int ISLA216P_drv::ISLA216P_reset(uint32_t ctrl_reg, uint8_t mode) {
-
-  // get register value
-  uint32_t reg_val;
+// control register field access
+int ISLA216P_drv::ISLA216P_ctrl_set(uint32_t ctrl_reg, uint32_t mask, uint32_t val) {
 
-  data_.wb_addr = ctrl_reg;
+  struct gpio_field field = { ctrl_reg, mask };
+  gpio_int* gpio = (gpio_int*)commLink_->getIntDrv(gpio_id_);
 
-  commLink_->fmc_read(gpio_id_, &data_);
-  reg_val = data_.data_read[0];
+  if (gpio == NULL) {
+    cout << "Interface not found!" << endl;
+    return 1;
+  }
 
-  data_.data_send[0] = (reg_val & 0xFFFFFFFD) | ( (mode & 0x1) << 1);
+  return gpio->gpio_set(field, val);
+}
 
-  cout << "reset isla reg val: " << hex << data_.data_send[0] << endl;
+// as described in wb_regs
+int ISLA216P_drv::ISLA216P_reset(uint32_t ctrl_reg, uint8_t mode) {
 
-  commLink_->fmc_send(gpio_id_, &data_);
+  cout << "reset isla: " << hex << (mode & 0x1) << endl;
 
-  return 0;
+  return ISLA216P_ctrl_set(ctrl_reg, WB_ADC_ISLA_CTRL_RESET, mode & 0x1);
 }
 
 int ISLA216P_drv::ISLA216P_resetSPI(uint32_t chip_select, uint32_t ctrl_reg) {
 
   uint8_t val;
+  int err;
 
-  data_ = ISLA216P_spi_read(chip_select, 0x00);
+  err = ISLA216P_spi_read(chip_select, 0x00, &val);
+  if (err)
+    return err;
 
-  val = data_.data_read[0] | 0x20;
-  ISLA216P_spi_write(chip_select, 0x00, val);
+  err = ISLA216P_spi_write(chip_select, 0x00, val | 0x20);
+  if (err)
+    return err;
   sleep(1);
 
-  val = data_.data_read[0] & 0xFFFFFFDF;
-  ISLA216P_spi_write(chip_select, 0x00, val);
+  err = ISLA216P_spi_write(chip_select, 0x00, val & 0xDF);
+  if (err)
+    return err;
   sleep(1);
 
   return 0;
@@ -141,19 +297,13 @@ int ISLA216P_drv::ISLA216P_resetSPI(uint32_t chip_select, uint32_t ctrl_reg) {
 
 int ISLA216P_drv::ISLA216P_sleep(uint32_t ctrl_reg, uint8_t mode) {
 
-  // get register value
-  uint32_t reg_val;
-
-  data_.wb_addr = ctrl_reg;
+  int err;
 
-  commLink_->fmc_read(gpio_id_, &data_);
-  reg_val = data_.data_read[0];
+  cout << "sleep isla: " << hex << unsigned(mode) << endl;
 
-  data_.data_send[0] = (reg_val & 0xFFFFFFF3) | (mode << 2);
-
-  cout << "sleep isla reg val: " << hex << data_.data_send[0] << endl;
-
-  commLink_->fmc_send(gpio_id_, &data_);
+  err = ISLA216P_ctrl_set(ctrl_reg, WB_ADC_ISLA_CTRL_SLEEP, mode);
+  if (err)
+    return err;
 
   //usleep(100000); // TODO check timing
   sleep(1);
@@ -161,25 +311,53 @@ int ISLA216P_drv::ISLA216P_sleep(uint32_t ctrl_reg, uint8_t mode) {
   return 0;
 }
 
-int ISLA216P_drv::ISLA216P_sync(uint32_t ctrl_reg) {
+int ISLA216P_drv::ISLA216P_powerUp(uint32_t ctrl_reg) {
 
-  // get register value
-  uint32_t reg_val;
+  struct gpio_field sleep_mode = { ctrl_reg, WB_ADC_ISLA_CTRL_SLEEP };
+  struct gpio_field reset = { ctrl_reg, WB_ADC_ISLA_CTRL_RESET };
+  gpio_int* gpio = (gpio_int*)commLink_->getIntDrv(gpio_id_);
+  int err, commit_err;
 
-  data_.wb_addr = ctrl_reg;
+  if (gpio == NULL) {
+    cout << "Interface not found!" << endl;
+    return 1;
+  }
 
-  commLink_->fmc_read(gpio_id_, &data_);
-  reg_val = data_.data_read[0];
+  gpio->gpio_begin();
 
-  // set divclkrst reset to 0
-  data_.data_send[0] = reg_val & 0xFFFFFFFE;
-  commLink_->fmc_send(gpio_id_, &data_);
-  // wait
-  sleep(1);
+  err = gpio->gpio_set(sleep_mode, 0x00); // normal, power on
+  if (err == 0)
+    err = gpio->gpio_set(reset, 1); // turn off reset
+
+  // batch is closed also after error
+  commit_err = gpio->gpio_commit();
+  if (err == 0)
+    err = commit_err;
+  if (err)
+    return err;
+
+  sleep(1); // power-on calibration (500ms)
+
+  cout << "ISLA216P ADC chips powered up" << endl;
+
+  return 0;
+}
+
+int ISLA216P_drv::ISLA216P_sync(uint32_t ctrl_reg) {
+
+  struct gpio_field divclkrst = { ctrl_reg, WB_ADC_ISLA_CTRL_DIVCLKRST };
+  gpio_int* gpio = (gpio_int*)commLink_->getIntDrv(gpio_id_);
+  int err;
+
+  if (gpio == NULL) {
+    cout << "Interface not found!" << endl;
+    return 1;
+  }
 
-  // set divclkrst reset to 1
-  data_.data_send[0] = reg_val | 0x01;
-  commLink_->fmc_send(gpio_id_, &data_);
+  // divclkrst reset to 0 for 1 s, then back to 1
+  err = gpio->gpio_pulse(divclkrst, 0, 1, 1000000);
+  if (err)
+    return err;
   // wait
   sleep(2);
 
@@ -191,17 +369,27 @@ int ISLA216P_drv::ISLA216P_sync(uint32_t ctrl_reg) {
 
 int ISLA216P_drv::ISLA216P_config(uint32_t chip_select) {
 
-  uint16_t data_temp;
+  uint8_t data_temp;
+  uint32_t chip;
+  int err;
 
-  // activate SDO
-  ISLA216P_spi_write(chip_select, 0x00, 0x99);
+  // activate SDO (4-wire), in 3-wire mode data is read on SDIO
+  if (three_wire_)
+    err = ISLA216P_spi_write(chip_select, 0x00, 0x18);
+  else
+    err = ISLA216P_spi_write(chip_select, 0x00, 0x99);
+
+  if (err)
+    return err;
 
   // registers as offset, gain etc should be automatically set
   // after auto-calibration
 
   // modes_adc0
   // power down mode - pin control
-  ISLA216P_spi_write(chip_select, 0x25, 0x00);
+  err = ISLA216P_spi_write(chip_select, 0x25, 0x00);
+  if (err)
+    return err;
   // modes_adc1
 
   // phase_slip - no phase slip (no tests)
@@ -211,37 +399,335 @@ int ISLA216P_drv::ISLA216P_config(uint32_t chip_select) {
   //ISLA216P_spi_write(chip_select, 0x72, 0x02);
 
   // clock_divide - divide by 1
-  ISLA216P_spi_write(chip_select, 0x72, 0x01);
+  err = ISLA216P_spi_write(chip_select, 0x72, 0x01);
+  if (err)
+    return err;
 
   // output mode A
   // default LVDS 3mA, two's complement
   //ISLA216P_spi_write(chip_select, 0x73, 0x00);
-  ISLA216P_spi_write(chip_select, 0x73, 0x20);
+  err = ISLA216P_spi_write(chip_select, 0x73, 0x20);
+  if (err)
+    return err;
+
+  // read-modify-write and checks for each chip separately
+  for (chip = 1; chip != 0 && chip <= chip_select; chip <<= 1) {
+
+    if (!(chip_select & chip))
+      continue;
+
+    // output mode B - default is fast mode (ADC clock frequency)
+    err = ISLA216P_spi_read(chip, 0x74, &data_temp);
+    if (err)
+      return err;
+    //data_temp = 0x40 | data_temp; // low speed
+    data_temp = 0xBF & data_temp; // high speed
+    err = ISLA216P_spi_write(chip, 0x74, data_temp);
+    if (err)
+      return err;
+
+    // offset/gain adjust enable - not implemented in chip?
+
+    // check configuration
+    if ((err = ISLA216P_assert(chip, 0x25, 0x00)) != 0 ||
+        (err = ISLA216P_assert(chip, 0x72, 0x01)) != 0 ||
+        //(err = ISLA216P_assert(chip, 0x73, 0x00)) != 0 ||
+        (err = ISLA216P_assert(chip, 0x73, 0x20)) != 0 ||
+        (err = ISLA216P_assert(chip, 0x74, data_temp)) != 0)
+      return err;
+  }
+
+  return 0;
+}
+
+int ISLA216P_drv::ISLA216P_train_step(vector<struct isla216p_link>& links, const vector<uint32_t>& taps,
+    const vector<uint32_t>& clk_taps, unsigned int reads, vector<vector<uint16_t> >& words) {
 
-  // output mode B - default is fast mode (ADC clock frequency)
-  data_ = ISLA216P_spi_read(chip_select, 0x74);
-  //data_temp = 0x40 | data_.data_read[0]; // low speed
-  data_temp = 0xBF & data_.data_read[0]; // high speed
-  ISLA216P_spi_write(chip_select, 0x74, data_temp);
+  vector<struct wb_op> ops;
+  struct wb_op op;
+  unsigned int i, r, n;
+  int err;
+
+  op.mask = 0;
+  op.value = 0;
+  op.err_mask = 0;
+  op.retries = 0;
+  op.type = WB_OP_WRITE;
+
+  // taps loaded with update bit, then update bit cleared (as set_fpga_delay)
+  for (n = 0; n < 2 && !taps.empty(); n++) {
+    for (i = 0; i < links.size(); i++) {
+
+      op.addr = links[i].idelay_reg;
+      op.data = IDELAY_DATA_LINES | IDELAY_TAP(taps[i]) | (n == 0 ? IDELAY_UPDATE : 0);
+      ops.push_back(op);
+
+      if (clk_taps.empty() || !links[i].clk_scan)
+        continue;
+
+      op.data = IDELAY_CLK_LINE | IDELAY_TAP(clk_taps[i]) | (n == 0 ? IDELAY_UPDATE : 0);
+      ops.push_back(op);
+    }
+  }
+
+  // data registers of all links read in turn
+  op.type = WB_OP_READ;
+  op.data = 0;
+
+  for (r = 0; r < reads; r++) {
+    for (i = 0; i < links.size(); i++) {
+      op.addr = links[i].data_reg;
+      ops.push_back(op);
+    }
+  }
 
-  // offset/gain adjust enable - not implemented in chip?
+  err = commLink_->fmc_config_exec(ops);
+  if (err)
+    return err;
 
-  // check configuration
-  ISLA216P_assert(chip_select, 0x25, 0x00);
-  ISLA216P_assert(chip_select, 0x72, 0x01);
-  //ISLA216P_assert(chip_select, 0x73, 0x00);
-  ISLA216P_assert(chip_select, 0x73, 0x20);
-  ISLA216P_assert(chip_select, 0x74, data_temp);
+  words.assign(links.size(), vector<uint16_t>());
+
+  n = ops.size() - reads * links.size();
+  for (r = 0; r < reads; r++)
+    for (i = 0; i < links.size(); i++)
+      words[i].push_back(ops[n++].data & ISLA216P_DATA_MASK);
 
   return 0;
 }
 
-int ISLA216P_drv::ISLA216P_train(uint32_t chip_select) {
+// positions of delay axis to data and clock line taps
+void ISLA216P_drv::ISLA216P_train_taps(const vector<int>& pos, vector<uint32_t>& taps, vector<uint32_t>& clk_taps) {
 
-  cout << "ISLA216P ADC chip - function not implemented" << endl;
+  unsigned int i;
 
-  return 0;
+  taps.assign(pos.size(), 0);
+  clk_taps.assign(pos.size(), 0);
+
+  for (i = 0; i < pos.size(); i++) {
+    if (pos[i] > 0)
+      taps[i] = pos[i];
+    else
+      clk_taps[i] = -pos[i];
+  }
+}
+
+int ISLA216P_drv::ISLA216P_train(uint32_t ctrl_reg, vector<struct isla216p_link>& links) {
+
+  // stage 2 cycle (toggling bits on both clock edges)
+  static const uint16_t train_cycle[] = { 0x3C96, 0xC369, 0x5AA5 };
+  // positions -(taps - 1) .. (taps - 1), index p + taps - 1
+  vector<vector<int> > pass(links.size(), vector<int>(2 * ISLA216P_TRAIN_TAPS - 1, 0));
+  vector<vector<uint16_t> > words;
+  vector<uint16_t> pattern;
+  vector<int> pos(links.size(), 0);
+  vector<uint32_t> taps, clk_taps;
+  uint32_t chips = 0;
+  unsigned int i, j, k, n;
+  int err, p, lo = 0, run, failed = 0;
+
+  if (links.empty())
+    return 1;
+
+  for (i = 0; i < links.size(); i++) {
+    chips |= links[i].chip_select;
+    links[i].first = 0;
+    links[i].last = -1;
+    links[i].tap = 0;
+    links[i].clk_tap = 0;
+    links[i].errors = 0;
+
+    if (links[i].clk_scan)
+      lo = 1 - ISLA216P_TRAIN_TAPS;
+  }
+
+  // stage 1 - one word, sweep all positions (links without clock sweep
+  // stay on data tap 0 for negative positions)
+  pattern.assign(4, ISLA216P_TRAIN_WORD);
+  err = ISLA216P_setTestPattern(chips, ISLA216P_TRAIN_MODE, pattern);
+  if (err) {
+    cout << "ISLA216P train: SPI error" << endl;
+    return err;
+  }
+
+  for (p = lo; p < ISLA216P_TRAIN_TAPS; p++) {
+
+    for (i = 0; i < links.size(); i++)
+      pos[i] = (p < 0 && !links[i].clk_scan) ? 0 : p;
+
+    ISLA216P_train_taps(pos, taps, clk_taps);
+
+    err = ISLA216P_train_step(links, taps, clk_taps, ISLA216P_TRAIN_READS, words);
+    if (err) {
+      cout << "ISLA216P train: FPGA link error" << endl;
+      ISLA216P_TestPatternOff(chips);
+      return err;
+    }
+
+    for (i = 0; i < links.size(); i++) {
+
+      if (pos[i] != p)
+        continue;
+
+      pass[i][p + ISLA216P_TRAIN_TAPS - 1] = 1;
+      for (j = 0; j < words[i].size(); j++)
+        if (words[i][j] != ISLA216P_TRAIN_WORD)
+          pass[i][p + ISLA216P_TRAIN_TAPS - 1] = 0;
+    }
+  }
+
+  // middle of widest error free window
+  for (i = 0; i < links.size(); i++) {
+
+    run = 0;
+
+    for (p = lo; p < ISLA216P_TRAIN_TAPS; p++) {
+
+      run = pass[i][p + ISLA216P_TRAIN_TAPS - 1] ? run + 1 : 0;
+
+      if (run > links[i].last - links[i].first + 1) {
+        links[i].first = p + 1 - run;
+        links[i].last = p;
+      }
+    }
+
+    pos[i] = 0;
+
+    if (links[i].first <= links[i].last) {
+      pos[i] = (links[i].first + links[i].last) / 2;
+      links[i].tap = pos[i] > 0 ? pos[i] : 0;
+      links[i].clk_tap = pos[i] < 0 ? -pos[i] : 0;
+    }
+  }
+
+  // stage 2 - 3 word cycle on selected taps
+  pattern.assign(train_cycle, train_cycle + 3);
+  err = ISLA216P_setTestPattern(chips, ISLA216P_TRAIN_MODE, pattern);
+
+  ISLA216P_train_taps(pos, taps, clk_taps);
+
+  if (!err)
+    err = ISLA216P_train_step(links, taps, clk_taps, ISLA216P_TRAIN_CYCLE_READS, words);
+
+  // stage 3 - sync all chips, then check samples
+  if (!err)
+    err = ISLA216P_sync(ctrl_reg);
+
+  for (n = 0; !err && n <= ISLA216P_TRAIN_SAMPLES; n += ISLA216P_TRAIN_BATCH) {
+
+    // words of stage 2 (n = 0) or previous batch
+    for (i = 0; i < links.size(); i++) {
+      for (j = 0; j < words[i].size(); j++) {
+
+        for (k = 0; k < 3; k++)
+          if (words[i][j] == train_cycle[k])
+            break;
+
+        if (k == 3)
+          links[i].errors++;
+      }
+    }
+
+    if (n < ISLA216P_TRAIN_SAMPLES)
+      err = ISLA216P_train_step(links, vector<uint32_t>(), vector<uint32_t>(), ISLA216P_TRAIN_BATCH, words);
+  }
+
+  if (ISLA216P_TestPatternOff(chips) != 0 && !err)
+    err = 1;
+
+  if (err) {
+    cout << "ISLA216P train: FPGA link error" << endl;
+    return err;
+  }
+
+  for (i = 0; i < links.size(); i++) {
+
+    printf("ISLA216P train: ADC 0x%02x window %d - %d, data tap %u, clock tap %u, errors %u/%u\n",
+        links[i].chip_select, links[i].first, links[i].last, links[i].tap, links[i].clk_tap,
+        links[i].errors, ISLA216P_TRAIN_CYCLE_READS + ISLA216P_TRAIN_SAMPLES);
+
+    if (links[i].first > links[i].last || links[i].errors)
+      failed = 1;
+  }
+
+  return failed;
+}
+
+int ISLA216P_drv::ISLA216P_eye_map(vector<struct isla216p_link>& links, unsigned int samples,
+    vector<vector<uint32_t> >& errors) {
+
+  vector<struct isla216p_link> scan(links), open;
+  vector<vector<uint16_t> > words;
+  vector<uint16_t> pattern(4, ISLA216P_TRAIN_WORD);
+  vector<uint32_t> taps(links.size()), clk_taps(links.size());
+  vector<unsigned int> idx;
+  uint32_t chips = 0;
+  unsigned int i, j, tap, clk_tap, cell, reads, n;
+  int err = 0;
+
+  if (links.empty() || samples == 0)
+    return 1;
+
+  errors.assign(links.size(), vector<uint32_t>(ISLA216P_TRAIN_TAPS * ISLA216P_TRAIN_TAPS, 0));
+
+  for (i = 0; i < links.size(); i++) {
+    chips |= links[i].chip_select;
+    scan[i].clk_scan = 1;
+  }
+
+  err = ISLA216P_setTestPattern(chips, ISLA216P_TRAIN_MODE, pattern);
+
+  for (clk_tap = 0; !err && clk_tap < ISLA216P_TRAIN_TAPS; clk_tap++) {
+    for (tap = 0; !err && tap < ISLA216P_TRAIN_TAPS; tap++) {
+
+      cell = clk_tap * ISLA216P_TRAIN_TAPS + tap;
+
+      // taps of all links with first batch, then more batches only for
+      // links without errors in this cell
+      taps.assign(links.size(), tap);
+      clk_taps.assign(links.size(), clk_tap);
+      open = scan;
+      idx.clear();
+      for (i = 0; i < links.size(); i++)
+        idx.push_back(i);
+
+      for (n = 0; !err && n < samples && !open.empty(); n += reads) {
+
+        reads = samples - n < ISLA216P_TRAIN_BATCH ? samples - n : ISLA216P_TRAIN_BATCH;
+
+        err = ISLA216P_train_step(open, n == 0 ? taps : vector<uint32_t>(),
+            n == 0 ? clk_taps : vector<uint32_t>(), reads, words);
+
+        for (i = open.size(); !err && i > 0; i--) {
+
+          for (j = 0; j < words[i - 1].size(); j++)
+            if (words[i - 1][j] != ISLA216P_TRAIN_WORD)
+              errors[idx[i - 1]][cell]++;
+
+          if (errors[idx[i - 1]][cell]) {
+            open.erase(open.begin() + i - 1);
+            idx.erase(idx.begin() + i - 1);
+          }
+        }
+      }
+    }
+  }
+
+  // back to taps of links (as trained)
+  for (i = 0; i < links.size(); i++) {
+    taps[i] = links[i].tap;
+    clk_taps[i] = links[i].clk_tap;
+  }
 
+  if (!err)
+    err = ISLA216P_train_step(scan, taps, clk_taps, 0, words);
+
+  if (ISLA216P_TestPatternOff(chips) != 0 && !err)
+    err = 1;
+
+  if (err)
+    cout << "ISLA216P eye map: FPGA link error" << endl;
+
+  return err;
 }
 
 // mode - output test mode
@@ -253,76 +739,105 @@ int ISLA216P_drv::ISLA216P_train(uint32_t chip_select) {
 int ISLA216P_drv::ISLA216P_setTestPattern(uint32_t chip_select, uint8_t mode, vector<uint16_t> test_pattern) {
 
   uint32_t reg_addr = 0xC1; // user_patt1_lsb
+  vector<uint8_t> patt(2);
+  int err;
 
   if (mode != 0) {
     for (unsigned int i = 0; i < test_pattern.size() && i < 4; i++) {
-      ISLA216P_spi_write(chip_select, reg_addr+i*4, (test_pattern[i] & 0xFF)); // user_pattX_lsb
-      ISLA216P_spi_write(chip_select, reg_addr+i*4+1, ( (test_pattern[i] >> 8) & 0xFF) ); // user_pattX_msb
+      patt[0] = test_pattern[i] & 0xFF; // user_pattX_lsb
+      patt[1] = (test_pattern[i] >> 8) & 0xFF; // user_pattX_msb
+      err = ISLA216P_spi_write_block(chip_select, reg_addr+i*4, patt);
+      if (err)
+        return err;
     }
   }
 
-  ISLA216P_spi_write(chip_select, 0xC0, mode);
-
-  return 0;
+  return ISLA216P_spi_write(chip_select, 0xC0, mode);
 }
 
 int ISLA216P_drv::ISLA216P_TestPatternOff(uint32_t chip_select) {
 
-  ISLA216P_spi_write(chip_select, 0xC0, 0x00);
-
-  return 0;
+  return ISLA216P_spi_write(chip_select, 0xC0, 0x00);
 
 }
 
-uint32_t ISLA216P_drv::ISLA216P_getTemp(uint32_t chip_select) {
+int ISLA216P_drv::ISLA216P_getTemp(uint32_t chip_select, uint32_t* temp) {
 
-  uint16_t temp;
+  uint8_t msb, lsb;
+  int err;
 
   // as in ISLA216P ADC chip datasheet page 28
-  ISLA216P_spi_write(chip_select, 0x4D, 0xCA);
+  err = ISLA216P_spi_write(chip_select, 0x4D, 0xCA);
+  if (err)
+    return err;
   usleep(500);
-  ISLA216P_spi_write(chip_select, 0x4D, 0x20);
+  err = ISLA216P_spi_write(chip_select, 0x4D, 0x20);
+  if (err)
+    return err;
 
-  data_ = ISLA216P_spi_read(chip_select, 0x4B); // msb
-  temp = (data_.data_read[0] & 0xFF) << 8;
+  err = ISLA216P_spi_read(chip_select, 0x4B, &msb); // msb
+  if (err)
+    return err;
 
-  data_ = ISLA216P_spi_read(chip_select, 0x4C); // lsb
-  temp = temp | (data_.data_read[0] & 0xFF);
+  err = ISLA216P_spi_read(chip_select, 0x4C, &lsb); // lsb
+  if (err)
+    return err;
 
-  // set back to IPTAT mode
-  ISLA216P_spi_write(chip_select, 0x4D, 0x20);
+  *temp = (msb << 8) | lsb;
 
-  return temp;
+  // set back to IPTAT mode
+  return ISLA216P_spi_write(chip_select, 0x4D, 0x20);
 }
 
-uint32_t ISLA216P_drv::ISLA216P_getChipID(uint32_t chip_select) {
+int ISLA216P_drv::ISLA216P_getChipID(uint32_t chip_select, uint32_t* id) {
 
-  data_ = ISLA216P_spi_read(chip_select, 0x08);
+  uint8_t val;
+  int err;
+
+  err = ISLA216P_spi_read(chip_select, 0x08, &val);
+  if (err)
+    return err;
 
-  return data_.data_read[0];
+  *id = val;
+
+  return 0;
 
 }
 
-uint32_t ISLA216P_drv::ISLA216P_getChipVersion(uint32_t chip_select) {
+int ISLA216P_drv::ISLA216P_getChipVersion(uint32_t chip_select, uint32_t* version) {
+
+  uint8_t val;
+  int err;
+
+  err = ISLA216P_spi_read(chip_select, 0x09, &val);
+  if (err)
+    return err;
 
-  data_ = ISLA216P_spi_read(chip_select, 0x09);
+  *version = val;
 
-  return data_.data_read[0];
+  return 0;
 }
 
-void ISLA216P_drv::ISLA216P_assert(uint32_t chip_select, uint8_t reg, uint8_t val) {
+int ISLA216P_drv::ISLA216P_assert(uint32_t chip_select, uint8_t reg, uint8_t val) {
 
-  data_ = ISLA216P_spi_read(chip_select, reg);
+  uint8_t data;
+  int err;
+
+  err = ISLA216P_spi_read(chip_select, reg, &data);
+  if (err) {
+    printf("ISLA216P assert, reg: 0x%02x read error\n", reg);
+    return err;
+  }
 
   //cout << "ISLA216P assert, reg: 0x" << hex << reg <<
-  //    " val: 0x" << hex << unsigned(data_.data_read[0] & 0xFF) << " =? 0x" << hex << unsigned(val) << "...";
+  //    " val: 0x" << hex << unsigned(data) << " =? 0x" << hex << unsigned(val) << "...";
 
-  printf("ISLA216P assert, reg: 0x%02x val: 0x%02x =? 0x%02x...", reg, data_.data_read[0] & 0xFF, val);
+  printf("ISLA216P assert, reg: 0x%02x val: 0x%02x =? 0x%02x...", reg, data, val);
 
-  assert( (data_.data_read[0] & 0xFF) == val);
+  assert(data == val);
 
   printf("passed!\n");
 
-}
-
+  return 0;
 
+}
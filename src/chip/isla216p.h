@@ -9,38 +9,96 @@
 #include "data.h"
 #include "commLink.h"
 
+// data bytes per SPI transfer (16 bit instruction, up to 127 bits shifted)
+#define ISLA216P_SPI_MAX_BYTES 13
+// instruction length, data line turnaround in 3-wire mode
+#define ISLA216P_SPI_INSTR_BITS 16
+
+// data link training
+#define ISLA216P_TRAIN_MODE 0x83 // user test pattern (cycle of user patterns)
+#define ISLA216P_TRAIN_TAPS 32 // IDELAY taps (data and clock lines)
+#define ISLA216P_TRAIN_READS 8 // data reads per tap (stage 1)
+#define ISLA216P_TRAIN_CYCLE_READS 64 // data reads (stage 2)
+#define ISLA216P_TRAIN_SAMPLES 1024 // data reads (stage 3)
+#define ISLA216P_TRAIN_BATCH 64 // data reads per channel in one Wishbone batch
+#define ISLA216P_DATA_MASK 0xFFFF // sample in FPGA data register
+#define ISLA216P_TRAIN_WORD 0xA55A // stage 1 and eye map pattern
+#define ISLA216P_EYE_SAMPLES 256 // data reads per eye map cell
+
+// ADC data link (FPGA side) and training result
+// Delay is swept on one axis: position p >= 0 - data lines tap p (clock tap 0),
+// p < 0 - clock line tap -p (data tap 0), delaying clock moves data earlier
+struct isla216p_link {
+  uint32_t chip_select; // ISLA_ADCx_ADDR
+  uint32_t idelay_reg;  // IDELAY register of data and clock lines (like WB_IDELAY0_CAL)
+  uint32_t data_reg;    // captured data register (like WB_DATA0)
+  int clk_scan;         // 1 - sweep clock line too (negative positions)
+  int first;            // error free window (stage 1), positions, first > last - not found
+  int last;
+  uint32_t tap;         // data lines tap set (middle of window)
+  uint32_t clk_tap;     // clock line tap set
+  uint32_t errors;      // wrong samples (stages 2 and 3)
+};
+
 class ISLA216P_drv {
 public:
 
   static void ISLA216P_setCommLink(commLink* comm, string spi_id, string gpio_id);
-
-  static wb_data ISLA216P_spi_write(uint32_t chip_select, uint8_t reg, uint8_t val);
-  static wb_data ISLA216P_spi_read(uint32_t chip_select, uint8_t reg);
+  // 1 - chips are read in 3-wire mode (SDIO line, SDO not activated by ISLA216P_config),
+  // SPI core must read chip selects in bidirectional mode (spi_int::spi_set_read_mode)
+  // 0 - 4-wire mode (default)
+  static void ISLA216P_set3Wire(int enable);
+
+  // write - chip_select may be mask of several chips (broadcast)
+  // read - only one chip (SDO lines are shared)
+  // return - 0 ok, != 0 SPI error (val not changed)
+  static int ISLA216P_spi_write(uint32_t chip_select, uint8_t reg, uint8_t val);
+  static int ISLA216P_spi_read(uint32_t chip_select, uint8_t reg, uint8_t* val);
+
+  // register block write/read (streaming instruction, auto address),
+  // up to ISLA216P_SPI_MAX_BYTES registers per SPI transfer
+  // return - 0 ok, != 0 SPI error
+  static int ISLA216P_spi_write_block(uint32_t chip_select, uint16_t reg, const vector<uint8_t>& val);
+  static int ISLA216P_spi_read_block(uint32_t chip_select, uint16_t reg, unsigned int len, vector<uint8_t>& val);
 
   // mode = 0 - normal, power on
   // mode = 1 - nap
   // mode = 2 - sleep
   static int ISLA216P_sleep(uint32_t ctrl_reg, uint8_t mode);
+  // normal power mode and reset released with one control register write,
+  // then power-on calibration time
+  static int ISLA216P_powerUp(uint32_t ctrl_reg);
 
-  // resets all ADC ISLA chips (one line)
+  // resets all ADC ISLA chips (one line, reset pulse)
   // and perform auto-calibration
   // Note: must check idependently each chip if calibration is done (with checkCalibration)
   static int ISLA216P_AutoCalibration(uint32_t ctrl_reg);
   // Check if calibration is done
   static int ISLA216P_checkCalibration(uint32_t chip_select);
 
+  // chip_select may select several chips (like ISLA_ADC_ALL_ADDR), writes are
+  // broadcast to all of them, reads and checks are done chip by chip
   static int ISLA216P_config(uint32_t chip_select);
 
   // Sync multiple ADC ISLA chips (clock phase) - clkdivrst
   // to use this feature clock must be divided at least 2x!
   static int ISLA216P_sync(uint32_t ctrl_reg);
 
-  // Train communication link
-  // (turns on test pattern)
-  // stage1 - one word (get middle of data window)
+  // Train communication link (all links concurrently, Wishbone accesses
+  // of links are interleaved in one batch)
+  // (turns on test pattern, turned off at the end)
+  // stage1 - one word, sweep all taps (get middle of data window)
   // stage2 - check for 3 word cycle
-  // stage3 - sync all chips (no phase offset) 1024 samples
-  static int ISLA216P_train(uint32_t chip_select);
+  // stage3 - sync all chips (ctrl_reg), then 1024 samples
+  // return - 0 all links trained, 1 some link failed (see links)
+  static int ISLA216P_train(uint32_t ctrl_reg, vector<struct isla216p_link>& links);
+
+  // Eye map - data lines tap vs clock line tap (all links concurrently)
+  // errors[i][clk_tap * ISLA216P_TRAIN_TAPS + tap] - wrong samples of links[i]
+  // out of samples, reading of cell stops after first batch with errors
+  // (turns on test pattern, turned off at the end, taps of links are restored)
+  static int ISLA216P_eye_map(vector<struct isla216p_link>& links, unsigned int samples,
+      vector<vector<uint32_t> >& errors);
 
   // Test pattern
   // mode - output test mode (as in ISLA datasheet)
@@ -49,6 +107,7 @@ public:
   // 2 = cycle pattern 1,3
   // 3 = cycle pattern 1,3,5
   // 4 = cycle pattern 1,3,5,7
+  // write only, chip_select may select several chips (same pattern)
   static int ISLA216P_setTestPattern(uint32_t chip_select, uint8_t mode, vector<uint16_t> test_pattern);
   static int ISLA216P_TestPatternOff(uint32_t chip_select);
 
@@ -58,20 +117,32 @@ public:
   static int ISLA216P_resetSPI(uint32_t chip_select, uint32_t ctrl_reg);
 
   // Temperature
-  // returns temp value
-  static uint32_t ISLA216P_getTemp(uint32_t chip_select);
+  // temp - temperature value
+  static int ISLA216P_getTemp(uint32_t chip_select, uint32_t* temp);
 
-  static uint32_t ISLA216P_getChipID(uint32_t chip_select);
-  static uint32_t ISLA216P_getChipVersion(uint32_t chip_select);
+  static int ISLA216P_getChipID(uint32_t chip_select, uint32_t* id);
+  static int ISLA216P_getChipVersion(uint32_t chip_select, uint32_t* version);
 
-  static void ISLA216P_assert(uint32_t chip_select, uint8_t reg, uint8_t val);
+  // return - 0 value checked, != 0 SPI error (nothing to check)
+  static int ISLA216P_assert(uint32_t chip_select, uint8_t reg, uint8_t val);
 
 private:
 
+  static int ISLA216P_single_chip(uint32_t chip_select);
+  static int ISLA216P_ctrl_set(uint32_t ctrl_reg, uint32_t mask, uint32_t val);
+  // IDELAY taps of all links (empty - taps not changed, clock line only for
+  // links with clk_scan), then reads data registers (reads per link)
+  // words[i] - values read for links[i]
+  static int ISLA216P_train_step(vector<struct isla216p_link>& links, const vector<uint32_t>& taps,
+      const vector<uint32_t>& clk_taps, unsigned int reads, vector<vector<uint16_t> >& words);
+  static void ISLA216P_train_taps(const vector<int>& pos, vector<uint32_t>& taps, vector<uint32_t>& clk_taps);
+  static int ISLA216P_spi_stream(uint32_t chip_select, int rd, uint16_t addr, vector<uint8_t>& bytes);
+
   static wb_data data_;
   static commLink* commLink_;
   static string spi_id_;
   static string gpio_id_;
+  static int three_wire_;
 };
 
 #endif /* ISLA216P_H_ */
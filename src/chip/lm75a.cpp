@@ -16,12 +16,12 @@ void LM75A_drv::LM75A_setCommLink(commLink* comm, string i2c_id) {
   commLink_ = comm;
   i2c_id_ = i2c_id;
   data_.data_send.resize(2);
-  data_.extra.resize(1);
+  data_.extra.resize(2);
 
 }
 
 // pointer register (chip have timeout)
-void LM75A_drv::LM75A_setPtrReg(uint16_t chip_addr, uint32_t reg) {
+int LM75A_drv::LM75A_setPtrReg(uint16_t chip_addr, uint32_t reg) {
 
   data_.data_send.resize(1);
 
@@ -29,32 +29,58 @@ void LM75A_drv::LM75A_setPtrReg(uint16_t chip_addr, uint32_t reg) {
   data_.extra[1] = 1;
   data_.data_send[0] = reg;
 
-  commLink_->fmc_send(i2c_id_, &data_);
+  return commLink_->fmc_send(i2c_id_, &data_);
 
 }
 
-void LM75A_drv::LM75A_setConfig(uint16_t chip_addr, uint8_t data) {
+int LM75A_drv::LM75A_setConfig(uint16_t chip_addr, uint8_t data) {
 
   data_.data_send.resize(2); // ??? or 1
 
   data_.extra[0] = chip_addr;
   data_.data_send[0] = 0x01; // config reg
   data_.data_send[1] = data;
-  commLink_->fmc_send(i2c_id_, &data_);
+
+  return commLink_->fmc_send(i2c_id_, &data_);
 
 }
 
-float LM75A_drv::LM75A_readTemp(uint16_t chip_addr) {
+void LM75A_drv::LM75A_readRegMsgs(uint16_t chip_addr, uint8_t reg, unsigned int len, vector<struct wb_msg>& msgs) {
 
-  int16_t temp_data;
-  data_.data_send.resize(1);
+  msgs.resize(2);
 
-  data_.extra[0] = chip_addr;
-  data_.extra[1] = 2;
-  data_.data_send[0] = 0x00; // temp reg
-  commLink_->fmc_send_read(i2c_id_, &data_);
+  msgs[0].addr = chip_addr;
+  msgs[0].flags = 0;
+  msgs[0].buf.assign(1, reg);
+
+  msgs[1].addr = chip_addr;
+  msgs[1].flags = WB_MSG_RD;
+  msgs[1].buf.assign(len, 0);
+}
+
+int LM75A_drv::LM75A_readReg(uint16_t chip_addr, uint8_t reg, unsigned int len, vector<uint32_t>& val) {
+
+  vector<struct wb_msg> msgs;
+  int err;
+
+  LM75A_readRegMsgs(chip_addr, reg, len, msgs);
 
-  temp_data = ((data_.data_read[0] & 0xFF) << 8) | (data_.data_read[1] & 0x80);
+  err = commLink_->fmc_transfer(i2c_id_, msgs);
+  if (err != 0) {
+    cout << "LM75A: Error while reading register 0x" << hex << (int)reg << endl;
+    return err;
+  }
+
+  val = msgs[1].buf;
+
+  return 0;
+}
+
+float LM75A_drv::LM75A_decodeTemp(const vector<uint32_t>& val) {
+
+  int16_t temp_data;
+
+  temp_data = ((val[0] & 0xFF) << 8) | (val[1] & 0x80);
   temp_data = temp_data >> 7;
 
   // copy sign bit (is value is less then 0, two's complement data format)
@@ -64,19 +90,58 @@ float LM75A_drv::LM75A_readTemp(uint16_t chip_addr) {
   return temp_data * 0.5;
 }
 
-uint16_t LM75A_drv::LM75A_readID(uint16_t chip_addr) {
+int LM75A_drv::LM75A_readTemp(uint16_t chip_addr, float* temp) {
 
-  data_.data_send.resize(1);
+  vector<uint32_t> val;
+  int err;
 
-  data_.extra[0] = chip_addr;
-  data_.extra[1] = 1; // only one byte read
-  data_.data_send[0] = 0x07; // id reg
-  commLink_->fmc_send_read(i2c_id_, &data_);
+  err = LM75A_readReg(chip_addr, 0x00, 2, val); // temp reg
+  if (err)
+    return err;
+
+  *temp = LM75A_decodeTemp(val);
+
+  return 0;
+}
+
+void LM75A_drv::LM75A_readTempJob(uint16_t chip_addr, struct wb_job* job) {
 
-  return (data_.data_read[0] & 0xFF);
+  job->int_name = i2c_id_;
+  job->type = WB_JOB_TRANSFER;
+  job->status = 0;
 
+  LM75A_readRegMsgs(chip_addr, 0x00, 2, job->msgs); // temp reg
 }
 
+int LM75A_drv::LM75A_readTempResult(const struct wb_job* job, float* temp) {
+
+  if (job->status != 0) {
+    cout << "LM75A: Error while reading register 0x0" << endl;
+    return job->status;
+  }
+
+  if (job->msgs.size() < 2 || job->msgs[1].buf.size() < 2)
+    return 1;
+
+  *temp = LM75A_decodeTemp(job->msgs[1].buf);
+
+  return 0;
+}
+
+int LM75A_drv::LM75A_readID(uint16_t chip_addr, uint16_t* id) {
+
+  vector<uint32_t> val;
+  int err;
+
+  err = LM75A_readReg(chip_addr, 0x07, 1, val); // id reg, only one byte read
+  if (err)
+    return err;
+
+  *id = (val[0] & 0xFF);
+
+  return 0;
+
+}
 
 /*
 void LM75A_drv::LM75A_drv_assert(uint32_t chip_addr, uint8_t reg, uint8_t val) {
@@ -14,12 +14,18 @@ public:
 
   static void LM75A_setCommLink(commLink* comm, string i2c_id);
 
-  static void LM75A_setPtrReg(uint16_t chip_addr, uint32_t reg); // pointer register (chip have timeout)
+  // return - 0 ok, != 0 I2C error (value not changed)
+  static int LM75A_setPtrReg(uint16_t chip_addr, uint32_t reg); // pointer register (chip have timeout)
 
-  static void LM75A_setConfig(uint16_t chip_addr, uint8_t data);
+  static int LM75A_setConfig(uint16_t chip_addr, uint8_t data);
   // data is read in two complement format, 9 bits
-  static float LM75A_readTemp(uint16_t chip_addr);
-  static uint16_t LM75A_readID(uint16_t chip_addr);
+  static int LM75A_readTemp(uint16_t chip_addr, float* temp);
+  static int LM75A_readID(uint16_t chip_addr, uint16_t* id);
+
+  // temperature read run by scheduler together with other transfers
+  // (commLink::fmc_schedule), result decoded from finished job
+  static void LM75A_readTempJob(uint16_t chip_addr, struct wb_job* job);
+  static int LM75A_readTempResult(const struct wb_job* job, float* temp);
 
   // for tests
   // reg - to read
@@ -29,6 +35,11 @@ public:
 
 private:
 
+  // register read (pointer write + repeated start read), thread safe
+  static int LM75A_readReg(uint16_t chip_addr, uint8_t reg, unsigned int len, vector<uint32_t>& val);
+  static void LM75A_readRegMsgs(uint16_t chip_addr, uint8_t reg, unsigned int len, vector<struct wb_msg>& msgs);
+  static float LM75A_decodeTemp(const vector<uint32_t>& val);
+
   static wb_data data_;
   static commLink* commLink_;
   static string i2c_id_;
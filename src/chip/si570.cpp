@@ -5,25 +5,19 @@
 //============================================================================
 // Parts taken from si570 linux kernel driver
 #include "si570.h"
+#include "interface/gpio.h"
 
 #define SI570_ADDR 0x55
 #define MAX_REPEAT 10
+// output enable in clock control register
+#define SI570_OE_MASK 0x01
 
 wb_data Si570_drv::data_;
 commLink* Si570_drv::commLink_;
 string Si570_drv::i2c_id_;
 string Si570_drv::gpio_id_;
 
-// Internal structure
-struct si570_data {
-  uint64_t max_freq;
-  uint64_t fout;           /* Factory default frequency */
-  uint64_t fxtal;          /* Factory xtal frequency */
-  unsigned int n1;
-  unsigned int hs_div;
-  uint64_t rfreq;
-  uint64_t frequency;
-};
+map<uint32_t, struct si570_data> Si570_drv::chips_;
 
 void Si570_drv::si570_setCommLink(commLink* comm, string i2c_id, string gpio_id) {
 
@@ -31,53 +25,172 @@ void Si570_drv::si570_setCommLink(commLink* comm, string i2c_id, string gpio_id)
   i2c_id_ = i2c_id;
   gpio_id_ = gpio_id;
   data_.data_send.resize(2);
-  data_.extra.resize(1);
+  data_.extra.resize(2);
 
 }
 
-//int Si570_drv::si570_get_defaults(wb_data* data) {
-//
-//  int err = 0;
-//  
-//  // recommended approach for starting from initial conditions
-//  data_.extra[0] = data->extra[0]; // chip addr
-//  
-//  data_.data_send[0] = SI570_REG_CONTROL;
-//  data_.data_send[1] = SI570_CNTRL_RECALL;
-//    
-//  if (err = commLink_->fmc_send(i2c_id_, &data_))
-//    return err
-//
-//  if (err = si570_read_freq(&data))
-//    return err;
-//
-//  data->hs_div = ((data->data_read[0] & HS_DIV_MASK) >> HS_DIV_SHIFT) + HS_DIV_OFFSET;
-//  data->n1 = ((data->data_read[0] & N1_6_2_MASK) << 2) + ((data->data_read[1] & N1_1_0_MASK) >> 6) + 1;
-//  
-//  /* Handle invalid cases */
-//  if (data->n1 > 1)
-//    data->n1 &= ~1;
-//  
-//  data->rfreq = data->data_read[1] & RFREQ_37_32_MASK;
-//  data->rfreq = (data->rfreq << 8) + data->data_read[2];
-//  data->rfreq = (data->rfreq << 8) + data->data_read[3];
-//  data->rfreq = (data->rfreq << 8) + data->data_read[4];
-//  data->rfreq = (data->rfreq << 8) + data->data_read[5];
-//  
-//  /*
-//   * Accept optional precision loss to avoid arithmetic overflows.
-//   * Acceptable per Silicon Labs Application Note AN334.
-//   */
-//  fdco = data->fout * data->n1 * data->hs_div;
-//  if (fdco >= (1LL << 36))
-//    data->fxtal = (fdco << 24) / (data->rfreq >> 4);
-//  else
-//    data->fxtal = (fdco << 28) / data->rfreq;
-//  
-//  data->frequency = data->fout;
-//  
-//  return err;
-//}
+void Si570_drv::si570_decode(struct si570_data* chip, const vector<uint32_t>& regs) {
+
+  chip->hs_div = ((regs[0] & HS_DIV_MASK) >> HS_DIV_SHIFT) + HS_DIV_OFFSET;
+  chip->n1 = ((regs[0] & N1_6_2_MASK) << 2) + ((regs[1] & N1_1_0_MASK) >> 6) + 1;
+
+  /* Handle invalid cases */
+  if (chip->n1 > 1)
+    chip->n1 &= ~1;
+
+  chip->rfreq = regs[1] & RFREQ_37_32_MASK;
+  chip->rfreq = (chip->rfreq << 8) + (regs[2] & 0xFF);
+  chip->rfreq = (chip->rfreq << 8) + (regs[3] & 0xFF);
+  chip->rfreq = (chip->rfreq << 8) + (regs[4] & 0xFF);
+  chip->rfreq = (chip->rfreq << 8) + (regs[5] & 0xFF);
+}
+
+void Si570_drv::si570_encode(const struct si570_data* chip, vector<uint32_t>& regs) {
+
+  regs.clear();
+  regs.push_back(((chip->hs_div - HS_DIV_OFFSET) << HS_DIV_SHIFT) | ((chip->n1 - 1) >> 2)); // reg 7
+  regs.push_back((((chip->n1 - 1) << 6) & N1_1_0_MASK) | ((chip->rfreq >> 32) & RFREQ_37_32_MASK)); // reg 8
+  regs.push_back((chip->rfreq >> 24) & 0xFF); // reg 9
+  regs.push_back((chip->rfreq >> 16) & 0xFF); // reg 10
+  regs.push_back((chip->rfreq >> 8) & 0xFF); // reg 11
+  regs.push_back(chip->rfreq & 0xFF); // reg 12
+}
+
+int Si570_drv::si570_read_reg(uint32_t chip_addr, uint8_t reg, uint8_t* val) {
+
+  vector<struct wb_msg> msgs(2);
+  int err;
+
+  msgs[0].addr = chip_addr;
+  msgs[0].flags = 0;
+  msgs[0].buf.push_back(reg);
+
+  msgs[1].addr = chip_addr;
+  msgs[1].flags = WB_MSG_RD;
+  msgs[1].buf.resize(1);
+
+  err = commLink_->fmc_transfer(i2c_id_, msgs);
+  if (err != 0)
+    return err;
+
+  *val = msgs[1].buf[0] & 0xFF;
+
+  return 0;
+}
+
+int Si570_drv::si570_get_defaults(uint32_t chip_addr, uint64_t fout) {
+
+  uint8_t ctrl;
+  int err = 0, repeat = 0;
+
+  // recommended approach for starting from initial conditions
+  data_.extra[0] = chip_addr;
+
+  data_.data_send[0] = SI570_REG_CONTROL;
+  data_.data_send[1] = SI570_CNTRL_RECALL;
+
+  err = commLink_->fmc_send(i2c_id_, &data_);
+  if (err != 0)
+    return err;
+
+  // RECALL bit is cleared when factory setting is loaded
+  while (1) {
+
+    // only register pointer is written (RECALL is not set again)
+    err = si570_read_reg(chip_addr, SI570_REG_CONTROL, &ctrl);
+    if (err != 0)
+      return err;
+
+    if ((ctrl & SI570_CNTRL_RECALL) == 0)
+      break;
+
+    usleep(1000);
+
+    repeat++;
+
+    if (repeat > MAX_REPEAT) {
+      cout << "Si570: Error: Factory setting not recalled." << endl;
+      return 1;
+    }
+  }
+
+  err = si570_get_current(chip_addr, fout);
+  if (err != 0)
+    return err;
+
+  chips_[chip_addr].fout = fout;
+
+  return err;
+}
+
+int Si570_drv::si570_get_current(uint32_t chip_addr, uint64_t frequency) {
+
+  struct si570_data* chip = &chips_[chip_addr];
+  wb_data data;
+  uint64_t fdco, fxtal;
+  int err = 0;
+
+  data.extra.push_back(chip_addr);
+  data.extra.push_back(SI570_NUM_FREQ_REGS);
+
+  err = si570_read_freq(&data);
+  if (err != 0)
+    return err;
+
+  si570_decode(chip, data.data_read);
+
+  if (chip->rfreq == 0) {
+    cout << "Si570: Error: Invalid frequency setting." << endl;
+    chip->center = 0;
+    return 1;
+  }
+
+  /*
+   * Accept optional precision loss to avoid arithmetic overflows.
+   * Acceptable per Silicon Labs Application Note AN334.
+   */
+  fdco = frequency * chip->n1 * chip->hs_div;
+  if (fdco >= (1LL << 36))
+    fxtal = (fdco << 24) / (chip->rfreq >> 4);
+  else
+    fxtal = (fdco << 28) / chip->rfreq;
+
+  // registers computed for previous crystal frequency are not valid
+  if (fxtal != chip->fxtal)
+    chip->regs.clear();
+
+  chip->fxtal = fxtal;
+  chip->frequency = frequency;
+  chip->center = frequency;
+  chip->max_freq = SI570_MAX_FREQ;
+
+  cout << "Si570: Crystal frequency: " << dec << chip->fxtal << " Hz" << endl;
+
+  return err;
+}
+
+void Si570_drv::si570_set_xtal(uint32_t chip_addr, uint64_t fxtal) {
+
+  struct si570_data* chip = &chips_[chip_addr];
+
+  if (fxtal != chip->fxtal)
+    chip->regs.clear();
+
+  // running setting not known, next change reprograms DCO
+  chip->fxtal = fxtal;
+  chip->center = 0;
+  chip->max_freq = SI570_MAX_FREQ;
+
+  cout << "Si570: Crystal frequency: " << dec << chip->fxtal << " Hz (saved)" << endl;
+}
+
+uint64_t Si570_drv::si570_get_xtal(uint32_t chip_addr) {
+
+  if (chips_.find(chip_addr) == chips_.end())
+    return 0;
+
+  return chips_[chip_addr].fxtal;
+}
 
 // get info about startup setting so user can calculate needed values
 int Si570_drv::si570_read_freq(wb_data* data) {
@@ -90,26 +203,33 @@ int Si570_drv::si570_read_freq(wb_data* data) {
 
   //cout << showbase << internal << setfill('0') << setw(8);
 
+  vector<struct wb_msg> msgs(2);
+
   if (data->data_send.size() == 0)
-    data->data_send.resize(1);
+    data->data_send.push_back(SI570_REG_START); // starting register
+
+  if (data->extra.size() < 1)
+    data->extra.push_back(SI570_ADDR);
 
   if (data->extra.size() < 2)
-    data->extra.resize(2);
-    
-  //if (data->data_send.size() == 0)
-  data->data_send[0] = SI570_REG_START; // starting register
+    data->extra.push_back(SI570_NUM_FREQ_REGS); // number of registers to read
 
-  data->extra[0] = SI570_ADDR;
-  data->extra[1] = SI570_NUM_FREQ_REGS; // number of registers to read
-  //std_read = 1;
+  // register pointer, then read with repeated start
+  msgs[0].addr = data->extra[0];
+  msgs[0].flags = 0;
+  msgs[0].buf.push_back(data->data_send[0]);
 
-  err = commLink_->fmc_send_read(i2c_id_, data);
+  msgs[1].addr = data->extra[0];
+  msgs[1].flags = WB_MSG_RD;
+  msgs[1].buf.resize(data->extra[1]);
 
-  //data->data_send.resize(data_size);
+  err = commLink_->fmc_transfer(i2c_id_, msgs);
 
   if (err != 0)
     return err;
 
+  data->data_read = msgs[1].buf;
+
   // parsing data
   for (unsigned int i = 0; i < data->extra[1]; i++)
     cout << "Si570: data read [" << i << "] : 0x" << hex << (data->data_read[i] & 0xFF) << endl;
@@ -141,6 +261,7 @@ const uint8_t si570_hs_div_values[] = { 11, 9, 7, 6, 5, 4 };
 
 int Si570_drv::si570_set_freq(wb_data* data) {
 
+  uint8_t ctrl;
   int i;
   int err = 0, repeat = 0;
 
@@ -152,6 +273,10 @@ int Si570_drv::si570_set_freq(wb_data* data) {
 
   data_.extra[0] = data->extra[0]; // chip addr
 
+  // setting not known by solver (small step needs new reference)
+  if (chips_.find(data->extra[0]) != chips_.end())
+    chips_[data->extra[0]].center = 0;
+
   // freeze DCO - reg 137 bit 4
   data_.data_send[0] = SI570_REG_FREEZE_DCO;
   data_.data_send[1] = SI570_FREEZE_DCO;
@@ -191,13 +316,14 @@ int Si570_drv::si570_set_freq(wb_data* data) {
   // check if newfreq bit is cleared (new frequency applied)
   while(1) { // bit automatically cleared
 
-    data_.data_send[0] = SI570_REG_CONTROL; // reg 135
-    data_.extra[1] = 1;
-    err = commLink_->fmc_send_read(i2c_id_, &data_); //i2c_int->int_send_read_data(&data_);
-//cout << "data: " << hex << data_.data_read[0] << endl;
-    if ( ( (data_.data_read[0] & SI570_CNTRL_NEWFREQ_MASK) >> SI570_CNTRL_NEWFREQ_SHIFT ) == 0)
+    // reg 135, only register pointer is written (NewFreq is not set again)
+    err = si570_read_reg(data_.extra[0], SI570_REG_CONTROL, &ctrl);
+    if (err != 0)
+      return err;
+
+    if ((ctrl & SI570_CNTRL_NEWFREQ) == 0)
       break;
-    sleep(1);
+    usleep(10000);
 
     repeat++;
 
@@ -217,12 +343,185 @@ int Si570_drv::si570_set_freq(wb_data* data) {
 
 }
 
+int Si570_drv::si570_calc_divs(struct si570_data* chip, uint64_t frequency, vector<uint32_t>& regs) {
+
+  struct si570_data setting;
+  unsigned int i, n1, hs_div, best_n1 = 0, best_hs_div = 0;
+  uint64_t fdco, best_fdco = ~0ULL;
+
+  for (i = 0; i < sizeof(si570_hs_div_values); i++) {
+
+    hs_div = si570_hs_div_values[i];
+
+    /* Calculate lowest possible value for n1 */
+    n1 = FDCO_MIN / hs_div / frequency;
+    if (!n1 || (n1 & 1))
+      n1++;
+
+    while (n1 <= 128) {
+
+      fdco = frequency * hs_div * n1;
+      if (fdco > FDCO_MAX)
+        break;
+
+      // lowest DCO frequency means lowest power
+      if (fdco >= FDCO_MIN && fdco < best_fdco) {
+        best_n1 = n1;
+        best_hs_div = hs_div;
+        best_fdco = fdco;
+      }
+
+      n1 += (n1 == 1 ? 1 : 2);
+    }
+  }
+
+  if (best_fdco == ~0ULL)
+    return 1;
+
+  setting.hs_div = best_hs_div;
+  setting.n1 = best_n1;
+  setting.rfreq = (best_fdco << 28) / chip->fxtal;
+
+  si570_encode(&setting, regs);
+
+  return 0;
+}
+
+int Si570_drv::si570_set_rfreq(uint32_t chip_addr, uint64_t frequency, vector<uint32_t>& regs) {
+
+  struct si570_data* chip = &chips_[chip_addr];
+  struct si570_data setting = *chip;
+  uint64_t fdco;
+  int i, err = 0;
+
+  fdco = frequency * chip->hs_div * chip->n1;
+  if (fdco < FDCO_MIN || fdco > FDCO_MAX)
+    return 1;
+
+  setting.rfreq = (fdco << 28) / chip->fxtal;
+  si570_encode(&setting, regs);
+
+  data_.extra[0] = chip_addr;
+
+  // freeze M - reg 135 bit 5, output keeps running
+  data_.data_send[0] = SI570_REG_CONTROL;
+  data_.data_send[1] = SI570_CNTRL_FREEZE_M;
+
+  err = commLink_->fmc_send(i2c_id_, &data_);
+  if (err != 0)
+    return err;
+
+  // RFREQ only - regs 8 - 12 (N1 bits in reg 8 unchanged)
+  for (i = 1; i < SI570_NUM_FREQ_REGS; i++) {
+    data_.data_send[0] = SI570_REG_START + i;
+    data_.data_send[1] = regs[i];
+    err = commLink_->fmc_send(i2c_id_, &data_);
+    if (err != 0)
+      break;
+  }
+
+  // unfreeze M (also on error, M must not stay frozen)
+  data_.data_send[0] = SI570_REG_CONTROL;
+  data_.data_send[1] = 0;
+
+  if (commLink_->fmc_send(i2c_id_, &data_) != 0 && err == 0)
+    err = 1;
+
+  if (err != 0) {
+    // RFREQ state unknown
+    chip->center = 0;
+    return err;
+  }
+
+  chip->rfreq = setting.rfreq;
+  chip->frequency = frequency;
+
+  return err;
+}
+
+int Si570_drv::si570_set_frequency(uint32_t chip_addr, uint64_t frequency, vector<uint32_t>* regs) {
+
+  map<uint64_t, vector<uint32_t> >::iterator it;
+  struct si570_data* chip;
+  vector<uint32_t> step;
+  uint64_t delta;
+  wb_data data;
+  int err = 0;
+
+  if (chips_.find(chip_addr) == chips_.end() || chips_[chip_addr].fxtal == 0) {
+    err = si570_get_defaults(chip_addr);
+    if (err != 0)
+      return err;
+  }
+
+  chip = &chips_[chip_addr];
+
+  if (frequency < SI570_MIN_FREQ || frequency > chip->max_freq) {
+    cout << "Si570: Error: Frequency " << dec << frequency << " Hz out of range." << endl;
+    return 1;
+  }
+
+  // small change from last DCO setting - no output glitch, no settling time
+  if (chip->center != 0) {
+
+    delta = (frequency > chip->center) ? frequency - chip->center : chip->center - frequency;
+
+    if (delta * 1000000ULL <= chip->center * SI570_SMALL_STEP_PPM &&
+        si570_set_rfreq(chip_addr, frequency, step) == 0) {
+
+      if (regs != NULL)
+        *regs = step;
+
+      cout << "Si570: Small frequency step completed" << endl;
+
+      return 0;
+    }
+  }
+
+  // registers are computed once per operating point
+  it = chip->regs.find(frequency);
+
+  if (it == chip->regs.end()) {
+
+    if (si570_calc_divs(chip, frequency, data.data_send) != 0) {
+      cout << "Si570: Error: No divider setting for " << dec << frequency << " Hz." << endl;
+      return 1;
+    }
+
+    it = chip->regs.insert(make_pair(frequency, data.data_send)).first;
+  }
+
+  data.extra.push_back(chip_addr);
+  data.data_send = it->second;
+
+  err = si570_set_freq(&data);
+  if (err != 0)
+    return err;
+
+  si570_decode(chip, data.data_send);
+  chip->frequency = frequency;
+  chip->center = frequency;
+
+  if (regs != NULL)
+    *regs = data.data_send;
+
+  return err;
+}
+
 int Si570_drv::si570_outputEnable(uint32_t addr) {
 
-  data_.wb_addr = addr;
-  commLink_->fmc_read(gpio_id_, &data_);
-  data_.data_send[0] = data_.data_read[0] | 0x1;
-  commLink_->fmc_send(gpio_id_, &data_);
+  struct gpio_field oe = { addr, SI570_OE_MASK };
+  gpio_int* gpio = (gpio_int*)commLink_->getIntDrv(gpio_id_);
+
+  if (gpio == NULL) {
+    cout << "Interface not found!" << endl;
+    return 1;
+  }
+
+  if (gpio->gpio_set(oe, 1) != 0) {
+    cout << "Si571 output enable error" << endl;
+    return 1;
+  }
 
   usleep(30000); // 30ms
 
@@ -233,10 +532,18 @@ int Si570_drv::si570_outputEnable(uint32_t addr) {
 
 int Si570_drv::si570_outputDisable(uint32_t addr) {
 
-  data_.wb_addr = addr;
-  commLink_->fmc_read(gpio_id_, &data_);
-  data_.data_send[0] = data_.data_read[0] & 0xFFFFFFFE;
-  commLink_->fmc_send(gpio_id_, &data_);
+  struct gpio_field oe = { addr, SI570_OE_MASK };
+  gpio_int* gpio = (gpio_int*)commLink_->getIntDrv(gpio_id_);
+
+  if (gpio == NULL) {
+    cout << "Interface not found!" << endl;
+    return 1;
+  }
+
+  if (gpio->gpio_clear(oe) != 0) {
+    cout << "Si571 output disable error" << endl;
+    return 1;
+  }
 
   usleep(30000); // 30ms
 
@@ -245,13 +552,22 @@ int Si570_drv::si570_outputDisable(uint32_t addr) {
   return 0;
 }
 
-void Si570_drv::si570_assert(uint32_t chip_addr, uint8_t reg, uint8_t val) {
+int Si570_drv::si570_assert(uint32_t chip_addr, uint8_t reg, uint8_t val) {
+
+  int err;
 
   data_.extra[0] = chip_addr;
   data_.extra[1] = 1;
   data_.data_send[0] = reg; // starting register
 
-  si570_read_freq(&data_);
+  err = si570_read_freq(&data_);
+  if (err == 0 && data_.data_read.empty())
+    err = 1;
+
+  if (err) {
+    printf("Si571 assert, reg: 0x%02x read error\n", reg);
+    return err;
+  }
 
   //cout << "Si571 assert, reg: 0x" << hex << reg <<
   //    " val: 0x" << hex << unsigned(data_.data_read[0] & 0xFF) << " =? 0x" << hex << unsigned(val) << "...";
@@ -265,4 +581,6 @@ void Si570_drv::si570_assert(uint32_t chip_addr, uint8_t reg, uint8_t val) {
 
   //cout << "passed!" << endl;
 
+  return 0;
+
 }
@@ -7,6 +7,8 @@
 #ifndef SI570_H_
 #define SI570_H_
 
+#include <map>
+
 #include "data.h"
 #include "commLink.h"
 
@@ -42,6 +44,9 @@
 #define FDCO_MAX                            5670000000LL
 #define FDCO_CENTER                         ((FDCO_MIN + FDCO_MAX) / 2)
 
+// max change of RFREQ without DCO freeze (from last DCO change)
+#define SI570_SMALL_STEP_PPM                3500ULL
+
 #define SI570_CNTRL_RECALL                  (1 << 0)
 #define SI570_CNTRL_FREEZE_ADC              (1 << 4)
 #define SI570_CNTRL_FREEZE_M                (1 << 5)
@@ -54,6 +59,19 @@
 #define SI570_FREEZE_DCO                    (1 << 4)
 #define SI570_UNFREEZE_DCO                  (0)
 
+// Per chip state (factory defaults and current setting)
+struct si570_data {
+  uint64_t max_freq;
+  uint64_t fout;           /* Factory default frequency */
+  uint64_t fxtal;          /* Factory xtal frequency */
+  unsigned int n1;
+  unsigned int hs_div;
+  uint64_t rfreq;
+  uint64_t frequency;
+  uint64_t center;         /* Output frequency at last DCO change, 0 - unknown */
+  map<uint64_t, vector<uint32_t> > regs; /* computed registers per output frequency */
+};
+
 class Si570_drv {
 public:
 
@@ -69,6 +87,32 @@ public:
   // data_send[0...6] - configuration registers
   static int si570_set_freq(wb_data* data);
 
+  // recall factory setting and derive crystal frequency from it
+  // chip_addr - Si570 address
+  // fout - factory (startup) output frequency [Hz]
+  static int si570_get_defaults(uint32_t chip_addr, uint64_t fout = SI570_FOUT_FACTORY_DFLT);
+
+  // derive crystal frequency from current setting (no output change)
+  // chip_addr - Si570 address
+  // frequency - current output frequency [Hz]
+  static int si570_get_current(uint32_t chip_addr, uint64_t frequency);
+
+  // crystal frequency known from previous run (calibration record), no chip access
+  // chip_addr - Si570 address
+  // fxtal - crystal frequency [Hz]
+  static void si570_set_xtal(uint32_t chip_addr, uint64_t fxtal);
+  // return - crystal frequency [Hz], 0 - not known yet
+  static uint64_t si570_get_xtal(uint32_t chip_addr);
+
+  // compute and program registers for new output frequency
+  // (factory defaults are read first if not done yet)
+  // changes within SI570_SMALL_STEP_PPM write RFREQ only, without
+  // DCO freeze (no output glitch)
+  // chip_addr - Si570 address
+  // frequency - output frequency [Hz]
+  // regs - optional, registers written (regs 7 - 12)
+  static int si570_set_frequency(uint32_t chip_addr, uint64_t frequency, vector<uint32_t>* regs = NULL);
+
   // addr - Wishbone register address
   static int si570_outputEnable(uint32_t addr);
   static int si570_outputDisable(uint32_t addr);
@@ -76,14 +120,26 @@ public:
   // for tests
   // reg - to read
   // val - expected val
-  static void si570_assert(uint32_t chip_addr, uint8_t reg, uint8_t val);
+  // return - 0 value checked, != 0 I2C error (nothing to check)
+  static int si570_assert(uint32_t chip_addr, uint8_t reg, uint8_t val);
 
 private:
 
+  // HS_DIV, N1 and RFREQ for lowest DCO frequency
+  static int si570_calc_divs(struct si570_data* chip, uint64_t frequency, vector<uint32_t>& regs);
+  // RFREQ only change under Freeze M
+  static int si570_set_rfreq(uint32_t chip_addr, uint64_t frequency, vector<uint32_t>& regs);
+  // regs 7 - 12 <-> HS_DIV, N1, RFREQ
+  static void si570_decode(struct si570_data* chip, const vector<uint32_t>& regs);
+  static void si570_encode(const struct si570_data* chip, vector<uint32_t>& regs);
+  // one register read (pointer write + repeated start read), nothing written to it
+  static int si570_read_reg(uint32_t chip_addr, uint8_t reg, uint8_t* val);
+
   static wb_data data_;
   static commLink* commLink_;
   static string i2c_id_;
   static string gpio_id_;
+  static map<uint32_t, struct si570_data> chips_;
 };
 
 #endif /* SI570_H_ */
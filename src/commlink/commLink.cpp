@@ -4,6 +4,8 @@
 //============================================================================
 #include "commLink.h"
 
+#include <algorithm>
+
 commLink::commLink() {
 
 }
@@ -29,6 +31,11 @@ WBInt_drv* commLink::regIntDrv(string interfaceName, uint32_t core_addr, WBInt_d
 	return interfaceDrv;
 }
 
+WBInt_drv* commLink::getIntDrv(string interfaceName) {
+
+	return searchIntDrv(interfaceName);
+}
+
 int commLink::fmc_config_send(struct wb_data* data) {
 	// just send data through Wishbone master
 	return wb_master->wb_send_data(data);
@@ -41,8 +48,15 @@ int commLink::fmc_config_read(struct wb_data* data) {
 	return wb_master->wb_read_data(data);
 }
 
+int commLink::fmc_config_exec(vector<struct wb_op>& ops) {
+
+	return wb_master->wb_exec(ops);
+}
+
 int commLink::fmc_send(string intName, struct wb_data* data) {
 
+	WBInt_drv* interface;
+
 	data->data_read.clear();
 
 	// Search for interface driver
@@ -60,6 +74,8 @@ int commLink::fmc_send(string intName, struct wb_data* data) {
 
 int commLink::fmc_send_read(string intName, struct wb_data* data) {
 
+	WBInt_drv* interface;
+
 	data->data_read.clear();
 
 	// Search for interface driver
@@ -77,6 +93,8 @@ int commLink::fmc_send_read(string intName, struct wb_data* data) {
 
 int commLink::fmc_read(string intName, struct wb_data* data) {
 
+	WBInt_drv* interface;
+
 	// Search for interface driver
 	interface = searchIntDrv(intName);
 
@@ -90,8 +108,141 @@ int commLink::fmc_read(string intName, struct wb_data* data) {
 
 }
 
+int commLink::fmc_transfer(string intName, vector<struct wb_msg>& msgs) {
+
+	WBInt_drv* interface;
+	int err;
+
+	// Search for interface driver
+	interface = searchIntDrv(intName);
+
+	if (interface == NULL) {
+		cout << "Interface not found!" << endl;
+		return 1;
+	}
+
+	err = interface->int_transfer(msgs);
+
+	if (err == 1)
+		cout << "Interface " << intName << ": transfer failed or not supported" << endl;
+
+	return err;
+}
+
+int commLink::runJob(WBInt_drv* interface, struct wb_job* job) {
+
+	switch (job->type) {
+	case WB_JOB_SEND:
+		return interface->int_send_data(&job->data);
+	case WB_JOB_READ:
+		job->data.data_read.clear();
+		return interface->int_read_data(&job->data);
+	case WB_JOB_SEND_READ:
+		job->data.data_read.clear();
+		return interface->int_send_read_data(&job->data);
+	case WB_JOB_TRANSFER:
+		return interface->int_transfer(job->msgs);
+	}
+
+	return 1;
+}
+
+enum { JOB_WAIT, JOB_RUN, JOB_DONE };
+
+// scheduled job progress
+struct job_state {
+	WBInt_drv* interface;
+	vector<struct wb_op> ops; // operations from int_prepare
+	unsigned int pos; // next operation
+	int state;
+};
+
+// Each job is split into segments ending before status poll (WB_OP_POLL),
+// segments of running jobs are executed round-robin
+int commLink::fmc_schedule(vector<struct wb_job>& jobs) {
+
+	vector<struct job_state> run(jobs.size());
+	unsigned int i, j, end, pending;
+	int err;
+
+	pending = jobs.size();
+
+	for (i = 0; i < jobs.size(); i++) {
+
+		run[i].interface = searchIntDrv(jobs[i].int_name);
+		run[i].pos = 0;
+		run[i].state = JOB_WAIT;
+		jobs[i].status = 0;
+
+		if (run[i].interface == NULL) {
+			cout << "Interface not found!" << endl;
+			jobs[i].status = 1;
+			run[i].state = JOB_DONE;
+			pending--;
+		}
+	}
+
+	while (pending > 0) {
+
+		for (i = 0; i < jobs.size(); i++) {
+
+			if (run[i].state == JOB_WAIT) {
+
+				// previous job on the same interface has to finish first
+				for (j = 0; j < i; j++)
+					if (run[j].state != JOB_DONE && run[j].interface == run[i].interface)
+						break;
+
+				if (j < i)
+					continue;
+
+				if (run[i].interface->int_prepare(&jobs[i], run[i].ops) != 0) {
+					jobs[i].status = runJob(run[i].interface, &jobs[i]);
+					run[i].state = JOB_DONE;
+					pending--;
+					continue;
+				}
+
+				run[i].state = JOB_RUN;
+			}
+
+			if (run[i].state != JOB_RUN)
+				continue;
+
+			// operations up to next status poll
+			end = run[i].pos;
+			while (end < run[i].ops.size() && (end == run[i].pos || run[i].ops[end].type != WB_OP_POLL))
+				end++;
+
+			vector<struct wb_op> segment(run[i].ops.begin() + run[i].pos, run[i].ops.begin() + end);
+
+			err = wb_master->wb_exec(segment);
+
+			// read values back to job
+			copy(segment.begin(), segment.end(), run[i].ops.begin() + run[i].pos);
+			run[i].pos = end;
+
+			if (err || run[i].pos == run[i].ops.size()) {
+				jobs[i].status = run[i].interface->int_complete(&jobs[i], run[i].ops, err);
+				run[i].state = JOB_DONE;
+				pending--;
+			}
+		}
+	}
+
+	for (i = 0; i < jobs.size(); i++)
+		if (jobs[i].status != 0) {
+			cout << "Interface " << jobs[i].int_name << ": scheduled transfer failed" << endl;
+			return jobs[i].status;
+		}
+
+	return 0;
+}
+
 WBInt_drv* commLink::searchIntDrv(string intName) {
 
+	map<string, WBInt_drv*>::iterator interface_it;
+
 	interface_it = fmc_interface.find(intName);
 
 	if (interface_it == fmc_interface.end())
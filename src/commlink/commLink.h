@@ -31,26 +31,37 @@ public:
   // Register software driver
   WBMaster_unit* regWBMaster(WBMaster_unit* wb_master_unit); // register software driver for Wishbone master (RS-232, PCI-E driver)
   WBInt_drv* regIntDrv(string interfaceName, uint32_t core_addr, WBInt_drv* interfaceDrv); // register software driver for communication interface (I2C, SPI)
+  WBInt_drv* getIntDrv(string interfaceName); // registered driver (NULL if not found), for interface specific functions
 
   // Config communication interface (FPGA core)
   int fmc_config_send(struct wb_data* data); // send interface config data
   int fmc_config_read(struct wb_data* data); // read interface config data
+  // batch of Wishbone operations (see struct wb_op), like register sweeps
+  // return - 0 ok, WB_STATUS_* error code
+  int fmc_config_exec(vector<struct wb_op>& ops);
 
   // Send data through communication interface (like I2C, SPI)
   int fmc_send(string intName, struct wb_data* data); // send data through interface
   int fmc_send_read(string intName, struct wb_data* data); // send data through interface
   int fmc_read(string intName, struct wb_data* data); // read data from interface
+  // combined transaction, messages with repeated start (like I2C write register pointer, then read)
+  // can be called from several threads (for different interfaces)
+  int fmc_transfer(string intName, vector<struct wb_msg>& msgs);
+
+  // Run several transfers together (like LM75A read and AD9510 write)
+  // Wishbone operations of transfers on different interfaces are interleaved,
+  // while one core is busy (TIP, GO_BSY) link is used by the others
+  // transfers on the same interface are run in order
+  // return - 0 all ok, otherwise status of first failed job (all jobs have status set)
+  int fmc_schedule(vector<struct wb_job>& jobs);
 
 private:
 
   WBInt_drv* searchIntDrv(string intName);
+  int runJob(WBInt_drv* interface, struct wb_job* job); // job without split transfer support
 
   WBMaster_unit* wb_master;
   map<string, WBInt_drv*> fmc_interface;
-
-
-  WBInt_drv* interface;
-  map<string, WBInt_drv*>::iterator interface_it;
 };
 
 #endif /* COMMLINK_H_ */
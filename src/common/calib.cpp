@@ -0,0 +1,176 @@
+//============================================================================
+// Author      : Andrzej Wojenski
+// Version     : 1.0
+// Description : Calibration record of FMC card
+//============================================================================
+
+#include "calib.h"
+
+using namespace std;
+
+// CRC-32 (IEEE 802.3), bytes of record
+static uint32_t calib_crc32(const vector<uint32_t>& bytes, unsigned int len) {
+
+  uint32_t crc = 0xFFFFFFFF;
+  unsigned int i, j;
+
+  for (i = 0; i < len; i++) {
+
+    crc ^= bytes[i] & 0xFF;
+
+    for (j = 0; j < 8; j++)
+      crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+  }
+
+  return ~crc;
+}
+
+// value stored MSB first
+static void calib_put(vector<uint32_t>& bytes, uint64_t val, unsigned int len) {
+
+  while (len-- > 0)
+    bytes.push_back((val >> (8 * len)) & 0xFF);
+}
+
+static uint64_t calib_get(const vector<uint32_t>& bytes, unsigned int& pos, unsigned int len) {
+
+  uint64_t val = 0;
+
+  while (len-- > 0)
+    val = (val << 8) | (bytes[pos++] & 0xFF);
+
+  return val;
+}
+
+void calib_init(struct calib_record* rec, enum platform_t platform, uint32_t fw_id)
+{
+  unsigned int i;
+
+  rec->platform = platform;
+  rec->fw_id = fw_id;
+  rec->idelay_valid = 0;
+  rec->fxtal = 0;
+
+  for (i = 0; i < CALIB_IDELAY_NUM; i++) {
+    rec->idelay_data[i] = 0;
+    rec->idelay_clk[i] = 0;
+  }
+
+  for (i = 0; i < CALIB_ADC_NUM; i++)
+    rec->adc_trim[i] = 0;
+}
+
+void calib_encode(const struct calib_record* rec, vector<uint32_t>& bytes)
+{
+  unsigned int i;
+
+  bytes.clear();
+
+  calib_put(bytes, CALIB_MAGIC, 4);
+  calib_put(bytes, CALIB_VERSION, 1);
+  calib_put(bytes, CALIB_RECORD_SIZE, 1);
+  calib_put(bytes, rec->platform, 1);
+  calib_put(bytes, rec->idelay_valid, 1);
+  calib_put(bytes, rec->fw_id, 4);
+
+  for (i = 0; i < CALIB_IDELAY_NUM; i++)
+    calib_put(bytes, rec->idelay_data[i], 1);
+
+  for (i = 0; i < CALIB_IDELAY_NUM; i++)
+    calib_put(bytes, rec->idelay_clk[i], 1);
+
+  calib_put(bytes, rec->fxtal, 8);
+
+  for (i = 0; i < CALIB_ADC_NUM; i++)
+    calib_put(bytes, rec->adc_trim[i], 2);
+
+  calib_put(bytes, calib_crc32(bytes, bytes.size()), 4);
+}
+
+int calib_decode(const vector<uint32_t>& bytes, struct calib_record* rec)
+{
+  unsigned int i, pos = 0;
+
+  if (bytes.size() < CALIB_RECORD_SIZE)
+    return 1;
+
+  if (calib_get(bytes, pos, 4) != CALIB_MAGIC || calib_get(bytes, pos, 1) != CALIB_VERSION ||
+      calib_get(bytes, pos, 1) != CALIB_RECORD_SIZE)
+    return 1;
+
+  pos = CALIB_RECORD_SIZE - 4;
+  if (calib_get(bytes, pos, 4) != calib_crc32(bytes, CALIB_RECORD_SIZE - 4))
+    return 1;
+
+  pos = 6;
+  rec->platform = calib_get(bytes, pos, 1);
+  rec->idelay_valid = calib_get(bytes, pos, 1);
+  rec->fw_id = calib_get(bytes, pos, 4);
+
+  for (i = 0; i < CALIB_IDELAY_NUM; i++)
+    rec->idelay_data[i] = calib_get(bytes, pos, 1);
+
+  for (i = 0; i < CALIB_IDELAY_NUM; i++)
+    rec->idelay_clk[i] = calib_get(bytes, pos, 1);
+
+  rec->fxtal = calib_get(bytes, pos, 8);
+
+  for (i = 0; i < CALIB_ADC_NUM; i++)
+    rec->adc_trim[i] = calib_get(bytes, pos, 2);
+
+  return 0;
+}
+
+int calib_match(const struct calib_record* rec, enum platform_t platform, uint32_t fw_id)
+{
+  return rec->platform == platform && rec->fw_id == fw_id;
+}
+
+void calib_set_idelay(struct calib_record* rec, const struct delay_lines *delay_data,
+                        const struct delay_lines *delay_clk)
+{
+  unsigned int i;
+
+  rec->idelay_valid = 0;
+
+  for (i = 0; i < CALIB_IDELAY_NUM; i++) {
+
+    if (delay_data == NULL || delay_data[i].init == DELAY_LINES_END)
+      break;
+
+    if (delay_data[i].init == DELAY_LINES_NO_INIT)
+      continue;
+
+    rec->idelay_data[i] = delay_data[i].value;
+    rec->idelay_clk[i] = 0;
+    rec->idelay_valid |= (1 << i);
+  }
+
+  for (i = 0; i < CALIB_IDELAY_NUM; i++) {
+
+    if (delay_clk == NULL || delay_clk[i].init == DELAY_LINES_END)
+      break;
+
+    if (delay_clk[i].init == DELAY_LINES_NO_INIT)
+      continue;
+
+    rec->idelay_clk[i] = delay_clk[i].value;
+  }
+}
+
+void calib_get_idelay(const struct calib_record* rec, struct delay_lines *delay_data,
+                        struct delay_lines *delay_clk)
+{
+  unsigned int i;
+
+  for (i = 0; i < CALIB_IDELAY_NUM; i++) {
+
+    delay_data[i].init = (rec->idelay_valid & (1 << i)) ? DELAY_LINES_INIT : DELAY_LINES_NO_INIT;
+    delay_data[i].value = rec->idelay_data[i];
+    delay_clk[i].init = delay_data[i].init;
+    delay_clk[i].value = rec->idelay_clk[i];
+  }
+
+  delay_data[i].init = DELAY_LINES_END;
+  delay_clk[i].init = DELAY_LINES_END;
+}
@@ -0,0 +1,50 @@
+//============================================================================
+// Author      : Andrzej Wojenski
+// Version     : 1.0
+// Description : Calibration record of FMC card
+//               IDELAY taps, Si570 crystal frequency and ADC trim, kept in
+//               FMC EEPROM (24A64), so calibration is done only once per card
+//               (record is valid for the same carrier and firmware ID)
+//============================================================================
+
+#ifndef CALIB_H
+#define CALIB_H
+
+#include "common.h"
+
+#include <stdint.h>
+#include <vector>
+
+#define CALIB_EEPROM_OFFSET 0x1000 // above FRU data
+#define CALIB_MAGIC 0x4643414C // "FCAL"
+#define CALIB_VERSION 1
+#define CALIB_RECORD_SIZE 40 // bytes, CRC included
+#define CALIB_IDELAY_NUM 4
+#define CALIB_ADC_NUM 4
+
+struct calib_record {
+  uint8_t platform; // enum platform_t
+  uint32_t fw_id;
+  uint32_t idelay_valid; // bit mask
+  uint32_t idelay_data[CALIB_IDELAY_NUM]; // data lines tap values
+  uint32_t idelay_clk[CALIB_IDELAY_NUM]; // clk line tap values
+  uint64_t fxtal; // Si570 crystal frequency [Hz], 0 - not known
+  uint16_t adc_trim[CALIB_ADC_NUM]; // ADC trim, 0 - not used
+};
+
+// empty record for carrier and firmware ID
+void calib_init(struct calib_record* rec, enum platform_t platform, uint32_t fw_id);
+// record to EEPROM bytes (CALIB_RECORD_SIZE, CRC-32 at the end)
+void calib_encode(const struct calib_record* rec, std::vector<uint32_t>& bytes);
+// return - 0 ok, 1 no record (magic, version or CRC do not match)
+int calib_decode(const std::vector<uint32_t>& bytes, struct calib_record* rec);
+// return - 1 record made on the same carrier and firmware ID, 0 not
+int calib_match(const struct calib_record* rec, enum platform_t platform, uint32_t fw_id);
+// store IDELAY values (tables as used by set_fpga_delay_s, NULL if not used)
+void calib_set_idelay(struct calib_record* rec, const struct delay_lines *delay_data,
+                        const struct delay_lines *delay_clk);
+// IDELAY values as tables (CALIB_IDELAY_NUM + 1 entries, with DELAY_LINES_END)
+void calib_get_idelay(const struct calib_record* rec, struct delay_lines *delay_data,
+                        struct delay_lines *delay_clk);
+
+#endif
@@ -0,0 +1,214 @@
+//============================================================================
+// Author      : Andrzej Wojenski
+// Version     : 1.0
+// Description : Checkpoint of FMC card configuration
+//============================================================================
+
+#include "checkpoint.h"
+
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+int resume;
+
+static const char* ckpt_phase_names[PHASE_NUM] = {
+  "LEDs configuration",
+  "Trigger configuration",
+  "LM75A check",
+  "EEPROM check",
+  "AMC7823 configuration",
+  "Si570 configuration",
+  "AD9510 configuration",
+  "ADC configuration",
+  "IDELAY calibration",
+  "BPM Swap configuration",
+  "DSP configuration"
+};
+
+static string basename_of(const char* path) {
+
+  string p(path);
+
+  return p.substr(p.rfind('/') + 1);
+}
+
+static void checkpoint_clear(struct checkpoint_t* ckpt) {
+
+  ckpt->phases = 0;
+  ckpt->running = 0;
+  ckpt->idelay_valid = 0;
+  ckpt->si570_valid = 0;
+}
+
+// State file format (text, one item per line, values in hex):
+// fw_id <id>
+// phases <bit mask>
+// idelay <line> <data tap> <clk tap>
+// si570 <reg 7> ... <reg 12>
+static int checkpoint_load(struct checkpoint_t* ckpt) {
+
+  ifstream file(ckpt->path.c_str());
+  string line, key;
+  uint32_t fw_id = 0, val, line_num;
+  unsigned int i;
+
+  if (!file.good())
+    return 1;
+
+  while (getline(file, line)) {
+
+    istringstream item(line);
+
+    if (!(item >> key))
+      continue;
+
+    if (key == "fw_id")
+      item >> hex >> fw_id;
+    else if (key == "phases")
+      item >> hex >> ckpt->phases;
+    else if (key == "idelay") {
+      if (item >> hex >> line_num && line_num < CKPT_IDELAY_NUM &&
+          item >> ckpt->idelay_data[line_num] >> ckpt->idelay_clk[line_num])
+        ckpt->idelay_valid |= (1 << line_num);
+    }
+    else if (key == "si570") {
+      for (i = 0; i < CKPT_SI570_REGS && item >> hex >> val; i++)
+        ckpt->si570[i] = val;
+
+      ckpt->si570_valid = (i == CKPT_SI570_REGS);
+    }
+  }
+
+  // other firmware - state is not valid
+  if (fw_id != ckpt->fw_id) {
+    checkpoint_clear(ckpt);
+    return 1;
+  }
+
+  return 0;
+}
+
+int checkpoint_save(const struct checkpoint_t* ckpt) {
+
+  ofstream file(ckpt->path.c_str());
+  unsigned int i;
+
+  if (!file.good()) {
+    cout << "Checkpoint: can't write state file " << ckpt->path << endl;
+    return 1;
+  }
+
+  file << hex;
+  file << "fw_id " << ckpt->fw_id << endl;
+  file << "phases " << ckpt->phases << endl;
+
+  for (i = 0; i < CKPT_IDELAY_NUM; i++)
+    if (ckpt->idelay_valid & (1 << i))
+      file << "idelay " << i << " " << ckpt->idelay_data[i] << " " << ckpt->idelay_clk[i] << endl;
+
+  if (ckpt->si570_valid) {
+    file << "si570";
+    for (i = 0; i < CKPT_SI570_REGS; i++)
+      file << " " << (uint32_t)ckpt->si570[i];
+    file << endl;
+  }
+
+  return file.good() ? 0 : 1;
+}
+
+void checkpoint_init(struct checkpoint_t* ckpt, const char* prog, const char* port,
+                        uint32_t fw_id, int resume)
+{
+  ostringstream path;
+
+  // like /var/tmp/fmc_config_250m_4ch_ttyUSB0_1332a11.ckpt
+  path << CKPT_DIR << "/" << basename_of(prog) << "_" << basename_of(port) << "_"
+      << hex << fw_id << ".ckpt";
+
+  ckpt->path = path.str();
+  ckpt->fw_id = fw_id;
+  checkpoint_clear(ckpt);
+
+  if (resume == 0) {
+    checkpoint_save(ckpt);
+    return;
+  }
+
+  if (checkpoint_load(ckpt) != 0) {
+    cout << "Checkpoint: no previous state for this board, starting from the beginning" << endl;
+    return;
+  }
+
+  cout << "Checkpoint: resuming configuration (" << ckpt->path << ")" << endl;
+}
+
+int checkpoint_phase_run(struct checkpoint_t* ckpt, enum ckpt_phase_t phase)
+{
+  // start at first unfinished phase, everything after it is run again
+  if (ckpt->running == 0 && (ckpt->phases & (1 << phase))) {
+    cout << "Checkpoint: " << ckpt_phase_names[phase] << " finished previously, skipping" << endl;
+    return 0;
+  }
+
+  if (ckpt->running == 0) {
+    // state of next phases is not valid anymore
+    ckpt->phases &= (1 << phase) - 1;
+    ckpt->running = 1;
+  }
+
+  return 1;
+}
+
+void checkpoint_phase_done(struct checkpoint_t* ckpt, enum ckpt_phase_t phase)
+{
+  ckpt->phases |= (1 << phase);
+  checkpoint_save(ckpt);
+}
+
+void checkpoint_set_idelay(struct checkpoint_t* ckpt, const struct delay_lines *delay_data,
+                        const struct delay_lines *delay_clk)
+{
+  unsigned int i;
+
+  for (i = 0; i < CKPT_IDELAY_NUM; i++) {
+
+    if (delay_data == NULL || delay_data[i].init == DELAY_LINES_END)
+      break;
+
+    if (delay_data[i].init == DELAY_LINES_NO_INIT)
+      continue;
+
+    ckpt->idelay_data[i] = delay_data[i].value;
+    ckpt->idelay_clk[i] = 0;
+    ckpt->idelay_valid |= (1 << i);
+  }
+
+  for (i = 0; i < CKPT_IDELAY_NUM; i++) {
+
+    if (delay_clk == NULL || delay_clk[i].init == DELAY_LINES_END)
+      break;
+
+    if (delay_clk[i].init == DELAY_LINES_NO_INIT)
+      continue;
+
+    ckpt->idelay_clk[i] = delay_clk[i].value;
+    ckpt->idelay_valid |= (1 << i);
+  }
+}
+
+void checkpoint_set_si570(struct checkpoint_t* ckpt, const vector<uint32_t>& regs)
+{
+  unsigned int i;
+
+  if (regs.size() < CKPT_SI570_REGS)
+    return;
+
+  for (i = 0; i < CKPT_SI570_REGS; i++)
+    ckpt->si570[i] = regs[i];
+
+  ckpt->si570_valid = 1;
+}
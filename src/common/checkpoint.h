@@ -0,0 +1,75 @@
+//============================================================================
+// Author      : Andrzej Wojenski
+// Version     : 1.0
+// Description : Checkpoint of FMC card configuration
+//               Keeps finished configuration phases, IDELAY values and Si570
+//               registers in a state file (one per program, port and firmware ID),
+//               so interrupted configuration can be resumed (--resume)
+//============================================================================
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "common.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// directory for state files (survives reboot, unlike /tmp)
+#define CKPT_DIR "/var/tmp"
+
+#define CKPT_IDELAY_NUM 4
+#define CKPT_SI570_REGS 6 // registers 7-12
+
+// Configuration phases (in order of fmc_config_* programs)
+// firmware identification is not a phase, it is always done
+enum ckpt_phase_t {
+  PHASE_LEDS,
+  PHASE_TRIGGER,
+  PHASE_LM75A,
+  PHASE_EEPROM,
+  PHASE_AMC7823,
+  PHASE_SI570,
+  PHASE_AD9510,
+  PHASE_ADC,
+  PHASE_IDELAY,
+  PHASE_BPM_SWAP,
+  PHASE_DSP,
+  /* add more phases here */
+  PHASE_NUM
+};
+
+struct checkpoint_t {
+  std::string path; // state file
+  uint32_t fw_id;
+  uint32_t phases; // finished phases (bit mask)
+  int running; // some phase has been run, following phases can't be skipped
+  uint32_t idelay_valid; // bit mask
+  uint32_t idelay_data[CKPT_IDELAY_NUM]; // data lines tap values
+  uint32_t idelay_clk[CKPT_IDELAY_NUM]; // clk lines tap values (bits 16..)
+  int si570_valid;
+  uint8_t si570[CKPT_SI570_REGS];
+};
+
+/* to be filled by main */
+extern int resume;
+
+// Prepares checkpoint for board (program, port, firmware ID)
+// resume = 0 - previous state is discarded
+// resume = 1 - previous state is loaded (if exists)
+void checkpoint_init(struct checkpoint_t* ckpt, const char* prog, const char* port,
+                        uint32_t fw_id, int resume);
+// return - 1 phase has to be run, 0 phase was finished previously (skip it)
+int checkpoint_phase_run(struct checkpoint_t* ckpt, enum ckpt_phase_t phase);
+// marks phase as finished and saves state file
+void checkpoint_phase_done(struct checkpoint_t* ckpt, enum ckpt_phase_t phase);
+// store IDELAY values (tables as used by set_fpga_delay_s, NULL if not used)
+void checkpoint_set_idelay(struct checkpoint_t* ckpt, const struct delay_lines *delay_data,
+                        const struct delay_lines *delay_clk);
+// store Si570 registers 7-12
+void checkpoint_set_si570(struct checkpoint_t* ckpt, const std::vector<uint32_t>& regs);
+// return - 0 ok, 1 error
+int checkpoint_save(const struct checkpoint_t* ckpt);
+
+#endif
@@ -10,6 +10,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <string>
 
 #define NKEYS (sizeof(lookuptable)/sizeof(struct sym_t))
 
@@ -18,8 +20,23 @@ enum platform_t platform;
 const char* platform_name;
 int verbose;
 int quiet;
+int calibrate;
+int three_wire;
 const struct delay_lines *delay_data_l;
 const struct delay_lines *delay_clk_l;
+const char* eye_map_file;
+
+const struct option long_options[] = {
+    { "platform", required_argument, NULL, 'p' },
+    { "verbose", no_argument, NULL, 'v' },
+    { "quiet", no_argument, NULL, 'q' },
+    { "help", no_argument, NULL, 'h' },
+    { "resume", no_argument, NULL, 'r' },
+    { "eye-map", required_argument, NULL, 'e' },
+    { "calibrate", no_argument, NULL, 'c' },
+    { "three-wire", no_argument, NULL, 'w' },
+    { NULL, 0, NULL, 0 }
+};
 
 static const struct sym_t lookuptable[] = {
     { ML605_STRING, ML605 },
@@ -33,6 +50,14 @@ void help(void) {
   fprintf(stderr, "  -p <platform>  supportted platforms (ML605/KC705/AFC)\n");
   fprintf(stderr, "  -v             verbose operation\n");
   fprintf(stderr, "  -q             quiet: do not display warnings\n");
+  fprintf(stderr, "  -r, --resume   continue interrupted configuration from the first\n");
+  fprintf(stderr, "                 unfinished phase (same port and firmware)\n");
+  fprintf(stderr, "  -e, --eye-map <file>  scan data vs clock IDELAY taps of each ADC\n");
+  fprintf(stderr, "                 (250M only), maps in <file>_ch<N> (.pgm or CSV)\n");
+  fprintf(stderr, "  -c, --calibrate  calibrate again, ignore calibration record in FMC EEPROM\n");
+  fprintf(stderr, "                 (250M only)\n");
+  fprintf(stderr, "  -w, --three-wire  read ADC chips in 3-wire SPI mode (SDIO line, SDO off),\n");
+  fprintf(stderr, "                 needs bidirectional SPI core (250M only)\n");
   fprintf(stderr, "  -h             display this help and exit\n");
   fprintf(stderr, "\n");
   fprintf(stderr, "Report bugs to <a.wojenski@elka.pw.edu.pl>\n");
@@ -72,10 +97,11 @@ enum platform_t lookupstring_i(const char *key)
   return ret;
 }
 
-void set_fpga_delay(commLink* _commLink, uint32_t addr, uint32_t delay_val,
+int set_fpga_delay(commLink* _commLink, uint32_t addr, uint32_t delay_val,
                       enum delay_type_t dly_type)
 {
   wb_data data;
+  int err;
 
   data.data_send.resize(1);
   data.wb_addr = addr;
@@ -88,26 +114,119 @@ void set_fpga_delay(commLink* _commLink, uint32_t addr, uint32_t delay_val,
 
   //data.data_send[0] = IDELAY_ALL_LINES | IDELAY_TAP(delay_val) | IDELAY_UPDATE; // should be 0x0050003f
   data.data_send[0] |= IDELAY_TAP(delay_val) | IDELAY_UPDATE; // should be 0x0050003f
-  _commLink->fmc_config_send(&data);
+  if ((err = _commLink->fmc_config_send(&data)) != 0)
+    return err;
   // check data
-  _commLink->fmc_config_read(&data);
+  if ((err = _commLink->fmc_config_read(&data)) != 0)
+    return err;
   //assert(data.data_read[0] == (IDELAY_ALL_LINES | IDELAY_TAP(delay_l[0]) | IDELAY_UPDATE));
   usleep(1000);
   data.data_send[0] = (IDELAY_ALL_LINES | IDELAY_TAP(delay_val)) & 0xFFFFFFFE; // should be 0x0050003f
-  _commLink->fmc_config_send(&data);
+
+  return _commLink->fmc_config_send(&data);
 }
 
 // safer set FPGA delay
-void set_fpga_delay_s(commLink* _commLink, uint32_t addr, const struct delay_lines *delay_val,
+int set_fpga_delay_s(commLink* _commLink, uint32_t addr, const struct delay_lines *delay_val,
                         enum delay_type_t dly_type)
 {
   if (delay_val->init == DELAY_LINES_NO_INIT)
-    return;
+    return 0;
 
   if (delay_val->init == DELAY_LINES_END)
+    return 0;
+
+  return set_fpga_delay(_commLink, addr, delay_val->value, dly_type);
+}
+
+int fmc_config_read_check(commLink* _commLink, struct wb_data* data)
+{
+  int err;
+
+  err = _commLink->fmc_config_read(data);
+  if (err)
+    return err;
+
+  return data->data_read.empty() ? 1 : 0;
+}
+
+void phase_check(int err, const char* step)
+{
+  if (err == 0)
     return;
 
-  set_fpga_delay(_commLink, addr, delay_val->value, dly_type);
+  fprintf(stderr, "%s: %s failed (error %d), configuration stopped\n", program, step, err);
+  exit(1);
+}
+
+int eye_map_write(const char* path, unsigned int channel, const std::vector<uint32_t>& errors,
+                        unsigned int taps, unsigned int samples)
+{
+  std::string name(path), ext;
+  std::string::size_type dot = name.rfind('.');
+  unsigned int tap, clk_tap;
+  char suffix[16];
+  FILE* f;
+  int pgm;
+
+  if (errors.size() < taps * taps || samples == 0)
+    return 1;
+
+  if (dot != std::string::npos && name.find('/', dot) == std::string::npos) {
+    ext = name.substr(dot);
+    name.erase(dot);
+  }
+
+  pgm = (strcasecmp(ext.c_str(), ".pgm") == 0);
+  if (!pgm && ext.empty())
+    ext = ".csv";
+
+  snprintf(suffix, sizeof(suffix), "_ch%u", channel);
+  name += suffix + ext;
+
+  f = fopen(name.c_str(), pgm ? "wb" : "w");
+  if (f == NULL) {
+    fprintf(stderr, "%s: can't write eye map %s\n", program, name.c_str());
+    return 1;
+  }
+
+  if (pgm)
+    fprintf(f, "P5\n# %s clock tap (rows) vs data tap, %u samples\n%u %u\n255\n",
+        program, samples, taps, taps);
+  else {
+    fprintf(f, "clk\\data");
+    for (tap = 0; tap < taps; tap++)
+      fprintf(f, ",%u", tap);
+    fprintf(f, "\n");
+  }
+
+  for (clk_tap = 0; clk_tap < taps; clk_tap++) {
+
+    if (!pgm)
+      fprintf(f, "%u", clk_tap);
+
+    for (tap = 0; tap < taps; tap++) {
+
+      uint32_t err = errors[clk_tap * taps + tap];
+
+      if (pgm)
+        fputc(err >= samples ? 0 : 255 - err * 255 / samples, f);
+      else
+        fprintf(f, ",%u", err);
+    }
+
+    if (!pgm)
+      fprintf(f, "\n");
+  }
+
+  if (fclose(f) != 0) {
+    fprintf(stderr, "%s: can't write eye map %s\n", program, name.c_str());
+    return 1;
+  }
+
+  printf("Eye map written to %s\n", name.c_str());
+
+  return 0;
 }
 
 void enum_to_string(enum platform_t platform, char *platform_name, int len)
@@ -11,6 +11,8 @@
 #include "commLink.h"
 
 #include <stdint.h>
+#include <getopt.h>
+#include <vector>
 
 #define MAX_PLATFORM_SIZE_ID 8
 #define ML605_STRING "ML605"
@@ -18,6 +20,9 @@
 #define AFC_STRING "AFC"
 #define NOPLAT_STRING "NOPLAT"
 
+// command-line options (getopt_long)
+#define SHORT_OPTIONS "p:vqhre:cw"
+
 // delay lines definitions
 #define DELAY_LINES_NO_INIT 0
 #define DELAY_LINES_INIT 1
@@ -55,15 +60,30 @@ extern enum platform_t platform;
 extern const char* platform_name;
 extern int verbose;
 extern int quiet;
+extern int calibrate;
+extern int three_wire;
 extern const struct delay_lines *delay_data_l;
 extern const struct delay_lines *delay_clk_l;
+extern const char* eye_map_file;
+
+extern const struct option long_options[];
 
 void help(void);
 enum platform_t lookupstring_i(const char *key);
 enum platform_t lookupstring_i(const char *key);
-void set_fpga_delay(commLink* _commLink, uint32_t addr, uint32_t delay_val,
+int set_fpga_delay(commLink* _commLink, uint32_t addr, uint32_t delay_val,
                         enum delay_type_t dly_type);
-void set_fpga_delay_s(commLink* _commLink, uint32_t addr, const struct delay_lines *delay_val,
+int set_fpga_delay_s(commLink* _commLink, uint32_t addr, const struct delay_lines *delay_val,
                         enum delay_type_t dly_type);
+// fmc_config_read, data->data_read[0] valid if 0 returned
+int fmc_config_read_check(commLink* _commLink, struct wb_data* data);
+// stops configuration if a phase step failed (err != 0), the phase is not
+// marked done then and --resume runs it again
+void phase_check(int err, const char* step);
+// eye map of one channel (errors[clk_tap * taps + data_tap] out of samples),
+// written to <path>_ch<channel>, PGM (binary, white - no errors) if path ends
+// with .pgm (extension kept), otherwise CSV (rows - clock taps)
+int eye_map_write(const char* path, unsigned int channel, const std::vector<uint32_t>& errors,
+                        unsigned int taps, unsigned int samples);
 
 #endif
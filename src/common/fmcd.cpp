@@ -0,0 +1,287 @@
+//============================================================================
+// Author      : Andrzej Wojenski
+// Version     : 1.0
+// Description : Local control socket for FMC configuration daemons (fmc_configd_*)
+//============================================================================
+
+#include "fmcd.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+static volatile sig_atomic_t fmcd_stop;
+
+static void fmcd_signal(int /* sig */) {
+
+  fmcd_stop = 1;
+}
+
+static string basename_of(const char* path) {
+
+  string p(path);
+
+  return p.substr(p.rfind('/') + 1);
+}
+
+string fmcd_socket_path(const char* prog, const char* port) {
+
+  return string(FMCD_SOCKET_DIR) + "/" + basename_of(prog) + "_" + basename_of(port) + ".sock";
+}
+
+int fmcd_parse_num(const string& str, uint32_t* val) {
+
+  char* end;
+  unsigned long num;
+
+  if (str.empty())
+    return 1;
+
+  errno = 0;
+  num = strtoul(str.c_str(), &end, 0);
+
+  if (*end != '\0' || errno != 0)
+    return 1;
+
+  *val = num;
+
+  return 0;
+}
+
+static int fmcd_listen(const char* socket_path) {
+
+  struct sockaddr_un addr;
+  int fd;
+
+  if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+    cout << "Daemon: socket path too long: " << socket_path << endl;
+    return -1;
+  }
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    cout << "Daemon: can't create socket" << endl;
+    return -1;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, socket_path);
+
+  // socket answering connect() belongs to running daemon, only stale
+  // socket left by previous instance is removed
+  if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+    cout << "Daemon: another daemon is listening on " << socket_path << endl;
+    close(fd);
+    return -1;
+  }
+
+  if (errno == ECONNREFUSED)
+    unlink(socket_path);
+
+  // socket used by connect() can't be bound any more
+  close(fd);
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    cout << "Daemon: can't create socket" << endl;
+    return -1;
+  }
+
+  if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, FMCD_MAX_CLIENTS) != 0) {
+    cout << "Daemon: can't bind socket " << socket_path << endl;
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+static string fmcd_execute(const string& line, const struct fmcd_cmd* cmds, int num_cmds) {
+
+  istringstream item(line);
+  vector<string> args;
+  string arg, reply;
+  int i;
+
+  while (item >> arg)
+    args.push_back(arg);
+
+  if (args.empty())
+    return "ERR empty request\n";
+
+  if (args[0] == "help") {
+    for (i = 0; i < num_cmds; i++)
+      reply += string(" ") + cmds[i].usage + ";";
+    return "OK" + reply + "\n";
+  }
+
+  for (i = 0; i < num_cmds; i++)
+    if (args[0] == cmds[i].name)
+      break;
+
+  if (i == num_cmds)
+    return "ERR unknown command " + args[0] + "\n";
+
+  if (cmds[i].handler(args, reply) != 0)
+    return "ERR " + reply + "\n";
+
+  return (reply.empty() ? "OK" : "OK " + reply) + "\n";
+}
+
+static int fmcd_write(int fd, const string& reply) {
+
+  const char* buf = reply.c_str();
+  size_t len = reply.size();
+  ssize_t n;
+
+  while (len > 0) {
+
+    n = write(fd, buf, len);
+
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return 1;
+    }
+
+    buf += n;
+    len -= n;
+  }
+
+  return 0;
+}
+
+// return - 0 client still connected, 1 client closed
+static int fmcd_client(int fd, string& pending, const struct fmcd_cmd* cmds, int num_cmds) {
+
+  char buf[FMCD_LINE_MAX];
+  string::size_type pos;
+  ssize_t n;
+
+  n = read(fd, buf, sizeof(buf));
+
+  if (n < 0 && (errno == EINTR || errno == EAGAIN))
+    return 0;
+
+  if (n <= 0)
+    return 1;
+
+  pending.append(buf, n);
+
+  while ((pos = pending.find('\n')) != string::npos) {
+
+    string line = pending.substr(0, pos);
+    pending.erase(0, pos + 1);
+
+    if (!line.empty() && line[line.size() - 1] == '\r')
+      line.erase(line.size() - 1);
+
+    if (fmcd_write(fd, fmcd_execute(line, cmds, num_cmds)) != 0)
+      return 1;
+  }
+
+  // no line end, client is misbehaving
+  if (pending.size() > FMCD_LINE_MAX) {
+    fmcd_write(fd, "ERR request too long\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+int fmcd_serve(const char* socket_path, const struct fmcd_cmd* cmds, int num_cmds) {
+
+  struct pollfd pfd[FMCD_MAX_CLIENTS + 1];
+  string pending[FMCD_MAX_CLIENTS + 1];
+  struct sigaction sa;
+  int listen_fd, nfds, fd, ret, i;
+
+  listen_fd = fmcd_listen(socket_path);
+  if (listen_fd < 0)
+    return 1;
+
+  fmcd_stop = 0;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = fmcd_signal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  // client closing connection must not kill daemon
+  signal(SIGPIPE, SIG_IGN);
+
+  pfd[0].fd = listen_fd;
+  pfd[0].events = POLLIN;
+  nfds = 1;
+
+  cout << "Daemon: listening on " << socket_path << endl;
+
+  while (!fmcd_stop) {
+
+    for (i = 0; i < nfds; i++)
+      pfd[i].revents = 0;
+
+    ret = poll(pfd, nfds, -1);
+
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+
+    // requests are handled in order, one client at a time
+    for (i = nfds - 1; i > 0; i--) {
+
+      if (pfd[i].revents == 0)
+        continue;
+
+      if ((pfd[i].revents & (POLLERR | POLLNVAL)) ||
+          fmcd_client(pfd[i].fd, pending[i], cmds, num_cmds) != 0) {
+        close(pfd[i].fd);
+        // move last client to freed slot
+        nfds--;
+        pfd[i] = pfd[nfds];
+        pending[i] = pending[nfds];
+        pending[nfds].clear();
+      }
+    }
+
+    if (pfd[0].revents & POLLIN) {
+
+      fd = accept(listen_fd, NULL, NULL);
+
+      if (fd >= 0) {
+        if (nfds > FMCD_MAX_CLIENTS) {
+          fmcd_write(fd, "ERR too many clients\n");
+          close(fd);
+        }
+        else {
+          pfd[nfds].fd = fd;
+          pfd[nfds].events = POLLIN;
+          pending[nfds].clear();
+          nfds++;
+        }
+      }
+    }
+  }
+
+  for (i = 1; i < nfds; i++)
+    close(pfd[i].fd);
+
+  close(listen_fd);
+  unlink(socket_path);
+
+  cout << "Daemon: stopped" << endl;
+
+  return 0;
+}
@@ -0,0 +1,47 @@
+//============================================================================
+// Author      : Andrzej Wojenski
+// Version     : 1.0
+// Description : Local control socket for FMC configuration daemons (fmc_configd_*)
+//               Daemon keeps the link and all interface cores initialised,
+//               requests are text lines sent over a Unix socket:
+//                 request: <command> [arg ...]\n
+//                 reply:   OK [text]\n or ERR <text>\n
+//============================================================================
+
+#ifndef FMCD_H
+#define FMCD_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// directory for control sockets
+#define FMCD_SOCKET_DIR "/var/run"
+#define FMCD_MAX_CLIENTS 8
+#define FMCD_LINE_MAX 256
+
+// Command handler
+// args[0] - command name, args[1..] - arguments
+// reply - text sent back after OK/ ERR
+// return - 0 ok, != 0 error
+typedef int (*fmcd_handler_t)(const std::vector<std::string>& args, std::string& reply);
+
+struct fmcd_cmd {
+  const char* name;
+  const char* usage; // shown by "help" command
+  fmcd_handler_t handler;
+};
+
+// like /var/run/fmc_configd_250m_4ch_ttyUSB0.sock
+std::string fmcd_socket_path(const char* prog, const char* port);
+
+// Serves requests until SIGINT/ SIGTERM
+// requests are handled one at a time, so link access is never interleaved
+// return - 0 ok, 1 socket error
+int fmcd_serve(const char* socket_path, const struct fmcd_cmd* cmds, int num_cmds);
+
+// helper for handlers, accepts hex (0x...) and decimal numbers
+// return - 0 ok, 1 not a number
+int fmcd_parse_num(const std::string& str, uint32_t* val);
+
+#endif
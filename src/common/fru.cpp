@@ -0,0 +1,105 @@
+//============================================================================
+// Author      : Andrzej Wojenski
+// Version     : 1.0
+// Description : IPMI FRU information of FMC card (FMC EEPROM)
+//============================================================================
+
+#include "fru.h"
+
+using namespace std;
+
+// zero checksum - all bytes of header or area sum to 0
+static int fru_checksum(const vector<uint8_t>& data, unsigned int pos, unsigned int len) {
+
+  uint8_t sum = 0;
+  unsigned int i;
+
+  for (i = 0; i < len; i++)
+    sum += data[pos + i];
+
+  return sum != 0;
+}
+
+// Type/length byte: bits 7:6 type, bits 5:0 number of bytes
+static string fru_field(const vector<uint8_t>& data, unsigned int pos, unsigned int len, int type) {
+
+  static const char bcd_plus[] = "0123456789 -.???";
+  static const char hex_digits[] = "0123456789ABCDEF";
+  string str;
+  unsigned int i, bits, acc;
+
+  switch (type) {
+  case 0: // binary, shown as hex
+    for (i = 0; i < len; i++) {
+      str += hex_digits[data[pos + i] >> 4];
+      str += hex_digits[data[pos + i] & 0x0F];
+    }
+    break;
+  case 1: // BCD plus
+    for (i = 0; i < len; i++) {
+      str += bcd_plus[data[pos + i] >> 4];
+      str += bcd_plus[data[pos + i] & 0x0F];
+    }
+    break;
+  case 2: // 6-bit ASCII packed, LSB first
+    acc = 0;
+    bits = 0;
+    for (i = 0; i < len; i++) {
+      acc |= data[pos + i] << bits;
+      bits += 8;
+      while (bits >= 6) {
+        str += (char)((acc & 0x3F) + 0x20);
+        acc >>= 6;
+        bits -= 6;
+      }
+    }
+    break;
+  default: // 8-bit ASCII + Latin 1
+    str.assign(data.begin() + pos, data.begin() + pos + len);
+    break;
+  }
+
+  // padding
+  while (!str.empty() && (str[str.size() - 1] == ' ' || str[str.size() - 1] == '\0'))
+    str.erase(str.size() - 1);
+
+  return str;
+}
+
+int fru_parse_board(const vector<uint8_t>& data, struct fru_board* board) {
+
+  string* fields[] = { &board->manufacturer, &board->product, &board->serial, &board->part_number };
+  unsigned int area, len, pos, end, i, n;
+
+  if (data.size() < FRU_HEADER_SIZE || data[0] != FRU_FORMAT_VERSION ||
+      fru_checksum(data, 0, FRU_HEADER_SIZE))
+    return 1;
+
+  area = data[3] * FRU_AREA_UNIT;
+  if (area == 0 || area + 2 > data.size())
+    return 1;
+
+  len = data[area + 1] * FRU_AREA_UNIT;
+  if (data[area] != FRU_FORMAT_VERSION || len == 0 || area + len > data.size() ||
+      fru_checksum(data, area, len))
+    return 1;
+
+  // version, length, language, manufacturing date (3 bytes)
+  pos = area + 6;
+  end = area + len;
+
+  for (i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+
+    if (pos >= end || data[pos] == FRU_FIELD_END)
+      return 1;
+
+    n = data[pos] & 0x3F;
+    if (pos + 1 + n > end)
+      return 1;
+
+    *fields[i] = fru_field(data, pos + 1, n, data[pos] >> 6);
+    pos += 1 + n;
+  }
+
+  return 0;
+}
@@ -0,0 +1,34 @@
+//============================================================================
+// Author      : Andrzej Wojenski
+// Version     : 1.0
+// Description : IPMI FRU information of FMC card (FMC EEPROM)
+//               Common header and board info area (Platform Management FRU
+//               Information Storage Definition v1.0)
+//============================================================================
+
+#ifndef FRU_H
+#define FRU_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define FRU_EEPROM_OFFSET 0x0000
+#define FRU_READ_SIZE 256 // bytes read at once, board info area has to be within
+#define FRU_HEADER_SIZE 8
+#define FRU_FORMAT_VERSION 0x01
+#define FRU_AREA_UNIT 8 // area offsets and lengths are multiples of 8 bytes
+#define FRU_FIELD_END 0xC1 // end of fields marker
+
+struct fru_board {
+  std::string manufacturer;
+  std::string product;
+  std::string serial;
+  std::string part_number;
+};
+
+// data - FRU bytes from FRU_EEPROM_OFFSET
+// return - 0 ok, 1 no FRU or board info area (format or checksum error)
+int fru_parse_board(const std::vector<uint8_t>& data, struct fru_board* board);
+
+#endif
@@ -0,0 +1,33 @@
+//============================================================================
+// Author      : Andrzej Wojenski
+// Version     : 1.0
+// Description : FMC card descriptions for automatic detection (fmc_config_auto)
+//               Each card is described in its own file, so its register map
+//               (reg_map/) can be used
+//============================================================================
+#ifndef FMC_AUTO_H_
+#define FMC_AUTO_H_
+
+#include <stdint.h>
+
+// configuration program selected by FRU board info (product name and part
+// number, case insensitive), first matching keyword wins
+struct fmc_auto_profile {
+  const char* keyword; // NULL - default profile (last entry)
+  const char* program;
+};
+
+struct fmc_auto_card {
+  const char* name;
+  uint32_t status_addr; // FMC status register (FPGA_CTRL_REGS | WB_FMC_STATUS)
+  uint32_t fw_id; // expected firmware ID (status >> 3)
+  uint32_t eeprom_i2c; // I2C core of FMC EEPROM
+  uint32_t eeprom_addr; // FMC EEPROM address
+  int sys_freq; // Wishbone clock [Hz]
+  const struct fmc_auto_profile* profiles;
+};
+
+extern const struct fmc_auto_card fmc_auto_130m;
+extern const struct fmc_auto_card fmc_auto_250m;
+
+#endif /* FMC_AUTO_H_ */
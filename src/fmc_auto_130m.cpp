@@ -0,0 +1,27 @@
+//============================================================================
+// Author      : Andrzej Wojenski
+// Version     : 1.0
+// Description : FMC ADC 130M 4CH card description for automatic detection
+//============================================================================
+#include "plat_opts.h" // must be included before reg_map*
+#include "data.h"
+#include "reg_map/fmc_config_130m_4ch.h"
+
+#include "fmc_auto.h"
+
+static const struct fmc_auto_profile fmc_130m_profiles[] = {
+  { "PASSIVE",  "fmc_config_130m_4ch_passive" },
+  { "CRYSTEK",  "fmc_config_130m_4ch_crystek" },
+  { "EXT_CLK",  "fmc_config_130m_4ch_ext_clk_no_pll" },
+  { NULL,       "fmc_config_130m_4ch" }
+};
+
+const struct fmc_auto_card fmc_auto_130m = {
+  "FMC ADC 130M 4CH",
+  FPGA_CTRL_REGS | WB_FMC_STATUS,
+  0x01332A11,
+  FPGA_EEPROM_I2C,
+  EEPROM_ADDR,
+  FPGA_SYS_FREQ,
+  fmc_130m_profiles
+};
@@ -0,0 +1,24 @@
+//============================================================================
+// Author      : Andrzej Wojenski
+// Version     : 1.0
+// Description : FMC ADC 250M 4CH card description for automatic detection
+//============================================================================
+#include "data.h"
+#include "reg_map/fmc_config_250m_4ch.h"
+
+#include "fmc_auto.h"
+
+static const struct fmc_auto_profile fmc_250m_profiles[] = {
+  { "PASSIVE",  "fmc_config_250m_4ch_passive" },
+  { NULL,       "fmc_config_250m_4ch" }
+};
+
+const struct fmc_auto_card fmc_auto_250m = {
+  "FMC ADC 250M 4CH",
+  FPGA_CTRL_REGS | WB_FMC_STATUS,
+  0x01332A11,
+  FPGA_EEPROM_I2C,
+  EEPROM_ADDR,
+  FPGA_SYS_FREQ,
+  fmc_250m_profiles
+};
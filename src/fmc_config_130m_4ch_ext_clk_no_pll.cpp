@@ -19,6 +19,7 @@
 
 #include <iostream>
 #include <unistd.h>  /* getopt */
+#include <getopt.h>  /* getopt_long */
 
 #include "config.h"
 #include "plat_opts.h"
@@ -35,6 +36,7 @@
 #include "chip/eeprom_24a64.h"
 #include "chip/lm75a.h"
 #include "platform/fmc130m_plat.h"
+#include "checkpoint.h"
 
 using namespace std;
 
@@ -44,22 +46,24 @@ int main(int argc, const char **argv) {
       "Author: Andrzej Wojenski" << endl;
 
   WBInt_drv* int_drv;
+  gpio_int* gpio;
   wb_data data;
   vector<uint16_t> amc_temp;
   vector<uint16_t> test_pattern;
   commLink* _commLink = new commLink();
-  uint32_t data_temp;
   int opt, error;
+  struct checkpoint_t ckpt;
 
    /* Default command-line arguments */
   program = argv[0];
   quiet = 0;
   verbose = 0;
+  resume = 0;
   error = 0;
   platform = PLATFORM_NOT_SET;
 
   /* Process the command-line arguments */
-  while ((opt = getopt(argc, (char **)argv, "p:vqh")) != -1) {
+  while ((opt = getopt_long(argc, (char **)argv, SHORT_OPTIONS, long_options, NULL)) != -1) {
     switch (opt) {
     case 'p':
       if (strlen(optarg) > MAX_PLATFORM_SIZE_ID) {
@@ -93,6 +97,15 @@ int main(int argc, const char **argv) {
     case 'q':
       quiet = 1;
       break;
+    case 'r':
+      resume = 1;
+      break;
+    case 'e':
+    case 'c':
+    case 'w':
+      // common options of FMC ADC 250M programs
+      fprintf(stderr, "%s: option -%c is supported by FMC ADC 250M programs only\n", program, opt);
+      return 1;
     case 'h':
       help();
       return 1;
@@ -121,7 +134,7 @@ int main(int argc, const char **argv) {
 
   // CommLink configuration
   // Adding communication interfaces
-  _commLink->regWBMaster(new rs232_syscon_driver());
+  _commLink->regWBMaster(new rs232_syscon_driver(RS232_PORT, FPGA_CTRL_REGS | WB_FMC_STATUS));
 
   int_drv = _commLink->regIntDrv(SI571_I2C_DRV, FPGA_SI571_I2C, new i2c_int());
   ((i2c_int*)int_drv)->i2c_init(FPGA_SYS_FREQ, 100000); // 100kHz
@@ -136,7 +149,13 @@ int main(int argc, const char **argv) {
   int_drv = _commLink->regIntDrv(LM75A_I2C_DRV, FPGA_LM75A_I2C, new i2c_int());
   ((i2c_int*)int_drv)->i2c_init(FPGA_SYS_FREQ, 400000); // 400kHz
 
-  _commLink->regIntDrv(GENERAL_GPIO_DRV, FPGA_CTRL_REGS, new gpio_int());
+  gpio = (gpio_int*)_commLink->regIntDrv(GENERAL_GPIO_DRV, FPGA_CTRL_REGS, new gpio_int());
+
+  // Chip drivers
+  LM75A_drv::LM75A_setCommLink(_commLink, LM75A_I2C_DRV);
+  EEPROM_drv::EEPROM_setCommLink(_commLink, EEPROM_I2C_DRV);
+  Si570_drv::si570_setCommLink(_commLink, SI571_I2C_DRV, GENERAL_GPIO_DRV);
+  AD9510_drv::AD9510_setCommLink(_commLink, AD9510_SPI_DRV);
 
   // ======================================================
   //                Firmware identification
@@ -148,7 +167,7 @@ int main(int argc, const char **argv) {
   data.wb_addr = FPGA_CTRL_REGS | WB_FMC_STATUS; // FMC status register (HW address)
 
   // check id data
-  _commLink->fmc_config_read(&data);
+  phase_check(fmc_config_read_check(_commLink, &data), "Firmware identification");
 
   cout << "Reg: " << hex << (data.data_read[0]) << endl;
   cout << "Firmware ID: " << hex << (data.data_read[0] >> 3) <<
@@ -157,256 +176,282 @@ int main(int argc, const char **argv) {
   // Check communication
   assert(0x01332A11 == (data.data_read[0] >> 3) );
 
+  // Finished phases are kept in state file, --resume skips them
+  checkpoint_init(&ckpt, program, RS232_PORT, data.data_read[0] >> 3, resume);
+
   // ======================================================
   //                  LEDs configuration
   // ======================================================
-  cout << "============================================" << endl <<
-      "            LEDs configuration              " << endl <<
-      "============================================" << endl;
+  if (checkpoint_phase_run(&ckpt, PHASE_LEDS)) {
+    cout << "============================================" << endl <<
+        "            LEDs configuration              " << endl <<
+        "============================================" << endl;
 
-  data.wb_addr = FPGA_CTRL_REGS | WB_MONITOR_CTRL; // monitor register (HW address)
+    // LEDs field of monitor register (HW address), one LED after another, then all
+    struct gpio_field leds = { FPGA_CTRL_REGS | WB_MONITOR_CTRL, WB_MONITOR_CTRL_LEDS };
+    uint32_t leds_val;
 
-  data.data_send[0] = 0x02;
-  _commLink->fmc_config_send(&data);
-  //sleep(4);
+    phase_check(gpio->gpio_set(leds, 0x1), "LEDs configuration");
+    //sleep(4);
 
-  data.data_send[0] = 0x04;
-  _commLink->fmc_config_send(&data);
-  //sleep(4);
+    phase_check(gpio->gpio_set(leds, 0x2), "LEDs configuration");
+    //sleep(4);
 
-  data.data_send[0] = 0x08;
-  _commLink->fmc_config_send(&data);
-  //sleep(4);
+    phase_check(gpio->gpio_set(leds, 0x4), "LEDs configuration");
+    //sleep(4);
 
-  // Check if data properly written
-  _commLink->fmc_config_read(&data);
-  assert( (data.data_read[0] & 0x0E) == 0x08); // ignore TEMP_ALARM pin
+    // Check if data properly written
+    phase_check(gpio->gpio_get(leds, &leds_val), "LEDs configuration");
+    assert(leds_val == 0x4); // TEMP_ALARM pin not in field
 
-  data.data_send[0] = 0x0E;
-  _commLink->fmc_config_send(&data);
-  //sleep(4);
+    phase_check(gpio->gpio_set(leds, 0x7), "LEDs configuration");
+    //sleep(4);
 
-  // Set status config (blue LED)
-  data.data_send[0] = 0x02;
-  _commLink->fmc_config_send(&data);
+    // Set status config (blue LED)
+    phase_check(gpio->gpio_set(leds, 0x1), "LEDs configuration");
 
-  // for trigger test
-  data.data_send[0] = 0x00;
-  _commLink->fmc_config_send(&data);
+    // for trigger test
+    phase_check(gpio->gpio_set(leds, 0x0), "LEDs configuration");
+
+    checkpoint_phase_done(&ckpt, PHASE_LEDS);
+  }
 
   // ======================================================
   //                  Trigger configuration
   // ======================================================
-  cout << "============================================" << endl <<
-      "            Trigger configuration           " << endl <<
-      "============================================" << endl;
+  if (checkpoint_phase_run(&ckpt, PHASE_TRIGGER)) {
+    cout << "============================================" << endl <<
+        "            Trigger configuration           " << endl <<
+        "============================================" << endl;
 
-  data.wb_addr = FPGA_CTRL_REGS | WB_TRG_CTRL; // trigger control
-  data.data_send[0] = 0x01;
-  _commLink->fmc_config_send(&data);
+    data.wb_addr = FPGA_CTRL_REGS | WB_TRG_CTRL; // trigger control
+    data.data_send[0] = 0x01;
+    phase_check(_commLink->fmc_config_send(&data), "Trigger configuration");
+
+    checkpoint_phase_done(&ckpt, PHASE_TRIGGER);
+  }
 
   // ======================================================
   //        LM75A configuration (temperature monitor)
   // ======================================================
-  cout << "============================================" << endl <<
-      "             LM75A check data    " << endl <<
-      "============================================" << endl;
-  // lm75 i2c have timeout
+  if (checkpoint_phase_run(&ckpt, PHASE_LM75A)) {
+    cout << "============================================" << endl <<
+        "             LM75A check data    " << endl <<
+        "============================================" << endl;
+    // lm75 i2c have timeout
+
+    uint16_t lm75a_id;
+    float lm75a_temp;
+
+    if (LM75A_drv::LM75A_readID(LM75A_ADDR_1, &lm75a_id) != 0 ||
+        LM75A_drv::LM75A_readTemp(LM75A_ADDR_1, &lm75a_temp) != 0) {
+      cout << "Error while reading LM75A chip number 1!" << endl;
+      exit(1);
+    }
 
-  LM75A_drv::LM75A_setCommLink(_commLink, LM75A_I2C_DRV);
-  printf("LM75A chip number 1, chip ID: 0x%02x (should be 0xA1)\n", LM75A_drv::LM75A_readID(LM75A_ADDR_1));
-  printf("LM75A chip number 1, temperature: %f *C\n", LM75A_drv::LM75A_readTemp(LM75A_ADDR_1));
-  printf("LM75A chip number 2, chip ID: 0x%02x (should be 0xA1)\n", LM75A_drv::LM75A_readID(LM75A_ADDR_2));
-  printf("LM75A chip number 2, temperature: %f *C\n", LM75A_drv::LM75A_readTemp(LM75A_ADDR_2));
+    printf("LM75A chip number 1, chip ID: 0x%02x (should be 0xA1)\n", lm75a_id);
+    printf("LM75A chip number 1, temperature: %f *C\n", lm75a_temp);
+
+    if (LM75A_drv::LM75A_readID(LM75A_ADDR_2, &lm75a_id) != 0 ||
+        LM75A_drv::LM75A_readTemp(LM75A_ADDR_2, &lm75a_temp) != 0) {
+      cout << "Error while reading LM75A chip number 2!" << endl;
+      exit(1);
+    }
+
+    printf("LM75A chip number 2, chip ID: 0x%02x (should be 0xA1)\n", lm75a_id);
+    printf("LM75A chip number 2, temperature: %f *C\n", lm75a_temp);
+
+    checkpoint_phase_done(&ckpt, PHASE_LM75A);
+  }
 
   // ======================================================
   //                  EEPROM configuration
   // ======================================================
-  cout << "============================================" << endl <<
-      "              EEPROM check    " << endl <<
-      "============================================" << endl;
+  if (checkpoint_phase_run(&ckpt, PHASE_EEPROM)) {
+    cout << "============================================" << endl <<
+        "              EEPROM check    " << endl <<
+        "============================================" << endl;
 
-  EEPROM_drv::EEPROM_setCommLink(_commLink, EEPROM_I2C_DRV);
-  EEPROM_drv::EEPROM_switch(0x02); // according to documentation, switches to i2c fmc lines
-  //EEPROM_drv::EEPROM_sendData(0x00); // wrong address
-  EEPROM_drv::EEPROM_sendData(EEPROM_ADDR); // good address
+    phase_check(EEPROM_drv::EEPROM_switch(0x02), "EEPROM check"); // according to documentation, switches to i2c fmc lines
+    //EEPROM_drv::EEPROM_sendData(0x00); // wrong address
+    phase_check(EEPROM_drv::EEPROM_sendData(EEPROM_ADDR), "EEPROM check"); // good address
+
+    checkpoint_phase_done(&ckpt, PHASE_EEPROM);
+  }
 
   // ======================================================
   //          Si571 configuration (clock generation)
   // ======================================================
-  // Set Si571 to f_out = 250MHz
-  // data generated with Si570 software (from Si www)
-  // part number:
-  // 571
-  // AJC000337G, rev. D
-  // parameters:
-  // OE - active high, 3.3V, LVPECL
-  // 10-280MHz freq. range
-  // startup freq:  155.49MHz (previously 155.52 MHz)
-  // I2C addr: 0x49
-  // Startup registers values:
-  // reg 7 = 0x01      // 0000 0001 -> HS = 000 -> HS = 4d
-  // reg 8 = 0xC2      // 1100 0010 -> N1 = 000 0111 -> N1 = 8d
-  // reg 9 = 0xB8      // 1011 1000
-  // reg 10 = 0xBB     // 1011 1011
-  // reg 11 = 0xE4     // 1110 0100
-  // reg 12 = 0x72     // 0111 0010
-  // are those default values correct?
-
-  // fDCO_current = 4.97568 GHz (previously 4.97664 GHz)
-  // RFreq = 00 0010 1011 1000 1011 1011 1110 0100 0111 0010 = 11689256050d
-  // RFreq = 11689256050d / 2^28 = 43.545872159
-  // fxtal = 114.262954 MHz ( previously 114.285 MHz )
-
-  cout << "============================================" << endl <<
-      "   Si571 configuration (clock generation)   " << endl <<
-      "============================================" << endl;
-
-  data.extra[0] = SI571_ADDR;
-  data.extra[1] = 6;
-  //data.data_send[0] = 0x07; // starting register
-  data.data_send.clear();
-  data.data_read.clear();
-
-  Si570_drv::si570_setCommLink(_commLink, SI571_I2C_DRV, GENERAL_GPIO_DRV);
-
-  // NO Si570!!
-  Si570_drv::si570_outputDisable(FPGA_CTRL_REGS | WB_CLK_CTRL);
+  if (checkpoint_phase_run(&ckpt, PHASE_SI570)) {
+    // Set Si571 to f_out = 250MHz
+    // data generated with Si570 software (from Si www)
+    // part number:
+    // 571
+    // AJC000337G, rev. D
+    // parameters:
+    // OE - active high, 3.3V, LVPECL
+    // 10-280MHz freq. range
+    // startup freq:  155.49MHz (previously 155.52 MHz)
+    // I2C addr: 0x49
+    // Startup registers values:
+    // reg 7 = 0x01      // 0000 0001 -> HS = 000 -> HS = 4d
+    // reg 8 = 0xC2      // 1100 0010 -> N1 = 000 0111 -> N1 = 8d
+    // reg 9 = 0xB8      // 1011 1000
+    // reg 10 = 0xBB     // 1011 1011
+    // reg 11 = 0xE4     // 1110 0100
+    // reg 12 = 0x72     // 0111 0010
+    // are those default values correct?
+
+    // fDCO_current = 4.97568 GHz (previously 4.97664 GHz)
+    // RFreq = 00 0010 1011 1000 1011 1011 1110 0100 0111 0010 = 11689256050d
+    // RFreq = 11689256050d / 2^28 = 43.545872159
+    // fxtal = 114.262954 MHz ( previously 114.285 MHz )
+
+    cout << "============================================" << endl <<
+        "   Si571 configuration (clock generation)   " << endl <<
+        "============================================" << endl;
+
+    data.extra[0] = SI571_ADDR;
+    data.extra[1] = 6;
+    //data.data_send[0] = 0x07; // starting register
+    data.data_send.clear();
+    data.data_read.clear();
+
+    // NO Si570!!
+    phase_check(Si570_drv::si570_outputDisable(FPGA_CTRL_REGS | WB_CLK_CTRL), "Si571 configuration");
+
+    checkpoint_phase_done(&ckpt, PHASE_SI570);
+  }
 
   // ======================================================
   //      AD9510 configuration (clock distribution)
   // ======================================================
-  cout << "============================================" << endl <<
-      "     AD9510 config (clock distribution)     " << endl <<
-      "============================================" << endl;
+  if (checkpoint_phase_run(&ckpt, PHASE_AD9510)) {
+    cout << "============================================" << endl <<
+        "     AD9510 config (clock distribution)     " << endl <<
+        "============================================" << endl;
 
-  // reset chip
-  data.wb_addr = FPGA_CTRL_REGS | WB_CLK_CTRL; // clock control
-  _commLink->fmc_config_read(&data);
+    // reset chip (function pin low), then turn off reset
+    struct gpio_field ad9510_func = { FPGA_CTRL_REGS | WB_CLK_CTRL, WB_CLK_CTRL_AD9510_FUNC };
 
-  data.wb_addr = FPGA_CTRL_REGS | WB_CLK_CTRL;
-  data_temp = data.data_read[0] | 0x02; // pull high
-  data.data_send[0] = data_temp;
-  _commLink->fmc_config_send(&data);
-  sleep(1);
+    phase_check(gpio->gpio_set(ad9510_func, 1), "AD9510 configuration"); // pull high
+    sleep(1);
+    phase_check(gpio->gpio_pulse(ad9510_func, 0, 1, 1000000), "AD9510 configuration"); // pull low, pull high
+    sleep(1);
 
-  data_temp = data.data_read[0] & 0xFFFFFFFD; // pull low
-  data.data_send[0] = data_temp;
-  _commLink->fmc_config_send(&data);
-  sleep(1);
+    // FPGA working with clock copy for ADC (FMC ADC 130M 4CH rev.1)
+    phase_check(AD9510_drv::AD9510_config_si570_fmc_adc_130m_4ch(AD9510_ADDR), "AD9510 configuration"); // with config check included
+    //AD9510_drv::AD9510_config_si570_pll_fmc_adc_130m_4ch(AD9510_ADDR); // with config check included
 
-  // turn off reset
-  data.wb_addr = FPGA_CTRL_REGS | WB_CLK_CTRL;
-  data_temp = data.data_read[0] | 0x02; // pull high
-  data.data_send[0] = data_temp;
-  _commLink->fmc_config_send(&data);
-  sleep(1);
+    // Check PLL lock
 
-  AD9510_drv::AD9510_setCommLink(_commLink, AD9510_SPI_DRV);
-
-  // FPGA working with clock copy for ADC (FMC ADC 130M 4CH rev.1)
-  AD9510_drv::AD9510_config_si570_fmc_adc_130m_4ch(AD9510_ADDR); // with config check included
-  //AD9510_drv::AD9510_config_si570_pll_fmc_adc_130m_4ch(AD9510_ADDR); // with config check included
+    data.wb_addr = FPGA_CTRL_REGS | WB_CLK_CTRL; // clock control
+    phase_check(fmc_config_read_check(_commLink, &data), "AD9510 configuration");
 
-  // Check PLL lock
+    //#define PLL_LOCK
+    //
+    //if (data.data_read[0] & PLL_LOCK)
 
-  data.wb_addr = FPGA_CTRL_REGS | WB_CLK_CTRL; // clock control
-  _commLink->fmc_config_read(&data);
+    printf("Clock PLL Lock: %d\n", data.data_read[0]);
 
-  //#define PLL_LOCK
-  //
-  //if (data.data_read[0] & PLL_LOCK)
+    //exit(1);
 
-  printf("Clock PLL Lock: %d\n", data.data_read[0]);
-
-  //exit(1);
+    checkpoint_phase_done(&ckpt, PHASE_AD9510);
+  }
 
   // ======================================================
   //                  LTC ADC configuration
   // ======================================================
-  cout << "============================================" << endl <<
-      "     LTC2208 config (4 ADC chips)     " << endl <<
-      "============================================" << endl;
+  if (checkpoint_phase_run(&ckpt, PHASE_ADC)) {
+    cout << "============================================" << endl <<
+        "     LTC2208 config (4 ADC chips)     " << endl <<
+        "============================================" << endl;
 
-  data.wb_addr = FPGA_CTRL_REGS | WB_ADC_LTC_CTRL; // trigger control
-  //data.data_send[0] = 0x02; // dither on, power on, random off, pga off (input 2.25 Vpp)
-  data.data_send[0] = 0x00; // dither off, power on, random off, pga off (input 2.25 Vpp)
-  _commLink->fmc_config_send(&data);
+    data.wb_addr = FPGA_CTRL_REGS | WB_ADC_LTC_CTRL; // trigger control
+    //data.data_send[0] = 0x02; // dither on, power on, random off, pga off (input 2.25 Vpp)
+    data.data_send[0] = 0x00; // dither off, power on, random off, pga off (input 2.25 Vpp)
+    phase_check(_commLink->fmc_config_send(&data), "ADC configuration");
+
+    checkpoint_phase_done(&ckpt, PHASE_ADC);
+  }
 
   // ======================================================
   //            Clock and data lines calibration
   // ======================================================
-  cout << "============================================" << endl <<
-      "      Clock and data lines calibration     " << endl <<
-      "============================================" << endl;
+  if (checkpoint_phase_run(&ckpt, PHASE_IDELAY)) {
+    cout << "============================================" << endl <<
+        "      Clock and data lines calibration     " << endl <<
+        "============================================" << endl;
+
+    // Calibration
+    // reset IDELAYCTRLs in FPGA
+    struct gpio_field idelayctrl_rst = { FPGA_CTRL_REGS | WB_FPGA_CTRL, WB_FPGA_CTRL_IDELAYCTRL_RST };
+
+    phase_check(gpio->gpio_pulse(idelayctrl_rst, 1, 0, 1000000), "IDELAY calibration");
+    data.wb_addr = FPGA_CTRL_REGS | WB_FPGA_CTRL;
+
+    // check if ready
+    phase_check(fmc_config_read_check(_commLink, &data), "IDELAY calibration");
+    printf("data: %08x\n", data.data_read[0]);
+
+    if ( (data.data_read[0] >> 2) & 0x0F ) // check adc0 adc1 adc2 adc3 idelayctrl
+      cout << "All IDELAY controllers had been reset and are ready to work!" << endl;
+    else {
+      cout << "Error while resetting IDELAY controllers, some of them are not ready!" << endl;
+      exit(1);
+    }
 
-  // Calibration
-  // reset IDELAYCTRLs in FPGA
-  data.wb_addr = FPGA_CTRL_REGS | WB_FPGA_CTRL;
-  data.data_send[0] = 0x01;
-  _commLink->fmc_config_send(&data);
-  sleep(1);
-  data.data_send[0] = 0x00;
-  _commLink->fmc_config_send(&data);
-
-  // check if ready
-  _commLink->fmc_config_read(&data);
-  printf("data: %08x\n", data.data_read[0]);
-
-  if ( (data.data_read[0] >> 2) & 0x0F ) // check adc0 adc1 adc2 adc3 idelayctrl
-    cout << "All IDELAY controllers had been reset and are ready to work!" << endl;
-  else {
-    cout << "Error while resetting IDELAY controllers, some of them are not ready!" << endl;
-    exit(1);
-  }
+    cout << "IDELAY lines calibration" << endl;
+
+    // upload new tap value (130m)
+    // for fmc adc 130m
+    // adc0
+    // adc1
+    // adc2
+    // adc3
+    // tap resolution 78ps
+
+    phase_check(set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY0_CAL, &delay_data_l[0], DLY_DATA), "IDELAY calibration");
+
+    //data.wb_addr = FPGA_CTRL_REGS | WB_IDELAY0_CAL;
+    //data.data_send[0] = IDELAY_ALL_LINES | IDELAY_TAP(07) | IDELAY_UPDATE;
+    //_commLink->fmc_config_send(&data);
+    //usleep(1000);
+    //data.data_send[0] = (IDELAY_ALL_LINES | IDELAY_TAP(07)) & 0xFFFFFFFE;
+    //_commLink->fmc_config_send(&data);
+
+    phase_check(set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY1_CAL, &delay_data_l[1], DLY_DATA), "IDELAY calibration");
 
-  cout << "IDELAY lines calibration" << endl;
-
-  // upload new tap value (130m)
-  // for fmc adc 130m
-  // adc0
-  // adc1
-  // adc2
-  // adc3
-  // tap resolution 78ps
-
-  set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY0_CAL, &delay_data_l[0], DLY_DATA);
-
-  //data.wb_addr = FPGA_CTRL_REGS | WB_IDELAY0_CAL;
-  //data.data_send[0] = IDELAY_ALL_LINES | IDELAY_TAP(07) | IDELAY_UPDATE;
-  //_commLink->fmc_config_send(&data);
-  //usleep(1000);
-  //data.data_send[0] = (IDELAY_ALL_LINES | IDELAY_TAP(07)) & 0xFFFFFFFE;
-  //_commLink->fmc_config_send(&data);
-
-  set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY1_CAL, &delay_data_l[1], DLY_DATA);
-
-  //data.wb_addr = FPGA_CTRL_REGS | WB_IDELAY1_CAL;
-  //data.data_send[0] = IDELAY_ALL_LINES | IDELAY_TAP(07) | IDELAY_UPDATE;
-  //_commLink->fmc_config_send(&data);
-  //usleep(1000);
-  //data.data_send[0] = (IDELAY_ALL_LINES | IDELAY_TAP(07)) & 0xFFFFFFFE;
-  //_commLink->fmc_config_send(&data);
-
-  set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY2_CAL, &delay_data_l[2], DLY_DATA);
-
-  //data.wb_addr = FPGA_CTRL_REGS | WB_IDELAY2_CAL;
-  //data.data_send[0] = IDELAY_ALL_LINES | IDELAY_TAP(07) | IDELAY_UPDATE;
-  //_commLink->fmc_config_send(&data);
-  //usleep(1000);
-  //data.data_send[0] = (IDELAY_ALL_LINES | IDELAY_TAP(07)) & 0xFFFFFFFE;
-  //_commLink->fmc_config_send(&data);
-
-  set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY3_CAL, &delay_data_l[3], DLY_DATA);
-
-  //data.wb_addr = FPGA_CTRL_REGS | WB_IDELAY3_CAL;
-  //data.data_send[0] = IDELAY_ALL_LINES | IDELAY_TAP(07) | IDELAY_UPDATE;
-  //_commLink->fmc_config_send(&data);
-  //usleep(1000);
-  //data.data_send[0] = (IDELAY_ALL_LINES | IDELAY_TAP(07)) & 0xFFFFFFFE;
-  //_commLink->fmc_config_send(&data);
-
-  // train communication links
+    //data.wb_addr = FPGA_CTRL_REGS | WB_IDELAY1_CAL;
+    //data.data_send[0] = IDELAY_ALL_LINES | IDELAY_TAP(07) | IDELAY_UPDATE;
+    //_commLink->fmc_config_send(&data);
+    //usleep(1000);
+    //data.data_send[0] = (IDELAY_ALL_LINES | IDELAY_TAP(07)) & 0xFFFFFFFE;
+    //_commLink->fmc_config_send(&data);
+
+    phase_check(set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY2_CAL, &delay_data_l[2], DLY_DATA), "IDELAY calibration");
+
+    //data.wb_addr = FPGA_CTRL_REGS | WB_IDELAY2_CAL;
+    //data.data_send[0] = IDELAY_ALL_LINES | IDELAY_TAP(07) | IDELAY_UPDATE;
+    //_commLink->fmc_config_send(&data);
+    //usleep(1000);
+    //data.data_send[0] = (IDELAY_ALL_LINES | IDELAY_TAP(07)) & 0xFFFFFFFE;
+    //_commLink->fmc_config_send(&data);
+
+    phase_check(set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY3_CAL, &delay_data_l[3], DLY_DATA), "IDELAY calibration");
+
+    //data.wb_addr = FPGA_CTRL_REGS | WB_IDELAY3_CAL;
+    //data.data_send[0] = IDELAY_ALL_LINES | IDELAY_TAP(07) | IDELAY_UPDATE;
+    //_commLink->fmc_config_send(&data);
+    //usleep(1000);
+    //data.data_send[0] = (IDELAY_ALL_LINES | IDELAY_TAP(07)) & 0xFFFFFFFE;
+    //_commLink->fmc_config_send(&data);
+
+    // train communication links
+
+    checkpoint_set_idelay(&ckpt, delay_data_l, delay_clk_l);
+    checkpoint_phase_done(&ckpt, PHASE_IDELAY);
+  }
 
   cout << "All done! All components on the FMC card had been configured and tested!" << endl <<
       "FMC card is ready to work!" << endl;
@@ -17,6 +17,7 @@
 
 #include <iostream>
 #include <unistd.h> /* getopt */
+#include <getopt.h>  /* getopt_long */
 
 #include "config.h"
 #include "plat_opts.h"
@@ -33,6 +34,7 @@
 #include "chip/eeprom_24a64.h"
 #include "chip/lm75a.h"
 #include "platform/fmc130m_plat.h"
+#include "checkpoint.h"
 
 using namespace std;
 
@@ -42,22 +44,24 @@ int main(int argc, const char **argv) {
                   "Author: Andrzej Wojenski" << endl;
 
   WBInt_drv* int_drv;
+  gpio_int* gpio;
   wb_data data;
   vector<uint16_t> amc_temp;
   vector<uint16_t> test_pattern;
   commLink* _commLink = new commLink();
-  uint32_t data_temp;
   int opt, error;
+  struct checkpoint_t ckpt;
 
    /* Default command-line arguments */
   program = argv[0];
   quiet = 0;
   verbose = 0;
+  resume = 0;
   error = 0;
   platform = PLATFORM_NOT_SET;
 
   /* Process the command-line arguments */
-  while ((opt = getopt(argc, (char **)argv, "p:vqh")) != -1) {
+  while ((opt = getopt_long(argc, (char **)argv, SHORT_OPTIONS, long_options, NULL)) != -1) {
     switch (opt) {
     case 'p':
       if (strlen(optarg) > MAX_PLATFORM_SIZE_ID) {
@@ -92,6 +96,15 @@ int main(int argc, const char **argv) {
     case 'q':
       quiet = 1;
       break;
+    case 'r':
+      resume = 1;
+      break;
+    case 'e':
+    case 'c':
+    case 'w':
+      // common options of FMC ADC 250M programs
+      fprintf(stderr, "%s: option -%c is supported by FMC ADC 250M programs only\n", program, opt);
+      return 1;
     case 'h':
       help();
       return 1;
@@ -120,7 +133,7 @@ int main(int argc, const char **argv) {
 
   // CommLink configuration
   // Adding communication interfaces
-  _commLink->regWBMaster(new rs232_syscon_driver());
+  _commLink->regWBMaster(new rs232_syscon_driver(RS232_PORT, FPGA_CTRL_REGS | WB_FMC_STATUS));
 
   int_drv = _commLink->regIntDrv(SI571_I2C_DRV, FPGA_SI571_I2C, new i2c_int());
   ((i2c_int*)int_drv)->i2c_init(FPGA_SYS_FREQ, 100000); // 100kHz
@@ -135,7 +148,10 @@ int main(int argc, const char **argv) {
   int_drv = _commLink->regIntDrv(LM75A_I2C_DRV, FPGA_LM75A_I2C, new i2c_int());
   ((i2c_int*)int_drv)->i2c_init(FPGA_SYS_FREQ, 400000); // 400kHz
 
-  _commLink->regIntDrv(GENERAL_GPIO_DRV, FPGA_CTRL_REGS, new gpio_int());
+  gpio = (gpio_int*)_commLink->regIntDrv(GENERAL_GPIO_DRV, FPGA_CTRL_REGS, new gpio_int());
+
+  // Chip drivers
+  EEPROM_drv::EEPROM_setCommLink(_commLink, EEPROM_I2C_DRV);
 
   // ======================================================
   //                Firmware identification
@@ -147,7 +163,7 @@ int main(int argc, const char **argv) {
   data.wb_addr = FPGA_CTRL_REGS | WB_FMC_STATUS; // FMC status register (HW address)
 
   // check id data
-  _commLink->fmc_config_read(&data);
+  phase_check(fmc_config_read_check(_commLink, &data), "Firmware identification");
 
   cout << "Reg: " << hex << (data.data_read[0]) << endl;
   cout << "Firmware ID: " << hex << (data.data_read[0] >> 3) <<
@@ -156,226 +172,254 @@ int main(int argc, const char **argv) {
   // Check communication
   assert(0x01332A11 == (data.data_read[0] >> 3) );
 
+  // Finished phases are kept in state file, --resume skips them
+  checkpoint_init(&ckpt, program, RS232_PORT, data.data_read[0] >> 3, resume);
+
   // ======================================================
   //                  LEDs configuration
   // ======================================================
-  cout << "============================================" << endl <<
-          "            LEDs configuration              " << endl <<
-          "============================================" << endl;
+  if (checkpoint_phase_run(&ckpt, PHASE_LEDS)) {
+    cout << "============================================" << endl <<
+            "            LEDs configuration              " << endl <<
+            "============================================" << endl;
 
-  data.wb_addr = FPGA_CTRL_REGS | WB_MONITOR_CTRL; // monitor register (HW address)
+    // LEDs field of monitor register (HW address), one LED after another, then all
+    struct gpio_field leds = { FPGA_CTRL_REGS | WB_MONITOR_CTRL, WB_MONITOR_CTRL_LEDS };
+    uint32_t leds_val;
 
-  data.data_send[0] = 0x02;
-  _commLink->fmc_config_send(&data);
-  //sleep(4);
+    phase_check(gpio->gpio_set(leds, 0x1), "LEDs configuration");
+    //sleep(4);
 
-  data.data_send[0] = 0x04;
-  _commLink->fmc_config_send(&data);
-  //sleep(4);
+    phase_check(gpio->gpio_set(leds, 0x2), "LEDs configuration");
+    //sleep(4);
 
-  data.data_send[0] = 0x08;
-  _commLink->fmc_config_send(&data);
-  //sleep(4);
+    phase_check(gpio->gpio_set(leds, 0x4), "LEDs configuration");
+    //sleep(4);
 
-  // Check if data properly written
-  _commLink->fmc_config_read(&data);
-  assert( (data.data_read[0] & 0x0E) == 0x08); // ignore TEMP_ALARM pin
+    // Check if data properly written
+    phase_check(gpio->gpio_get(leds, &leds_val), "LEDs configuration");
+    assert(leds_val == 0x4); // TEMP_ALARM pin not in field
 
-  data.data_send[0] = 0x0E;
-  _commLink->fmc_config_send(&data);
-  //sleep(4);
+    phase_check(gpio->gpio_set(leds, 0x7), "LEDs configuration");
+    //sleep(4);
 
-  // Set status config (blue LED)
-  data.data_send[0] = 0x02;
-  _commLink->fmc_config_send(&data);
+    // Set status config (blue LED)
+    phase_check(gpio->gpio_set(leds, 0x1), "LEDs configuration");
 
-  // for trigger test
-  //data.data_send[0] = 0x00;
-  //_commLink->fmc_config_send(&data);
+    // for trigger test
+    //gpio->gpio_set(leds, 0x0);
+
+    checkpoint_phase_done(&ckpt, PHASE_LEDS);
+  }
 
   // ======================================================
   //                  Trigger configuration
   // ======================================================
-  cout << "============================================" << endl <<
-          "            Trigger configuration           " << endl <<
-          "============================================" << endl;
+  if (checkpoint_phase_run(&ckpt, PHASE_TRIGGER)) {
+    cout << "============================================" << endl <<
+            "            Trigger configuration           " << endl <<
+            "============================================" << endl;
+
+    data.wb_addr = FPGA_CTRL_REGS | WB_TRG_CTRL; // trigger control
+    data.data_send[0] = 0x01;
+    phase_check(_commLink->fmc_config_send(&data), "Trigger configuration");
 
-  data.wb_addr = FPGA_CTRL_REGS | WB_TRG_CTRL; // trigger control
-  data.data_send[0] = 0x01;
-  _commLink->fmc_config_send(&data);
+    checkpoint_phase_done(&ckpt, PHASE_TRIGGER);
+  }
 
   // ======================================================
   //        LM75A configuration (temperature monitor)
   // ======================================================
-  cout << "============================================" << endl <<
-          "             LM75A check data    " << endl <<
-          "============================================" << endl;
-  // lm75 i2c have timeout
-
-  // Why is it not working?????
-  //LM75A_drv::LM75A_setCommLink(_commLink, LM75A_I2C_DRV);
-  //printf("LM75A chip number 1, chip ID: 0x%02x (should be 0xA1)\n", LM75A_drv::LM75A_readID(LM75A_ADDR_1));
-  //printf("LM75A chip number 1, temperature: %f *C\n", LM75A_drv::LM75A_readTemp(LM75A_ADDR_1));
-  //printf("LM75A chip number 2, chip ID: 0x%02x (should be 0xA1)\n", LM75A_drv::LM75A_readID(LM75A_ADDR_2));
-  //printf("LM75A chip number 2, temperature: %f *C\n", LM75A_drv::LM75A_readTemp(LM75A_ADDR_2));
+  if (checkpoint_phase_run(&ckpt, PHASE_LM75A)) {
+    cout << "============================================" << endl <<
+            "             LM75A check data    " << endl <<
+            "============================================" << endl;
+    // lm75 i2c have timeout
+
+    // Why is it not working?????
+    //LM75A_drv::LM75A_setCommLink(_commLink, LM75A_I2C_DRV);
+    //printf("LM75A chip number 1, chip ID: 0x%02x (should be 0xA1)\n", LM75A_drv::LM75A_readID(LM75A_ADDR_1));
+    //printf("LM75A chip number 1, temperature: %f *C\n", LM75A_drv::LM75A_readTemp(LM75A_ADDR_1));
+    //printf("LM75A chip number 2, chip ID: 0x%02x (should be 0xA1)\n", LM75A_drv::LM75A_readID(LM75A_ADDR_2));
+    //printf("LM75A chip number 2, temperature: %f *C\n", LM75A_drv::LM75A_readTemp(LM75A_ADDR_2));
+
+    checkpoint_phase_done(&ckpt, PHASE_LM75A);
+  }
 
   // ======================================================
   //                  EEPROM configuration
   // ======================================================
-  cout << "============================================" << endl <<
-          "              EEPROM check    " << endl <<
-          "============================================" << endl;
+  if (checkpoint_phase_run(&ckpt, PHASE_EEPROM)) {
+    cout << "============================================" << endl <<
+            "              EEPROM check    " << endl <<
+            "============================================" << endl;
 
-  EEPROM_drv::EEPROM_setCommLink(_commLink, EEPROM_I2C_DRV);
-  EEPROM_drv::EEPROM_switch(0x02); // according to documentation, switches to i2c fmc lines
-  //EEPROM_drv::EEPROM_sendData(0x00); // wrong address
-  EEPROM_drv::EEPROM_sendData(EEPROM_ADDR); // good address
+    phase_check(EEPROM_drv::EEPROM_switch(0x02), "EEPROM check"); // according to documentation, switches to i2c fmc lines
+    //EEPROM_drv::EEPROM_sendData(0x00); // wrong address
+    phase_check(EEPROM_drv::EEPROM_sendData(EEPROM_ADDR), "EEPROM check"); // good address
+
+    checkpoint_phase_done(&ckpt, PHASE_EEPROM);
+  }
 
   // ======================================================
   //                  LTC ADC configuration
   // ======================================================
-  cout << "============================================" << endl <<
-          "     LTC2208 config (4 ADC chips)     " << endl <<
-          "============================================" << endl;
+  if (checkpoint_phase_run(&ckpt, PHASE_ADC)) {
+    cout << "============================================" << endl <<
+            "     LTC2208 config (4 ADC chips)     " << endl <<
+            "============================================" << endl;
 
-  data.wb_addr = FPGA_CTRL_REGS | WB_ADC_LTC_CTRL; // trigger control
-  //data.data_send[0] = 0x02; // dither on, power on, random off, pga off (input 2.25 Vpp)
-  data.data_send[0] = 0x00; // dither off, power on, random off, pga off (input 2.25 Vpp)
-  _commLink->fmc_config_send(&data);
+    data.wb_addr = FPGA_CTRL_REGS | WB_ADC_LTC_CTRL; // trigger control
+    //data.data_send[0] = 0x02; // dither on, power on, random off, pga off (input 2.25 Vpp)
+    data.data_send[0] = 0x00; // dither off, power on, random off, pga off (input 2.25 Vpp)
+    phase_check(_commLink->fmc_config_send(&data), "ADC configuration");
+
+    checkpoint_phase_done(&ckpt, PHASE_ADC);
+  }
 
   // ======================================================
   //            Clock and data lines calibration
   // ======================================================
-  cout << "============================================" << endl <<
-          "      Clock and data lines calibration     " << endl <<
-          "============================================" << endl;
+  if (checkpoint_phase_run(&ckpt, PHASE_IDELAY)) {
+    cout << "============================================" << endl <<
+            "      Clock and data lines calibration     " << endl <<
+            "============================================" << endl;
+
+    // Calibration
+    // reset IDELAYCTRLs in FPGA
+    struct gpio_field idelayctrl_rst = { FPGA_CTRL_REGS | WB_FPGA_CTRL, WB_FPGA_CTRL_IDELAYCTRL_RST };
+
+    phase_check(gpio->gpio_pulse(idelayctrl_rst, 1, 0, 1000000), "IDELAY calibration");
+    data.wb_addr = FPGA_CTRL_REGS | WB_FPGA_CTRL;
+
+    // check if ready
+    phase_check(fmc_config_read_check(_commLink, &data), "IDELAY calibration");
+    printf("data: %08x\n", data.data_read[0]);
+
+    if ( (data.data_read[0] >> 2) & 0x0F ) // check adc0 adc1 adc2 adc3 idelayctrl
+            cout << "All IDELAY controllers had been reset and are ready to work!" << endl;
+    else {
+            cout << "Error while resetting IDELAY controllers, some of them are not ready!" << endl;
+            exit(1);
+    }
 
-  // Calibration
-  // reset IDELAYCTRLs in FPGA
-  data.wb_addr = FPGA_CTRL_REGS | WB_FPGA_CTRL;
-  data.data_send[0] = 0x01;
-  _commLink->fmc_config_send(&data);
-  sleep(1);
-  data.data_send[0] = 0x00;
-  _commLink->fmc_config_send(&data);
-
-  // check if ready
-  _commLink->fmc_config_read(&data);
-  printf("data: %08x\n", data.data_read[0]);
-
-  if ( (data.data_read[0] >> 2) & 0x0F ) // check adc0 adc1 adc2 adc3 idelayctrl
-          cout << "All IDELAY controllers had been reset and are ready to work!" << endl;
-  else {
-          cout << "Error while resetting IDELAY controllers, some of them are not ready!" << endl;
-          exit(1);
-  }
+    cout << "IDELAY lines calibration" << endl;
 
-  cout << "IDELAY lines calibration" << endl;
+    // upload new tap value (130m)
+    // for fmc adc 130m
+    // adc0
+    // adc1
+    // adc2
+    // adc3
+    // tap resolution 78ps
 
-  // upload new tap value (130m)
-  // for fmc adc 130m
-  // adc0
-  // adc1
-  // adc2
-  // adc3
-  // tap resolution 78ps
+    phase_check(set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY0_CAL, &delay_data_l[0], DLY_DATA), "IDELAY calibration");
+    phase_check(set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY1_CAL, &delay_data_l[1], DLY_DATA), "IDELAY calibration");
+    phase_check(set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY2_CAL, &delay_data_l[2], DLY_DATA), "IDELAY calibration");
+    phase_check(set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY3_CAL, &delay_data_l[3], DLY_DATA), "IDELAY calibration");
 
-  set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY0_CAL, &delay_data_l[0], DLY_DATA);
-  set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY1_CAL, &delay_data_l[1], DLY_DATA);
-  set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY2_CAL, &delay_data_l[2], DLY_DATA);
-  set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY3_CAL, &delay_data_l[3], DLY_DATA);
+    phase_check(set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY0_CAL, &delay_clk_l[0], DLY_CLK), "IDELAY calibration");
+    phase_check(set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY1_CAL, &delay_clk_l[1], DLY_CLK), "IDELAY calibration");
+    phase_check(set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY2_CAL, &delay_clk_l[2], DLY_CLK), "IDELAY calibration");
+    phase_check(set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY3_CAL, &delay_clk_l[3], DLY_CLK), "IDELAY calibration");
 
-  set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY0_CAL, &delay_clk_l[0], DLY_CLK);
-  set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY1_CAL, &delay_clk_l[1], DLY_CLK);
-  set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY2_CAL, &delay_clk_l[2], DLY_CLK);
-  set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY3_CAL, &delay_clk_l[3], DLY_CLK);
+    // train communication links
 
-  // train communication links
+    checkpoint_set_idelay(&ckpt, delay_data_l, delay_clk_l);
+    checkpoint_phase_done(&ckpt, PHASE_IDELAY);
+  }
 
   // ======================================================
   //                BPM Swap configuration
   // ======================================================
-  cout << "============================================" << endl <<
-          "           BPM Swap configuration           " << endl <<
-          "============================================" << endl;
-
-  // BPM Swap parameters
-  data.wb_addr = DSP_BPM_SWAP | BPM_SWAP_REG_A;
-  data.data_send[0] = 32768 | 32768 << 16; // no gain for AA and AC
-  _commLink->fmc_config_send(&data);
-
-  data.wb_addr = DSP_BPM_SWAP | BPM_SWAP_REG_B;
-  data.data_send[0] = 32768 | 32768 << 16; // no gain for BB and BD
-  _commLink->fmc_config_send(&data);
-
-  data.wb_addr = DSP_BPM_SWAP | BPM_SWAP_REG_C;
-  data.data_send[0] = 32768 | 32768 << 16; // no gain for CC and CA
-  _commLink->fmc_config_send(&data);
-
-  data.wb_addr = DSP_BPM_SWAP | BPM_SWAP_REG_D;
-  data.data_send[0] = 32768 | 32768 << 16; // no gain for DD and DB
-  _commLink->fmc_config_send(&data);
-
-  // Switching mode
-  data.wb_addr = DSP_BPM_SWAP | BPM_SWAP_REG_CTRL;
-  data.data_send[0] = 0x1 << 1 | 0x1 << 3; // Direct mode for both sets of channels
-  _commLink->fmc_config_send(&data);
+  if (checkpoint_phase_run(&ckpt, PHASE_BPM_SWAP)) {
+    cout << "============================================" << endl <<
+            "           BPM Swap configuration           " << endl <<
+            "============================================" << endl;
+
+    // BPM Swap parameters
+    data.wb_addr = DSP_BPM_SWAP | BPM_SWAP_REG_A;
+    data.data_send[0] = 32768 | 32768 << 16; // no gain for AA and AC
+    phase_check(_commLink->fmc_config_send(&data), "BPM Swap configuration");
+
+    data.wb_addr = DSP_BPM_SWAP | BPM_SWAP_REG_B;
+    data.data_send[0] = 32768 | 32768 << 16; // no gain for BB and BD
+    phase_check(_commLink->fmc_config_send(&data), "BPM Swap configuration");
+
+    data.wb_addr = DSP_BPM_SWAP | BPM_SWAP_REG_C;
+    data.data_send[0] = 32768 | 32768 << 16; // no gain for CC and CA
+    phase_check(_commLink->fmc_config_send(&data), "BPM Swap configuration");
+
+    data.wb_addr = DSP_BPM_SWAP | BPM_SWAP_REG_D;
+    data.data_send[0] = 32768 | 32768 << 16; // no gain for DD and DB
+    phase_check(_commLink->fmc_config_send(&data), "BPM Swap configuration");
+
+    // Switching mode
+    data.wb_addr = DSP_BPM_SWAP | BPM_SWAP_REG_CTRL;
+    data.data_send[0] = 0x1 << 1 | 0x1 << 3; // Direct mode for both sets of channels
+    phase_check(_commLink->fmc_config_send(&data), "BPM Swap configuration");
+
+    checkpoint_phase_done(&ckpt, PHASE_BPM_SWAP);
+  }
 
   // ======================================================
   //                DSP configuration
   // ======================================================
-  cout << "============================================" << endl <<
-          "            DSP configuration         " << endl <<
-          "============================================" << endl;
+  if (checkpoint_phase_run(&ckpt, PHASE_DSP)) {
+    cout << "============================================" << endl <<
+            "            DSP configuration         " << endl <<
+            "============================================" << endl;
 
-  //// DSP parameters
-  data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_DS_TBT_THRES;
-  data.data_send[0] = 0x0200;  // 1.2207e-04 FIX26_22
-  _commLink->fmc_config_send(&data);
+    //// DSP parameters
+    data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_DS_TBT_THRES;
+    data.data_send[0] = 0x0200;  // 1.2207e-04 FIX26_22
+    phase_check(_commLink->fmc_config_send(&data), "DSP configuration");
 
-  data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_DS_FOFB_THRES;
-  data.data_send[0] = 0x0200;  // 1.2207e-04 FIX26_22
-  _commLink->fmc_config_send(&data);
+    data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_DS_FOFB_THRES;
+    data.data_send[0] = 0x0200;  // 1.2207e-04 FIX26_22
+    phase_check(_commLink->fmc_config_send(&data), "DSP configuration");
 
-  data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_DS_MONIT_THRES;
-  data.data_send[0] = 0x0200;  // 1.2207e-04 FIX26_22
-  _commLink->fmc_config_send(&data);
+    data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_DS_MONIT_THRES;
+    data.data_send[0] = 0x0200;  // 1.2207e-04 FIX26_22
+    phase_check(_commLink->fmc_config_send(&data), "DSP configuration");
 
-  data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_KX;
-  data.data_send[0] = 8388608;  // 10000000 UFIX25_0
-  _commLink->fmc_config_send(&data);
+    data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_KX;
+    data.data_send[0] = 8388608;  // 10000000 UFIX25_0
+    phase_check(_commLink->fmc_config_send(&data), "DSP configuration");
 
-  data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_KY;
-  data.data_send[0] = 8388608;  // 10000000 UFIX25_0
-  _commLink->fmc_config_send(&data);
+    data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_KY;
+    data.data_send[0] = 8388608;  // 10000000 UFIX25_0
+    phase_check(_commLink->fmc_config_send(&data), "DSP configuration");
 
-  data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_KSUM;
-  data.data_send[0] = 0x0FFFFFF;  // 1.0 FIX25_24
-  _commLink->fmc_config_send(&data);
+    data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_KSUM;
+    data.data_send[0] = 0x0FFFFFF;  // 1.0 FIX25_24
+    phase_check(_commLink->fmc_config_send(&data), "DSP configuration");
 
-  // DDS config.
+    // DDS config.
 
-  data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_DDS_PINC_CH0;
-  data.data_send[0] = 245366784;  // phase increment
-  _commLink->fmc_config_send(&data);
+    data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_DDS_PINC_CH0;
+    data.data_send[0] = 245366784;  // phase increment
+    phase_check(_commLink->fmc_config_send(&data), "DSP configuration");
 
-  data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_DDS_PINC_CH1;
-  data.data_send[0] = 245366784;  // phase increment
-  _commLink->fmc_config_send(&data);
+    data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_DDS_PINC_CH1;
+    data.data_send[0] = 245366784;  // phase increment
+    phase_check(_commLink->fmc_config_send(&data), "DSP configuration");
 
-  data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_DDS_PINC_CH2;
-  data.data_send[0] = 245366784;  // phase increment
-  _commLink->fmc_config_send(&data);
+    data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_DDS_PINC_CH2;
+    data.data_send[0] = 245366784;  // phase increment
+    phase_check(_commLink->fmc_config_send(&data), "DSP configuration");
 
-  data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_DDS_PINC_CH3;
-  data.data_send[0] = 245366784;  // phase increment
-  _commLink->fmc_config_send(&data);
+    data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_DDS_PINC_CH3;
+    data.data_send[0] = 245366784;  // phase increment
+    phase_check(_commLink->fmc_config_send(&data), "DSP configuration");
 
-  data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_DDS_CFG;
-  // toggle valid signal for all four DDS's
-  data.data_send[0] = (0x1) | (0x1 << 8) | (0x1 << 16) | (0x1 << 24);
-  _commLink->fmc_config_send(&data);
+    data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_DDS_CFG;
+    // toggle valid signal for all four DDS's
+    data.data_send[0] = (0x1) | (0x1 << 8) | (0x1 << 16) | (0x1 << 24);
+    phase_check(_commLink->fmc_config_send(&data), "DSP configuration");
 
+    checkpoint_phase_done(&ckpt, PHASE_DSP);
+  }
 
   cout << "All done! All components on the FMC card had been configured and tested!" << endl <<
                   "FMC card is ready to work!" << endl;
@@ -441,7 +485,7 @@ int main(int argc, const char **argv) {
 
   // TBT CH 01 ERROR
   data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_DSP_CTNR_TBT;
-  _commLink->fmc_config_read(&data);
+  phase_check(fmc_config_read_check(_commLink, &data), "Error counter read");
   cout << "TBT ch01 error count: " << POS_CALC_DSP_CTNR_TBT_CH01_R(data.data_read[0]);
   cout << endl;
   cout << "TBT ch23 error count: " << POS_CALC_DSP_CTNR_TBT_CH23_R(data.data_read[0]);
@@ -449,7 +493,7 @@ int main(int argc, const char **argv) {
 
   // FOFB CH 01 ERROR
   data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_DSP_CTNR_FOFB;
-  _commLink->fmc_config_read(&data);
+  phase_check(fmc_config_read_check(_commLink, &data), "Error counter read");
   cout << "FOFB ch01 error count: " << POS_CALC_DSP_CTNR_FOFB_CH01_R(data.data_read[0]);
   cout << endl;
   cout << "FOFB ch23 error count: " << POS_CALC_DSP_CTNR_FOFB_CH23_R(data.data_read[0]);
@@ -457,7 +501,7 @@ int main(int argc, const char **argv) {
 
   // Monit Part1 ERROR
   data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_DSP_CTNR1_MONIT;
-  _commLink->fmc_config_read(&data);
+  phase_check(fmc_config_read_check(_commLink, &data), "Error counter read");
   cout << "Monit CIC error count: " << POS_CALC_DSP_CTNR1_MONIT_CIC_R(data.data_read[0]);
   cout << endl;
   cout << "Monit CFIR error count: " << POS_CALC_DSP_CTNR1_MONIT_CFIR_R(data.data_read[0]);
@@ -465,7 +509,7 @@ int main(int argc, const char **argv) {
 
   // Monit Part2 ERROR
   data.wb_addr = DSP_CTRL_REGS | POS_CALC_REG_DSP_CTNR2_MONIT;
-  _commLink->fmc_config_read(&data);
+  phase_check(fmc_config_read_check(_commLink, &data), "Error counter read");
   cout << "Monit PFIR error count: " << POS_CALC_DSP_CTNR2_MONIT_PFIR_R(data.data_read[0]);
   cout << endl;
   cout << "Monit 0.1 error count: " << POS_CALC_DSP_CTNR2_MONIT_FIR_01_R(data.data_read[0]);
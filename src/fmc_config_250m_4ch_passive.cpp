@@ -11,12 +11,14 @@
 //               - EEPROM 24A64 check
 //               - ISLA216P configuration (4 ADC chips)
 //               - Clock and data lines calibation (IDELAY)
+//               - calibration record in FMC EEPROM (calibration done once per card)
 //               - most of the functions provides assertions to check if data is written to the chip (checks readback value)
 //============================================================================
 #include "reg_map/fmc_config_250m_4ch.h"
 
 #include <iostream>
 #include <unistd.h>  /* getopt */
+#include <getopt.h>  /* getopt_long */
 
 #include "config.h"
 #include "plat_opts.h"
@@ -32,6 +34,8 @@
 #include "chip/amc7823.h"
 #include "chip/eeprom_24a64.h"
 #include "platform/fmc250m_plat.h"
+#include "checkpoint.h"
+#include "calib.h"
 
 using namespace std;
 
@@ -41,22 +45,30 @@ int main(int argc, const char **argv) {
       "Author: Andrzej Wojenski" << endl;
 
   WBInt_drv* int_drv;
+  gpio_int* gpio;
   wb_data data;
   vector<uint16_t> amc_temp;
   vector<uint16_t> test_pattern;
   commLink* _commLink = new commLink();
-  uint32_t data_temp;
   int opt, error;
+  struct checkpoint_t ckpt;
+  struct calib_record calib;
+  vector<uint32_t> calib_bytes;
+  int calib_valid;
 
   /* Default command-line arguments */
   program = argv[0];
   quiet = 0;
   verbose = 0;
+  resume = 0;
+  calibrate = 0;
+  three_wire = 0;
+  eye_map_file = NULL;
   error = 0;
   platform = PLATFORM_NOT_SET;
 
   /* Process the command-line arguments */
-  while ((opt = getopt(argc, (char **)argv, "p:vqh")) != -1) {
+  while ((opt = getopt_long(argc, (char **)argv, SHORT_OPTIONS, long_options, NULL)) != -1) {
     switch (opt) {
     case 'p':
       if (strlen(optarg) > MAX_PLATFORM_SIZE_ID) {
@@ -90,6 +102,18 @@ int main(int argc, const char **argv) {
     case 'q':
       quiet = 1;
       break;
+    case 'r':
+      resume = 1;
+      break;
+    case 'e':
+      eye_map_file = optarg;
+      break;
+    case 'c':
+      calibrate = 1;
+      break;
+    case 'w':
+      three_wire = 1;
+      break;
     case 'h':
       help();
       return 1;
@@ -115,14 +139,22 @@ int main(int argc, const char **argv) {
 
   data.data_send.resize(10);
   data.extra.resize(2);
+  test_pattern.resize(4);
 
   // CommLink configuration
   // Adding communication interfaces
-  _commLink->regWBMaster(new rs232_syscon_driver());
+  _commLink->regWBMaster(new rs232_syscon_driver(RS232_PORT, FPGA_CTRL_REGS | WB_FMC_STATUS));
 
   int_drv = _commLink->regIntDrv(ISLA_SPI_DRV, FPGA_ISLA_SPI, new spi_int());
   ((spi_int*)int_drv)->spi_init(FPGA_SYS_FREQ, 1000000, 0x2400); // 10MHZ, ASS = 1,
   //TX_NEG = 1 (data changed on falling edge), RX_NEG = 0 (data latched on rising edge)
+  // ADC chips read in 3-wire mode (-w), data line turns around after instruction
+  if (three_wire) {
+    ((spi_int*)int_drv)->spi_set_read_mode(ISLA_ADC0_ADDR, ISLA216P_SPI_INSTR_BITS);
+    ((spi_int*)int_drv)->spi_set_read_mode(ISLA_ADC1_ADDR, ISLA216P_SPI_INSTR_BITS);
+    ((spi_int*)int_drv)->spi_set_read_mode(ISLA_ADC2_ADDR, ISLA216P_SPI_INSTR_BITS);
+    ((spi_int*)int_drv)->spi_set_read_mode(ISLA_ADC3_ADDR, ISLA216P_SPI_INSTR_BITS);
+  }
 
   int_drv = _commLink->regIntDrv(SI571_I2C_DRV, FPGA_SI571_I2C, new i2c_int());
   ((i2c_int*)int_drv)->i2c_init(FPGA_SYS_FREQ, 400000); // 400kHz
@@ -139,7 +171,12 @@ int main(int argc, const char **argv) {
   int_drv = _commLink->regIntDrv(EEPROM_I2C_DRV, FPGA_EEPROM_I2C, new i2c_int());
   ((i2c_int*)int_drv)->i2c_init(FPGA_SYS_FREQ, 400000); // 400kHz
 
-  _commLink->regIntDrv(GENERAL_GPIO_DRV, FPGA_CTRL_REGS, new gpio_int());
+  gpio = (gpio_int*)_commLink->regIntDrv(GENERAL_GPIO_DRV, FPGA_CTRL_REGS, new gpio_int());
+
+  // Chip drivers
+  AMC7823_drv::AMC7823_setCommLink(_commLink, AMC7823_SPI_DRV, GENERAL_GPIO_DRV);
+  ISLA216P_drv::ISLA216P_setCommLink(_commLink, ISLA_SPI_DRV, GENERAL_GPIO_DRV);
+  ISLA216P_drv::ISLA216P_set3Wire(three_wire);
 
   // ======================================================
   //                Firmware identification
@@ -152,7 +189,7 @@ int main(int argc, const char **argv) {
   data.wb_addr = FPGA_CTRL_REGS | WB_FMC_STATUS; // FMC status register (HW address)
 
   // check id data
-  _commLink->fmc_config_read(&data);
+  phase_check(fmc_config_read_check(_commLink, &data), "Firmware identification");
 
   cout << "Reg: " << hex << (data.data_read[0]) << endl;
   cout << "Firmware ID: " << hex << (data.data_read[0] >> 3) <<
@@ -161,276 +198,341 @@ int main(int argc, const char **argv) {
   // Check communication
   assert(0x01332A11 == (data.data_read[0] >> 3) );
 
+  // Finished phases are kept in state file, --resume skips them
+  checkpoint_init(&ckpt, program, RS232_PORT, data.data_read[0] >> 3, resume);
+
+  // Calibration record of this card (saved by previous run on the same
+  // carrier and firmware), calibration is skipped if it is valid
+  calib_valid = 0;
+
+  if (!calibrate) {
+    EEPROM_drv::EEPROM_setCommLink(_commLink, EEPROM_I2C_DRV);
+    // according to documentation, switches to i2c fmc lines
+    if (EEPROM_drv::EEPROM_switch(0x02) == 0 &&
+        EEPROM_drv::EEPROM_readData(EEPROM_ADDR, CALIB_EEPROM_OFFSET, CALIB_RECORD_SIZE, calib_bytes) == 0 &&
+        calib_decode(calib_bytes, &calib) == 0 && calib_match(&calib, platform, data.data_read[0] >> 3))
+      calib_valid = 1;
+  }
+
+  if (!calib_valid)
+    calib_init(&calib, platform, data.data_read[0] >> 3);
+
+  cout << "Calibration record: " << (calib_valid ? "found" : "not found, card will be calibrated") << endl;
+
   // ======================================================
   //                  LEDs configuration
   // ======================================================
+  if (checkpoint_phase_run(&ckpt, PHASE_LEDS)) {
+    cout << "============================================" << endl <<
+        "            LEDs configuration              " << endl <<
+        "============================================" << endl;
 
-  cout << "============================================" << endl <<
-      "            LEDs configuration              " << endl <<
-      "============================================" << endl;
+    // LEDs field of monitor register (HW address), one LED after another, then all
+    struct gpio_field leds = { FPGA_CTRL_REGS | WB_MONITOR_CTRL, WB_MONITOR_CTRL_LEDS };
+    uint32_t leds_val;
 
-  data.wb_addr = FPGA_CTRL_REGS | WB_MONITOR_CTRL; // monitor register (HW address)
+    phase_check(gpio->gpio_set(leds, 0x1), "LEDs configuration");
+    //sleep(1);
 
-  data.data_send[0] = 0x02;
-  _commLink->fmc_config_send(&data);
-  //sleep(1);
+    phase_check(gpio->gpio_set(leds, 0x2), "LEDs configuration");
+    //sleep(1);
 
-  data.data_send[0] = 0x04;
-  _commLink->fmc_config_send(&data);
-  //sleep(1);
+    phase_check(gpio->gpio_set(leds, 0x4), "LEDs configuration");
+    //sleep(1);
 
-  data.data_send[0] = 0x08;
-  _commLink->fmc_config_send(&data);
-  //sleep(1);
+    // Check if data properly written
+    phase_check(gpio->gpio_get(leds, &leds_val), "LEDs configuration");
+    assert(leds_val == 0x4); // DAV pin not in field
 
-  // Check if data properly written
-  _commLink->fmc_config_read(&data);
-  assert( (data.data_read[0] & 0x0E) == 0x08); // ignore DAV pin
+    phase_check(gpio->gpio_set(leds, 0x7), "LEDs configuration");
+    //sleep(1);
 
-  data.data_send[0] = 0x0E;
-  _commLink->fmc_config_send(&data);
-  //sleep(1);
+    // Set status config (blue LED)
+    phase_check(gpio->gpio_set(leds, 0x1), "LEDs configuration");
 
-  // Set status config (blue LED)
-  data.data_send[0] = 0x02;
-  _commLink->fmc_config_send(&data);
+    phase_check(gpio->gpio_set(leds, 0x0), "LEDs configuration");
 
-  data.data_send[0] = 0x00;
-  _commLink->fmc_config_send(&data);
+    checkpoint_phase_done(&ckpt, PHASE_LEDS);
+  }
 
   // ======================================================
   //                  Trigger configuration
   // ======================================================
-  cout << "============================================" << endl <<
-      "            Trigger configuration           " << endl <<
-      "============================================" << endl;
-
-  data.wb_addr = FPGA_CTRL_REGS | WB_TRG_CTRL; // trigger control, input mode, no termination
-  data.data_send[0] = 0x01;
-  _commLink->fmc_config_send(&data);
+  if (checkpoint_phase_run(&ckpt, PHASE_TRIGGER)) {
+    cout << "============================================" << endl <<
+        "            Trigger configuration           " << endl <<
+        "============================================" << endl;
+
+    data.wb_addr = FPGA_CTRL_REGS | WB_TRG_CTRL; // trigger control, input mode, no termination
+    data.data_send[0] = 0x01;
+    phase_check(_commLink->fmc_config_send(&data), "Trigger configuration");
+
+    /*
+    cout << "============================================" << endl <<
+        "                EEPROM check           " << endl <<
+        "============================================" << endl;
+    // check eeprom
+    EEPROM_drv::EEPROM_setCommLink(_commLink, EEPROM_I2C_DRV);
+    EEPROM_drv::EEPROM_switch(0x02); // according to documentation, switches to i2c fmc lines
+    //EEPROM_drv::EEPROM_sendData(0x00); // wrong address
+    EEPROM_drv::EEPROM_sendData(0x50); // good address
+    */
+  //
+
+    checkpoint_phase_done(&ckpt, PHASE_TRIGGER);
+  }
 
-  /*
-  cout << "============================================" << endl <<
-      "                EEPROM check           " << endl <<
-      "============================================" << endl;
-  // check eeprom
-  EEPROM_drv::EEPROM_setCommLink(_commLink, EEPROM_I2C_DRV);
-  EEPROM_drv::EEPROM_switch(0x02); // according to documentation, switches to i2c fmc lines
-  //EEPROM_drv::EEPROM_sendData(0x00); // wrong address
-  EEPROM_drv::EEPROM_sendData(0x50); // good address
-  */
-//
 //  // ======================================================
 //  //      AMC7823 configuration (temperature monitor)
 //  // ======================================================
-  cout << "============================================" << endl <<
-      " AMC7823 configuration (temperature monitor)" << endl <<
-      "============================================" << endl;
-  AMC7823_drv::AMC7823_setCommLink(_commLink, AMC7823_SPI_DRV, GENERAL_GPIO_DRV);
-  AMC7823_drv::AMC7823_checkReset(AMC7823_ADDR);
+  if (checkpoint_phase_run(&ckpt, PHASE_AMC7823)) {
+    cout << "============================================" << endl <<
+        " AMC7823 configuration (temperature monitor)" << endl <<
+        "============================================" << endl;
+    phase_check(AMC7823_drv::AMC7823_checkReset(AMC7823_ADDR) < 0, "AMC7823 configuration");
+
+    phase_check(AMC7823_drv::AMC7823_config(AMC7823_ADDR), "AMC7823 configuration");
+    phase_check(AMC7823_drv::AMC7823_powerUp(AMC7823_ADDR), "AMC7823 configuration");
+
+    struct gpio_field amc_dav = { FPGA_CTRL_REGS | WB_MONITOR_CTRL, WB_MONITOR_CTRL_DAV };
+
+    amc_temp = AMC7823_drv::AMC7823_getADCData(amc_dav, AMC7823_ADDR);
 
-  AMC7823_drv::AMC7823_config(AMC7823_ADDR);
-  AMC7823_drv::AMC7823_powerUp(AMC7823_ADDR);
+    phase_check(amc_temp.size() < 5, "AMC7823 configuration");
 
-  amc_temp = AMC7823_drv::AMC7823_getADCData(FPGA_CTRL_REGS | WB_MONITOR_CTRL, AMC7823_ADDR);
+    cout << "Temperature monitor (on-chip): " << AMC7823_drv::AMC7823_tempConvert(amc_temp[4]) << endl;
 
-  cout << "Temperature monitor (on-chip): " << AMC7823_drv::AMC7823_tempConvert(amc_temp[4]) << endl;
+    //exit(1);
 
-  //exit(1);
+    checkpoint_phase_done(&ckpt, PHASE_AMC7823);
+  }
 
   // ======================================================
   //                 ISLA216P25 (ADC chips)
   // ======================================================
-  cout << "============================================" << endl <<
-      "       ISLA216P25 (ADC chips) config        " << endl <<
-      "============================================" << endl;
+  if (checkpoint_phase_run(&ckpt, PHASE_ADC)) {
+    cout << "============================================" << endl <<
+        "       ISLA216P25 (ADC chips) config        " << endl <<
+        "============================================" << endl;
 
-  ISLA216P_drv::ISLA216P_setCommLink(_commLink, ISLA_SPI_DRV, GENERAL_GPIO_DRV);
+    // power-on calibration (500ms, reset pin)
+    phase_check(ISLA216P_drv::ISLA216P_powerUp(FPGA_CTRL_REGS | WB_ADC_ISLA_CTRL), "ADC configuration"); // turn off sleep and reset
 
-  // power-on calibration (500ms, reset pin)
-  ISLA216P_drv::ISLA216P_sleep(FPGA_CTRL_REGS | WB_ADC_ISLA_CTRL, 0x00); // turn off sleep
+    // Resetting /autocalbiration procedure
+    phase_check(ISLA216P_drv::ISLA216P_AutoCalibration(FPGA_CTRL_REGS | WB_ADC_ISLA_CTRL), "ADC configuration");
 
-  // Resetting /autocalbiration procedure
-  ISLA216P_drv::ISLA216P_AutoCalibration(FPGA_CTRL_REGS | WB_ADC_ISLA_CTRL);
+    // same configuration written to all chips at once; shared SDO line is safe
+    // in both modes: 4-wire chips drive SDO only during a read with their own
+    // chip select (reads are done chip by chip), 3-wire chips keep SDO off
+    phase_check(ISLA216P_drv::ISLA216P_config(ISLA_ADC_ALL_ADDR), "ADC configuration");
 
-  // first configure ISLA to enable four-wire mode (enable SDO output)
-  ISLA216P_drv::ISLA216P_config(ISLA_ADC0_ADDR);
-  ISLA216P_drv::ISLA216P_config(ISLA_ADC1_ADDR);
-  ISLA216P_drv::ISLA216P_config(ISLA_ADC2_ADDR);
-  ISLA216P_drv::ISLA216P_config(ISLA_ADC3_ADDR);
+    //ISLA216P_drv::ISLA216P_spi_write(ISLA_ADC0_ADDR, 0x00, 0x80); // turn on four wire mode
 
-  //ISLA216P_drv::ISLA216P_spi_write(ISLA_ADC0_ADDR, 0x00, 0x80); // turn on four wire mode
+    // check if autocalibration is done by SPI (could be also done by ADC output regs)
+    phase_check(ISLA216P_drv::ISLA216P_checkCalibration(ISLA_ADC0_ADDR), "ADC configuration");
+    phase_check(ISLA216P_drv::ISLA216P_checkCalibration(ISLA_ADC1_ADDR), "ADC configuration");
+    phase_check(ISLA216P_drv::ISLA216P_checkCalibration(ISLA_ADC2_ADDR), "ADC configuration");
+    phase_check(ISLA216P_drv::ISLA216P_checkCalibration(ISLA_ADC3_ADDR), "ADC configuration");
 
-  // check if autocalibration is done by SPI (could be also done by ADC output regs)
-  ISLA216P_drv::ISLA216P_checkCalibration(ISLA_ADC0_ADDR);
-  ISLA216P_drv::ISLA216P_checkCalibration(ISLA_ADC1_ADDR);
-  ISLA216P_drv::ISLA216P_checkCalibration(ISLA_ADC2_ADDR);
-  ISLA216P_drv::ISLA216P_checkCalibration(ISLA_ADC3_ADDR);
+    phase_check(ISLA216P_drv::ISLA216P_sync(FPGA_CTRL_REGS | WB_ADC_ISLA_CTRL), "ADC configuration");
 
-  ISLA216P_drv::ISLA216P_sync(FPGA_CTRL_REGS | WB_ADC_ISLA_CTRL);
+    // Check communication with all ADC
+    static const uint32_t isla_addr[] = { ISLA_ADC0_ADDR, ISLA_ADC1_ADDR, ISLA_ADC2_ADDR, ISLA_ADC3_ADDR };
 
-  // Check communication with all ADC
-  cout << "ISLA216P25 chip ID: " << ISLA216P_drv::ISLA216P_getChipID(ISLA_ADC0_ADDR) << " version: "
-      << ISLA216P_drv::ISLA216P_getChipVersion(ISLA_ADC0_ADDR) << endl;
-  cout << "ISLA216P25 temp: " << ISLA216P_drv::ISLA216P_getTemp(ISLA_ADC0_ADDR) << endl;
+    for (unsigned int i = 0; i < sizeof(isla_addr) / sizeof(isla_addr[0]); i++) {
 
-  cout << "ISLA216P25 chip ID: " << ISLA216P_drv::ISLA216P_getChipID(ISLA_ADC1_ADDR) << " version: "
-      << ISLA216P_drv::ISLA216P_getChipVersion(ISLA_ADC1_ADDR) << endl;
-  cout << "ISLA216P25 temp: " << ISLA216P_drv::ISLA216P_getTemp(ISLA_ADC1_ADDR) << endl;
+      uint32_t isla_id, isla_version, isla_temp;
 
-  cout << "ISLA216P25 chip ID: " << ISLA216P_drv::ISLA216P_getChipID(ISLA_ADC2_ADDR) << " version: "
-      << ISLA216P_drv::ISLA216P_getChipVersion(ISLA_ADC2_ADDR) << endl;
-  cout << "ISLA216P25 temp: " << ISLA216P_drv::ISLA216P_getTemp(ISLA_ADC2_ADDR) << endl;
+      if (ISLA216P_drv::ISLA216P_getChipID(isla_addr[i], &isla_id) != 0 ||
+          ISLA216P_drv::ISLA216P_getChipVersion(isla_addr[i], &isla_version) != 0 ||
+          ISLA216P_drv::ISLA216P_getTemp(isla_addr[i], &isla_temp) != 0) {
+        cout << "Error while reading ISLA216P25 (ADC" << i << ")!" << endl;
+        exit(1);
+      }
 
-  cout << "ISLA216P25 chip ID: " << ISLA216P_drv::ISLA216P_getChipID(ISLA_ADC3_ADDR) << " version: "
-      << ISLA216P_drv::ISLA216P_getChipVersion(ISLA_ADC3_ADDR) << endl;
+      cout << "ISLA216P25 chip ID: " << isla_id << " version: " << isla_version << endl;
+      cout << "ISLA216P25 temp: " << isla_temp << endl;
+    }
 
-  cout << "ISLA216P25 temp: " << ISLA216P_drv::ISLA216P_getTemp(ISLA_ADC3_ADDR) << endl;
+    // set test pattern
+    // mode:
+    // user pattern, user pattern 0 only
+    cout << "Setting test pattern" << endl;
+
+    // config for 200MHz output!!!
+
+    //test_pattern[0] = 0xAAAA; // 9999
+    test_pattern[0] = 0x1234;
+    test_pattern[1] = 0x5678;
+    test_pattern[2] = 0x9ABC;
+    test_pattern[3] = 0xDEF1;
+    phase_check(ISLA216P_drv::ISLA216P_setTestPattern(ISLA_ADC0_ADDR, 0x83, test_pattern), "ADC configuration");
+    //ISLA216P_drv::ISLA216P_setTestPattern(ISLA_ADC0_ADDR, 0x20, test_pattern);
+    //sleep(7);
+    test_pattern[0] = 0x1111;
+    test_pattern[1] = 0x2222;
+    test_pattern[2] = 0x3333;
+    test_pattern[3] = 0x4444;
+    phase_check(ISLA216P_drv::ISLA216P_setTestPattern(ISLA_ADC1_ADDR, 0x83, test_pattern), "ADC configuration");
+
+    test_pattern[0] = 0xEDF0;
+    test_pattern[1] = 0x4567;
+    test_pattern[2] = 0x1234;
+    test_pattern[3] = 0x9876;
+    phase_check(ISLA216P_drv::ISLA216P_setTestPattern(ISLA_ADC2_ADDR, 0x83, test_pattern), "ADC configuration");
+
+    test_pattern[0] = 0x5555;
+    test_pattern[1] = 0x6666;
+    test_pattern[2] = 0x7777;
+    test_pattern[3] = 0x8888;
+    phase_check(ISLA216P_drv::ISLA216P_setTestPattern(ISLA_ADC3_ADDR, 0x83, test_pattern), "ADC configuration");
+
+    // check test pattern configuration
+  /*
+    ISLA216P_drv::ISLA216P_assert(ISLA_ADC0_ADDR, 0xC1, 0x34);
+    ISLA216P_drv::ISLA216P_assert(ISLA_ADC0_ADDR, 0xC2, 0x12);
 
-  // set test pattern
-  // mode:
-  // user pattern, user pattern 0 only
-  cout << "Setting test pattern" << endl;
-  test_pattern.resize(4);
+    ISLA216P_drv::ISLA216P_assert(ISLA_ADC1_ADDR, 0xC1, 0x78);
+    ISLA216P_drv::ISLA216P_assert(ISLA_ADC1_ADDR, 0xC2, 0x56);
+
+    ISLA216P_drv::ISLA216P_assert(ISLA_ADC2_ADDR, 0xC1, 0xBC);
+    ISLA216P_drv::ISLA216P_assert(ISLA_ADC2_ADDR, 0xC2, 0x9A);
 
-  // config for 200MHz output!!!
-
-  //test_pattern[0] = 0xAAAA; // 9999
-  test_pattern[0] = 0x1234;
-  test_pattern[1] = 0x5678;
-  test_pattern[2] = 0x9ABC;
-  test_pattern[3] = 0xDEF1;
-  ISLA216P_drv::ISLA216P_setTestPattern(ISLA_ADC0_ADDR, 0x83, test_pattern);
-  //ISLA216P_drv::ISLA216P_setTestPattern(ISLA_ADC0_ADDR, 0x20, test_pattern);
-  //sleep(7);
-  test_pattern[0] = 0x1111;
-  test_pattern[1] = 0x2222;
-  test_pattern[2] = 0x3333;
-  test_pattern[3] = 0x4444;
-  ISLA216P_drv::ISLA216P_setTestPattern(ISLA_ADC1_ADDR, 0x83, test_pattern);
-
-  test_pattern[0] = 0xEDF0;
-  test_pattern[1] = 0x4567;
-  test_pattern[2] = 0x1234;
-  test_pattern[3] = 0x9876;
-  ISLA216P_drv::ISLA216P_setTestPattern(ISLA_ADC2_ADDR, 0x83, test_pattern);
-
-  test_pattern[0] = 0x5555;
-  test_pattern[1] = 0x6666;
-  test_pattern[2] = 0x7777;
-  test_pattern[3] = 0x8888;
-  ISLA216P_drv::ISLA216P_setTestPattern(ISLA_ADC3_ADDR, 0x83, test_pattern);
-
-  // check test pattern configuration
-/*
-  ISLA216P_drv::ISLA216P_assert(ISLA_ADC0_ADDR, 0xC1, 0x34);
-  ISLA216P_drv::ISLA216P_assert(ISLA_ADC0_ADDR, 0xC2, 0x12);
-
-  ISLA216P_drv::ISLA216P_assert(ISLA_ADC1_ADDR, 0xC1, 0x78);
-  ISLA216P_drv::ISLA216P_assert(ISLA_ADC1_ADDR, 0xC2, 0x56);
-
-  ISLA216P_drv::ISLA216P_assert(ISLA_ADC2_ADDR, 0xC1, 0xBC);
-  ISLA216P_drv::ISLA216P_assert(ISLA_ADC2_ADDR, 0xC2, 0x9A);
-
-  ISLA216P_drv::ISLA216P_assert(ISLA_ADC3_ADDR, 0xC1, 0xF1);
-  ISLA216P_drv::ISLA216P_assert(ISLA_ADC3_ADDR, 0xC2, 0xDE);
-
-  ISLA216P_drv::ISLA216P_assert(ISLA_ADC0_ADDR, 0xC0, 0x80);
-  ISLA216P_drv::ISLA216P_assert(ISLA_ADC1_ADDR, 0xC0, 0x80);
-  ISLA216P_drv::ISLA216P_assert(ISLA_ADC2_ADDR, 0xC0, 0x80);
-  ISLA216P_drv::ISLA216P_assert(ISLA_ADC3_ADDR, 0xC0, 0x80);*/
-
-  // config done, reset IDELAYCTRL blocks
-
-  // Calibration
-  // reset IDELAYCTRLs in FPGA
-  data.wb_addr = FPGA_CTRL_REGS | WB_FPGA_CTRL;
-  data.data_send[0] = 0x01;
-  _commLink->fmc_config_send(&data);
-  sleep(1);
-  data.data_send[0] = 0x00;
-  _commLink->fmc_config_send(&data);
-
-  // check if ready
-  _commLink->fmc_config_read(&data);
-  printf("data: %08x\n", data.data_read[0]);
-
-  if ( (data.data_read[0] >> 2) & 0x07 ) // now checks adc0 adc1 adc2
-    cout << "All IDELAY controllers has been reset and are ready to work!" << endl;
-  else {
-    cout << "Error while resetting IDELAY controllers, some of them are not ready!" << endl;
-    exit(1);
+    ISLA216P_drv::ISLA216P_assert(ISLA_ADC3_ADDR, 0xC1, 0xF1);
+    ISLA216P_drv::ISLA216P_assert(ISLA_ADC3_ADDR, 0xC2, 0xDE);
+
+    ISLA216P_drv::ISLA216P_assert(ISLA_ADC0_ADDR, 0xC0, 0x80);
+    ISLA216P_drv::ISLA216P_assert(ISLA_ADC1_ADDR, 0xC0, 0x80);
+    ISLA216P_drv::ISLA216P_assert(ISLA_ADC2_ADDR, 0xC0, 0x80);
+    ISLA216P_drv::ISLA216P_assert(ISLA_ADC3_ADDR, 0xC0, 0x80);*/
+
+    checkpoint_phase_done(&ckpt, PHASE_ADC);
   }
 
-  // train communication links
-  // upload new tap value
-  // for fmc adc 250m
-  // adc0 -1.364
-  // adc1 -0.705
-  // adc2 -0.996
-  // tap resolution 78ps
-
-  set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY0_CAL, &delay_data_l[0], DLY_DATA);
-
-  //data.wb_addr = FPGA_CTRL_REGS | WB_IDELAY0_CAL;
-  //data.data_send[0] = IDELAY_ALL_LINES | IDELAY_TAP(18) | IDELAY_UPDATE; // should be 0x0050003f
-  //_commLink->fmc_config_send(&data);
-  //// check data
-  //_commLink->fmc_config_read(&data);
-  ////assert(data.data_read[0] == (IDELAY_ALL_LINES | IDELAY_TAP(18) | IDELAY_UPDATE));
-  //usleep(1000);
-  //data.data_send[0] = (IDELAY_ALL_LINES | IDELAY_TAP(18)) & 0xFFFFFFFE; // should be 0x0050003f
-  //_commLink->fmc_config_send(&data);
-
-  set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY1_CAL, &delay_data_l[1], DLY_DATA);
-
-  //data.wb_addr = FPGA_CTRL_REGS | WB_IDELAY1_CAL;
-  //data.data_send[0] = IDELAY_ALL_LINES | IDELAY_TAP(18) | IDELAY_UPDATE; // should be 0x0050003f
-  //_commLink->fmc_config_send(&data);
-  //// check data
-  //_commLink->fmc_config_read(&data);
-  ////assert(data.data_read[0] == (IDELAY_ALL_LINES | IDELAY_TAP(9) | IDELAY_UPDATE));
-  //usleep(1000);
-  //data.data_send[0] = (IDELAY_ALL_LINES | IDELAY_TAP(18)) & 0xFFFFFFFE; // should be 0x0050003f
-  //_commLink->fmc_config_send(&data);
-
-  set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY2_CAL, &delay_data_l[2], DLY_DATA);
-
-  //data.wb_addr = FPGA_CTRL_REGS | WB_IDELAY2_CAL;
-  //data.data_send[0] = IDELAY_ALL_LINES | IDELAY_TAP(18) | IDELAY_UPDATE; // should be 0x0050003f
-  //_commLink->fmc_config_send(&data);
-  //// check data
-  //_commLink->fmc_config_read(&data);
-  ////assert(data.data_read[0] == (IDELAY_ALL_LINES | IDELAY_TAP(13) | IDELAY_UPDATE));
-  //usleep(1000);
-  //data.data_send[0] = (IDELAY_ALL_LINES | IDELAY_TAP(18)) & 0xFFFFFFFE; // should be 0x0050003f
-  //_commLink->fmc_config_send(&data);
-
-  set_fpga_delay_s(_commLink, FPGA_CTRL_REGS | WB_IDELAY3_CAL, &delay_data_l[3], DLY_DATA);
-
-  //data.wb_addr = FPGA_CTRL_REGS | WB_IDELAY3_CAL;
-  //data.data_send[0] = IDELAY_ALL_LINES | IDELAY_TAP(18) | IDELAY_UPDATE; // should be 0x0050003f
-  //_commLink->fmc_config_send(&data);
-  //// check data
-  //_commLink->fmc_config_read(&data);
-  ////assert(data.data_read[0] == (IDELAY_ALL_LINES | IDELAY_TAP(13) | IDELAY_UPDATE));
-  //usleep(1000);
-  //data.data_send[0] = (IDELAY_ALL_LINES | IDELAY_TAP(18)) & 0xFFFFFFFE; // should be 0x0050003f
-  //_commLink->fmc_config_send(&data);
-
-
-  // turn off test pattern
-  cout << "Check test pattern" << endl;
-  //sleep(90);
-
-
-  cout << "Test pattern off" << endl;
-
-  ISLA216P_drv::ISLA216P_setTestPattern(ISLA_ADC0_ADDR, 0x00, test_pattern);
-  ISLA216P_drv::ISLA216P_setTestPattern(ISLA_ADC1_ADDR, 0x00, test_pattern);
-  ISLA216P_drv::ISLA216P_setTestPattern(ISLA_ADC2_ADDR, 0x00, test_pattern);
-  ISLA216P_drv::ISLA216P_setTestPattern(ISLA_ADC3_ADDR, 0x00, test_pattern);
+  if (checkpoint_phase_run(&ckpt, PHASE_IDELAY)) {
+    // config done, reset IDELAYCTRL blocks
+
+    // Calibration
+    // reset IDELAYCTRLs in FPGA
+    struct gpio_field idelayctrl_rst = { FPGA_CTRL_REGS | WB_FPGA_CTRL, WB_FPGA_CTRL_IDELAYCTRL_RST };
+
+    phase_check(gpio->gpio_pulse(idelayctrl_rst, 1, 0, 1000000), "IDELAY calibration");
+    data.wb_addr = FPGA_CTRL_REGS | WB_FPGA_CTRL;
+
+    // check if ready
+    phase_check(fmc_config_read_check(_commLink, &data), "IDELAY calibration");
+    printf("data: %08x\n", data.data_read[0]);
+
+    if ( (data.data_read[0] >> 2) & 0x07 ) // now checks adc0 adc1 adc2
+      cout << "All IDELAY controllers has been reset and are ready to work!" << endl;
+    else {
+      cout << "Error while resetting IDELAY controllers, some of them are not ready!" << endl;
+      exit(1);
+    }
+
+    // train communication links
+    // IDELAY taps are taken from eye scan of ADC test pattern (data and clock
+    // lines, all links swept together), platform table says which channels
+    // are available and gives tap used when link training fails
+    // tap resolution 78ps
+    // window, taps and errors are filled by training (window not found yet)
+    static const struct isla216p_link adc_links[] = {
+      { ISLA_ADC0_ADDR, FPGA_CTRL_REGS | WB_IDELAY0_CAL, FPGA_CTRL_REGS | WB_DATA0, 1, 0, -1, 0, 0, 0 },
+      { ISLA_ADC1_ADDR, FPGA_CTRL_REGS | WB_IDELAY1_CAL, FPGA_CTRL_REGS | WB_DATA1, 1, 0, -1, 0, 0, 0 },
+      { ISLA_ADC2_ADDR, FPGA_CTRL_REGS | WB_IDELAY2_CAL, FPGA_CTRL_REGS | WB_DATA2, 1, 0, -1, 0, 0, 0 },
+      { ISLA_ADC3_ADDR, FPGA_CTRL_REGS | WB_IDELAY3_CAL, FPGA_CTRL_REGS | WB_DATA3, 1, 0, -1, 0, 0, 0 }
+    };
+    struct delay_lines delay_data[CKPT_IDELAY_NUM + 1], delay_clk[CKPT_IDELAY_NUM + 1];
+    vector<struct isla216p_link> links;
+    unsigned int ch, n, trained = 0;
+
+    // taps of calibration record (eye map needs trained links)
+    if (calib_valid && eye_map_file == NULL) {
+
+      calib_get_idelay(&calib, delay_data, delay_clk);
+
+      for (ch = 0; ch < CKPT_IDELAY_NUM; ch++) {
+        phase_check(set_fpga_delay_s(_commLink, adc_links[ch].idelay_reg, &delay_clk[ch], DLY_CLK), "IDELAY calibration");
+        phase_check(set_fpga_delay_s(_commLink, adc_links[ch].idelay_reg, &delay_data[ch], DLY_DATA), "IDELAY calibration");
+      }
+    }
+    else {
+
+      for (ch = 0; ch < CKPT_IDELAY_NUM && delay_data_l[ch].init != DELAY_LINES_END; ch++)
+        if (delay_data_l[ch].init == DELAY_LINES_INIT)
+          links.push_back(adc_links[ch]);
+
+      if (ISLA216P_drv::ISLA216P_train(FPGA_CTRL_REGS | WB_ADC_ISLA_CTRL, links) != 0)
+        cout << "WARNING: some ADC links not trained, using IDELAY taps of " << platform_name << endl;
+
+      // diagnostic eye map (qualification of carrier boards), trained taps are restored
+      if (eye_map_file != NULL) {
 
+        vector<vector<uint32_t> > eye;
+
+        if (ISLA216P_drv::ISLA216P_eye_map(links, ISLA216P_EYE_SAMPLES, eye) == 0) {
+          for (ch = 0, n = 0; ch < CKPT_IDELAY_NUM && delay_data_l[ch].init != DELAY_LINES_END; ch++)
+            if (delay_data_l[ch].init == DELAY_LINES_INIT)
+              eye_map_write(eye_map_file, ch, eye[n++], ISLA216P_TRAIN_TAPS, ISLA216P_EYE_SAMPLES);
+        }
+      }
+
+      for (ch = 0, n = 0; ch < CKPT_IDELAY_NUM && delay_data_l[ch].init != DELAY_LINES_END; ch++) {
+
+        delay_data[ch] = delay_data_l[ch];
+        delay_clk[ch].init = DELAY_LINES_NO_INIT;
+        delay_clk[ch].value = 0;
+
+        if (delay_data_l[ch].init != DELAY_LINES_INIT)
+          continue;
+
+        if (links[n].first <= links[n].last && links[n].errors == 0) {
+          delay_data[ch].value = links[n].tap;
+          delay_clk[ch].init = DELAY_LINES_INIT;
+          delay_clk[ch].value = links[n].clk_tap;
+          trained++;
+        }
+        else {
+          phase_check(set_fpga_delay(_commLink, adc_links[ch].idelay_reg, 0, DLY_CLK), "IDELAY calibration");
+          phase_check(set_fpga_delay_s(_commLink, adc_links[ch].idelay_reg, &delay_data[ch], DLY_DATA), "IDELAY calibration");
+        }
+
+        n++;
+      }
+
+      delay_data[ch].init = DELAY_LINES_END;
+      delay_clk[ch].init = DELAY_LINES_END;
+
+      // only trained taps are saved to the card
+      if (trained == links.size()) {
+        calib_set_idelay(&calib, delay_data, delay_clk);
+        calib_encode(&calib, calib_bytes);
+
+        EEPROM_drv::EEPROM_setCommLink(_commLink, EEPROM_I2C_DRV);
+        // according to documentation, switches to i2c fmc lines
+        if (EEPROM_drv::EEPROM_switch(0x02) == 0 &&
+            EEPROM_drv::EEPROM_writeData(EEPROM_ADDR, CALIB_EEPROM_OFFSET, calib_bytes) == 0)
+          cout << "Calibration record saved to FMC EEPROM" << endl;
+        else
+          cout << "WARNING: calibration record not saved to FMC EEPROM" << endl;
+      }
+    }
+
+    // turn off test pattern
+    cout << "Check test pattern" << endl;
+    //sleep(90);
+
+
+    cout << "Test pattern off" << endl;
+
+    phase_check(ISLA216P_drv::ISLA216P_setTestPattern(ISLA_ADC0_ADDR, 0x00, test_pattern), "IDELAY calibration");
+    phase_check(ISLA216P_drv::ISLA216P_setTestPattern(ISLA_ADC1_ADDR, 0x00, test_pattern), "IDELAY calibration");
+    phase_check(ISLA216P_drv::ISLA216P_setTestPattern(ISLA_ADC2_ADDR, 0x00, test_pattern), "IDELAY calibration");
+    phase_check(ISLA216P_drv::ISLA216P_setTestPattern(ISLA_ADC3_ADDR, 0x00, test_pattern), "IDELAY calibration");
+
+    checkpoint_set_idelay(&ckpt, delay_data, delay_clk);
+    checkpoint_phase_done(&ckpt, PHASE_IDELAY);
+  }
 
   cout << "All done! All components on the FMC card had been configured and tested!" << endl <<
       "FMC card is ready to work!" << endl;
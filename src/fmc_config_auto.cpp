@@ -0,0 +1,276 @@
+//============================================================================
+// Author      : Andrzej Wojenski
+// Version     : 1.0
+// Description : Automatic selection of FMC card configuration program
+//               - FMC card found by firmware ID in its FMC status register
+//               - board info of FMC EEPROM FRU (product name, part number,
+//                 serial number) selects configuration program (fmc_auto_*.cpp)
+//               - carrier platform from -p, or from previous run on the card
+//                 (cached per serial number), AFC otherwise
+//               - selected program is run with -p <platform>
+//============================================================================
+#include "plat_opts.h"
+#include "data.h"
+
+#include <iostream>
+#include <fstream>
+#include <unistd.h>  /* getopt, execvp */
+#include <getopt.h>  /* getopt_long */
+#include <ctype.h>
+
+#include "config.h"
+#include "commLink.h"
+#include "wishbone/rs232_syscon.h"
+#include "interface/i2c.h"
+#include "chip/eeprom_24a64.h"
+#include "common.h"
+#include "fru.h"
+#include "fmc_auto.h"
+
+// directory for per card cache (survives reboot, unlike /tmp)
+#define AUTO_CACHE_DIR "/var/tmp"
+#define AUTO_EEPROM_DRV "EEPROM_I2C"
+// carrier of cards in crate
+#define AUTO_DEFAULT_PLATFORM AFC_STRING
+
+using namespace std;
+
+static const struct fmc_auto_card* cards[] = {
+  &fmc_auto_130m,
+  &fmc_auto_250m
+};
+
+#define AUTO_NUM_CARDS (sizeof(cards)/sizeof(cards[0]))
+
+static const struct option auto_options[] = {
+  {"platform",    required_argument,  NULL, 'p'},
+  {"dry-run",     no_argument,        NULL, 'n'},
+  {"verbose",     no_argument,        NULL, 'v'},
+  {"help",        no_argument,        NULL, 'h'},
+  {NULL, 0, NULL, 0}
+};
+
+static void auto_help(void) {
+  fprintf(stderr, "Usage: %s [OPTION] [-- PROGRAM OPTION]\n", program);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -p <platform>  carrier platform (ML605/KC705/AFC), default is the one\n");
+  fprintf(stderr, "                 used previously with the card, or %s\n", AUTO_DEFAULT_PLATFORM);
+  fprintf(stderr, "  -n             only show selected program\n");
+  fprintf(stderr, "  -v             verbose operation\n");
+  fprintf(stderr, "  -h             display this help and exit\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Options after -- are passed to configuration program.\n");
+  fprintf(stderr, "Version (%s). Licensed under the GPL v3.\n", VERSION);
+}
+
+static string upper(const string& str) {
+
+  string s(str);
+  unsigned int i;
+
+  for (i = 0; i < s.size(); i++)
+    s[i] = toupper(s[i]);
+
+  return s;
+}
+
+// return - card answering with its firmware ID, NULL if none
+// (status registers of all cards are probed, one batch per card)
+static const struct fmc_auto_card* auto_probe(commLink* _commLink) {
+
+  vector<struct wb_op> ops(1);
+  unsigned int i;
+
+  for (i = 0; i < AUTO_NUM_CARDS; i++) {
+
+    ops[0].type = WB_OP_READ;
+    ops[0].addr = cards[i]->status_addr;
+    ops[0].data = 0;
+    ops[0].mask = ops[0].value = ops[0].err_mask = 0;
+    ops[0].retries = 0;
+
+    if (_commLink->fmc_config_exec(ops) != WB_STATUS_OK)
+      continue;
+
+    if (verbose)
+      printf("%s: status 0x%08x\n", cards[i]->name, ops[0].data);
+
+    if ((ops[0].data >> 3) == cards[i]->fw_id)
+      return cards[i];
+  }
+
+  return NULL;
+}
+
+static const char* auto_profile(const struct fmc_auto_card* card, const struct fru_board* board) {
+
+  const struct fmc_auto_profile* prof;
+  string id = upper(board->product + " " + board->part_number);
+
+  for (prof = card->profiles; prof->keyword != NULL; prof++)
+    if (id.find(prof->keyword) != string::npos)
+      break;
+
+  return prof->program;
+}
+
+// Cache file format (text, one item per line):
+// program <name>
+// platform <name>
+static string auto_cache_path(const string& serial) {
+
+  string path = string(AUTO_CACHE_DIR) + "/fmc_config_auto_";
+  unsigned int i;
+
+  for (i = 0; i < serial.size(); i++)
+    path += isalnum(serial[i]) ? serial[i] : '_';
+
+  return path;
+}
+
+static void auto_cache_load(const string& serial, string& prog, string& plat) {
+
+  ifstream file(auto_cache_path(serial).c_str());
+  string key, val;
+
+  while (file >> key >> val) {
+    if (key == "program")
+      prog = val;
+    else if (key == "platform")
+      plat = val;
+  }
+}
+
+static void auto_cache_save(const string& serial, const string& prog, const string& plat) {
+
+  ofstream file(auto_cache_path(serial).c_str());
+
+  file << "program " << prog << endl;
+  file << "platform " << plat << endl;
+
+  if (!file.good())
+    cout << "WARNING: can't save " << auto_cache_path(serial) << endl;
+}
+
+int main(int argc, const char **argv) {
+
+  const struct fmc_auto_card* card;
+  struct fru_board board;
+  commLink* _commLink = new commLink();
+  rs232_syscon_driver* wb_master;
+  WBInt_drv* int_drv;
+  vector<uint8_t> fru;
+  vector<const char*> args;
+  string plat, cached_prog, cached_plat, path;
+  const char* prog;
+  int opt, dry_run, i;
+
+  /* Default command-line arguments */
+  program = argv[0];
+  verbose = 0;
+  dry_run = 0;
+
+  /* Process the command-line arguments */
+  while ((opt = getopt_long(argc, (char **)argv, "p:nvh", auto_options, NULL)) != -1) {
+    switch (opt) {
+    case 'p':
+      if (lookupstring_i(optarg) == BAD_PLATFORM) {
+        fprintf(stderr, "%s: invalid platform -- '%s'\n", program, optarg);
+        return 1;
+      }
+      plat = upper(optarg);
+      break;
+    case 'n':
+      dry_run = 1;
+      break;
+    case 'v':
+      verbose = 1;
+      break;
+    case 'h':
+      auto_help();
+      return 1;
+    default:
+      auto_help();
+      return 1;
+    }
+  }
+
+  cout << "FMC card detection" << endl;
+
+  wb_master = new rs232_syscon_driver(RS232_PORT);
+  _commLink->regWBMaster(wb_master);
+
+  card = auto_probe(_commLink);
+
+  if (card == NULL) {
+    fprintf(stderr, "%s: no supported FMC card found\n", program);
+    return 1;
+  }
+
+  cout << "Card: " << card->name << endl;
+
+  // FRU board info, whole FRU is read in one transaction
+  int_drv = _commLink->regIntDrv(AUTO_EEPROM_DRV, card->eeprom_i2c, new i2c_int());
+  ((i2c_int*)int_drv)->i2c_init(card->sys_freq, 400000); // 400kHz
+
+  EEPROM_drv::EEPROM_setCommLink(_commLink, AUTO_EEPROM_DRV);
+  EEPROM_drv::EEPROM_switch(0x02); // according to documentation, switches to i2c fmc lines
+
+  if (EEPROM_drv::EEPROM_read(card->eeprom_addr, FRU_EEPROM_OFFSET, FRU_READ_SIZE, fru) != 0 ||
+      fru_parse_board(fru, &board) != 0) {
+    fprintf(stderr, "%s: no FRU board info in FMC EEPROM\n", program);
+    return 1;
+  }
+
+  cout << "Manufacturer: " << board.manufacturer << endl <<
+      "Product: " << board.product << endl <<
+      "Part number: " << board.part_number << endl <<
+      "Serial number: " << board.serial << endl;
+
+  prog = auto_profile(card, &board);
+
+  auto_cache_load(board.serial, cached_prog, cached_plat);
+
+  if (plat.empty())
+    plat = cached_plat.empty() ? AUTO_DEFAULT_PLATFORM : cached_plat;
+
+  if (!cached_prog.empty() && cached_prog != prog)
+    cout << "WARNING: card was configured by " << cached_prog << " before" << endl;
+
+  if (cached_prog != prog || cached_plat != plat)
+    auto_cache_save(board.serial, prog, plat);
+
+  // configuration program is in the same directory (or in PATH)
+  path = program;
+  path = (path.rfind('/') == string::npos) ? string("") : path.substr(0, path.rfind('/') + 1);
+  path += prog;
+
+  args.push_back(path.c_str());
+  args.push_back("-p");
+  args.push_back(plat.c_str());
+
+  if (verbose)
+    args.push_back("-v");
+
+  for (i = optind; i < argc; i++)
+    args.push_back(argv[i]);
+
+  args.push_back(NULL);
+
+  cout << "Program:";
+  for (i = 0; args[i] != NULL; i++)
+    cout << " " << args[i];
+  cout << endl;
+
+  if (dry_run)
+    return 0;
+
+  // serial port is opened again by configuration program
+  delete wb_master;
+
+  execvp(path.c_str(), (char* const*)&args[0]);
+
+  fprintf(stderr, "%s: can't run %s\n", program, path.c_str());
+
+  return 1;
+}
@@ -0,0 +1,303 @@
+//============================================================================
+// Author      : Andrzej Wojenski
+// Version     : 1.0
+// Description : Configuration daemon for FMC ADC 130M 4CH card (ACTIVE version)
+//               Keeps the link and interface cores open between requests,
+//               requests are served over a local Unix socket (see fmcd.h):
+//               - read <addr>            read Wishbone register
+//               - write <addr> <value>   write Wishbone register
+//               - temp                   LM75A temperatures (chip 1, chip 2)
+//               - freq <Hz>              retune Si571 (small steps without glitch)
+//               - restore                re-apply Si571 and IDELAY state saved
+//                                        by fmc_config_130m_4ch (checkpoint)
+//============================================================================
+#include "plat_opts.h" // must be included before reg_map*
+#include "data.h"
+#include "reg_map/fmc_config_130m_4ch.h"
+
+#include <iostream>
+#include <sstream>
+#include <unistd.h>  /* getopt, daemon */
+#include <getopt.h>  /* getopt_long */
+
+#include "config.h"
+#include "commlink/commLink.h"
+#include "wishbone/rs232_syscon.h"
+#include "interface/i2c.h"
+#include "interface/spi.h"
+#include "interface/gpio.h"
+#include "chip/si570.h"
+#include "chip/lm75a.h"
+#include "checkpoint.h"
+#include "fmcd.h"
+
+// configuration program whose checkpoint is used by "restore"
+#define CONFIG_PROGRAM "fmc_config_130m_4ch"
+
+using namespace std;
+
+static commLink* _commLink;
+static uint32_t fw_id;
+static int si571_ready;
+static const char* config_program = CONFIG_PROGRAM;
+
+static const struct option daemon_options[] = {
+  {"socket",      required_argument,  NULL, 's'},
+  {"config",      required_argument,  NULL, 'c'},
+  {"detach",      no_argument,        NULL, 'd'},
+  {"verbose",     no_argument,        NULL, 'v'},
+  {"help",        no_argument,        NULL, 'h'},
+  {NULL, 0, NULL, 0}
+};
+
+static void daemon_help(void) {
+  fprintf(stderr, "Usage: %s [OPTION]\n", program);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -s <path>      control socket (default %s/%s_<port>.sock)\n", FMCD_SOCKET_DIR, "fmc_configd_130m_4ch");
+  fprintf(stderr, "  -c <program>   configuration program for \"restore\" (default %s)\n", CONFIG_PROGRAM);
+  fprintf(stderr, "  -d             run in background\n");
+  fprintf(stderr, "  -v             verbose operation\n");
+  fprintf(stderr, "  -h             display this help and exit\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Version (%s). Licensed under the GPL v3.\n", VERSION);
+}
+
+static int cmd_read(const vector<string>& args, string& reply) {
+
+  wb_data data;
+  ostringstream val;
+
+  if (args.size() != 2 || fmcd_parse_num(args[1], &data.wb_addr) != 0) {
+    reply = "usage: read <addr>";
+    return 1;
+  }
+
+  if (_commLink->fmc_config_read(&data) != WB_STATUS_OK || data.data_read.empty()) {
+    reply = "link error";
+    return 1;
+  }
+
+  val << "0x" << hex << data.data_read[0];
+  reply = val.str();
+
+  return 0;
+}
+
+static int cmd_write(const vector<string>& args, string& reply) {
+
+  wb_data data;
+
+  data.data_send.resize(1);
+
+  if (args.size() != 3 || fmcd_parse_num(args[1], &data.wb_addr) != 0 ||
+      fmcd_parse_num(args[2], &data.data_send[0]) != 0) {
+    reply = "usage: write <addr> <value>";
+    return 1;
+  }
+
+  if (_commLink->fmc_config_send(&data) != WB_STATUS_OK) {
+    reply = "link error";
+    return 1;
+  }
+
+  return 0;
+}
+
+static int cmd_temp(const vector<string>& /* args */, string& reply) {
+
+  ostringstream val;
+  float temp[2];
+
+  if (LM75A_drv::LM75A_readTemp(LM75A_ADDR_1, &temp[0]) != 0 ||
+      LM75A_drv::LM75A_readTemp(LM75A_ADDR_2, &temp[1]) != 0) {
+    reply = "link error";
+    return 1;
+  }
+
+  val << temp[0] << " " << temp[1];
+  reply = val.str();
+
+  return 0;
+}
+
+static int cmd_restore(const vector<string>& /* args */, string& reply) {
+
+  struct checkpoint_t ckpt;
+  wb_data data;
+  unsigned int i;
+  // IDELAY registers for checkpoint lines 0..3
+  static const uint32_t idelay_regs[CKPT_IDELAY_NUM] = {
+    FPGA_CTRL_REGS | WB_IDELAY0_CAL,
+    FPGA_CTRL_REGS | WB_IDELAY1_CAL,
+    FPGA_CTRL_REGS | WB_IDELAY2_CAL,
+    FPGA_CTRL_REGS | WB_IDELAY3_CAL
+  };
+
+  checkpoint_init(&ckpt, config_program, RS232_PORT, fw_id, 1);
+
+  if (!ckpt.si570_valid && !ckpt.idelay_valid) {
+    reply = "no saved configuration, run " + string(config_program) + " first";
+    return 1;
+  }
+
+  if (ckpt.si570_valid) {
+
+    data.extra.resize(2);
+    data.extra[0] = SI571_ADDR;
+    data.extra[1] = CKPT_SI570_REGS;
+
+    for (i = 0; i < CKPT_SI570_REGS; i++)
+      data.data_send.push_back(ckpt.si570[i]);
+
+    if (Si570_drv::si570_outputDisable(FPGA_CTRL_REGS | WB_CLK_CTRL) != 0 ||
+        Si570_drv::si570_set_freq(&data) != 0 ||
+        Si570_drv::si570_outputEnable(FPGA_CTRL_REGS | WB_CLK_CTRL) != 0) {
+      reply = "Si571 write error";
+      return 1;
+    }
+
+    // saved setting is SI571_FOUT again
+    si571_ready = 0;
+
+    // clock has to settle before IDELAY values are applied
+    sleep(1);
+  }
+
+  for (i = 0; i < CKPT_IDELAY_NUM; i++) {
+
+    if (!(ckpt.idelay_valid & (1 << i)))
+      continue;
+
+    if (set_fpga_delay(_commLink, idelay_regs[i], ckpt.idelay_data[i], DLY_DATA) != 0 ||
+        (ckpt.idelay_clk[i] &&
+         set_fpga_delay(_commLink, idelay_regs[i], ckpt.idelay_clk[i], DLY_CLK) != 0)) {
+      reply = "link error";
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+static int cmd_freq(const vector<string>& args, string& reply) {
+
+  uint32_t freq;
+
+  if (args.size() != 2 || fmcd_parse_num(args[1], &freq) != 0) {
+    reply = "usage: freq <Hz>";
+    return 1;
+  }
+
+  // crystal frequency is derived from running setting, output is not changed
+  if (!si571_ready) {
+    if (Si570_drv::si570_get_current(SI571_ADDR, SI571_FOUT) != 0) {
+      reply = "Si571 read error";
+      return 1;
+    }
+    si571_ready = 1;
+  }
+
+  // small steps (trim) keep clock running, bigger ones reprogram DCO
+  if (Si570_drv::si570_set_frequency(SI571_ADDR, freq) != 0) {
+    reply = "Si571 error";
+    return 1;
+  }
+
+  return 0;
+}
+
+static const struct fmcd_cmd daemon_cmds[] = {
+  { "read",      "read <addr>",           cmd_read },
+  { "write",     "write <addr> <value>",  cmd_write },
+  { "temp",      "temp",                  cmd_temp },
+  { "restore",   "restore",               cmd_restore },
+  { "freq",      "freq <Hz>",             cmd_freq }
+};
+
+#define DAEMON_NUM_CMDS (sizeof(daemon_cmds)/sizeof(daemon_cmds[0]))
+
+int main(int argc, const char **argv) {
+
+  WBInt_drv* int_drv;
+  wb_data data;
+  string socket_path;
+  int opt, detach;
+
+  /* Default command-line arguments */
+  program = argv[0];
+  quiet = 0;
+  verbose = 0;
+  detach = 0;
+  socket_path = fmcd_socket_path(program, RS232_PORT);
+
+  /* Process the command-line arguments */
+  while ((opt = getopt_long(argc, (char **)argv, "s:c:dvh", daemon_options, NULL)) != -1) {
+    switch (opt) {
+    case 's':
+      socket_path = optarg;
+      break;
+    case 'c':
+      config_program = optarg;
+      break;
+    case 'd':
+      detach = 1;
+      break;
+    case 'v':
+      verbose = 1;
+      break;
+    case 'h':
+      daemon_help();
+      return 1;
+    default:
+      daemon_help();
+      return 1;
+    }
+  }
+
+  cout << "FMC configuration daemon for FMC ADC 130M 4CH card (ACTIVE version)" << endl;
+
+  data.data_send.resize(10);
+  data.extra.resize(2);
+
+  _commLink = new commLink();
+
+  // CommLink configuration
+  // Adding communication interfaces
+  _commLink->regWBMaster(new rs232_syscon_driver(RS232_PORT, FPGA_CTRL_REGS | WB_FMC_STATUS));
+
+  int_drv = _commLink->regIntDrv(SI571_I2C_DRV, FPGA_SI571_I2C, new i2c_int());
+  ((i2c_int*)int_drv)->i2c_init(FPGA_SYS_FREQ, 100000); // 100kHz
+  ((i2c_int*)int_drv)->i2c_set_if_mode(1); // wait for transfers on interrupt flag
+
+  int_drv = _commLink->regIntDrv(LM75A_I2C_DRV, FPGA_LM75A_I2C, new i2c_int());
+  ((i2c_int*)int_drv)->i2c_init(FPGA_SYS_FREQ, 400000); // 400kHz
+  ((i2c_int*)int_drv)->i2c_set_if_mode(1); // wait for transfers on interrupt flag
+
+  _commLink->regIntDrv(GENERAL_GPIO_DRV, FPGA_CTRL_REGS, new gpio_int());
+
+  // Chip drivers
+  LM75A_drv::LM75A_setCommLink(_commLink, LM75A_I2C_DRV);
+  Si570_drv::si570_setCommLink(_commLink, SI571_I2C_DRV, GENERAL_GPIO_DRV);
+
+  // Firmware identification
+  data.wb_addr = FPGA_CTRL_REGS | WB_FMC_STATUS; // FMC status register (HW address)
+
+  if (_commLink->fmc_config_read(&data) != WB_STATUS_OK || data.data_read.empty()) {
+    fprintf(stderr, "%s: no response from board\n", program);
+    return 1;
+  }
+
+  fw_id = data.data_read[0] >> 3;
+
+  if (fw_id != 0x01332A11) {
+    fprintf(stderr, "%s: unsupported firmware ID 0x%x\n", program, fw_id);
+    return 1;
+  }
+
+  if (detach && daemon(0, 0) != 0) {
+    fprintf(stderr, "%s: can't run in background\n", program);
+    return 1;
+  }
+
+  return fmcd_serve(socket_path.c_str(), daemon_cmds, DAEMON_NUM_CMDS);
+}
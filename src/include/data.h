@@ -74,6 +74,68 @@ using namespace std;
 #define IDELAY_TAP(x) ((x & 0x01F) << 18)
 #define IDELAY_UPDATE 0x01
 
+// Status of Wishbone transfer (wb_data.status, returned by Wishbone master drivers)
+// Transient errors may go away when the same request is repeated,
+// the others are caused by the request itself
+enum {
+  WB_STATUS_OK = 0,
+  // transient
+  WB_STATUS_NO_RESPONSE, // no or incomplete response from Wishbone master
+  WB_STATUS_SEND_ERR, // request couldn't be sent (link problem)
+  WB_STATUS_PORT_ERR, // link lost (like USB-serial adapter reset)
+  WB_STATUS_BUS_TIMEOUT, // no access to Wishbone bus
+  // permanent
+  WB_STATUS_ACK_ERR, // err_i or no ack_i (invalid IP core address)
+  WB_STATUS_UNKNOWN_CMD_ERR,
+  WB_STATUS_ADDR_ERR,
+  WB_STATUS_DATA_ERR,
+  WB_STATUS_Q_ERR,
+  WB_STATUS_CMD_ERR,
+  WB_STATUS_CHECK_ERR // batch: polled register didn't reach expected value or error bits set
+};
+
+#define WB_STATUS_TRANSIENT(x) ((x) >= WB_STATUS_NO_RESPONSE && (x) <= WB_STATUS_BUS_TIMEOUT)
+
+// Retry policy for transient errors
+// wait is doubled after each repeat (exponential backoff)
+struct wb_retry {
+
+  int max_repeat; // 0 - don't repeat, error is returned to the caller
+  int backoff_us; // wait before first repeat
+  int backoff_max_us; // limit of the wait
+
+};
+
+// Operation of Wishbone batch (WBMaster_unit::wb_exec)
+enum { WB_OP_WRITE, WB_OP_READ, WB_OP_POLL };
+
+struct wb_op {
+
+  int type;
+  uint32_t addr;
+  uint32_t data; // WB_OP_WRITE - value to write, others - value read
+  // WB_OP_POLL - register is read until (data & mask) == value,
+  // then bits in err_mask have to be 0
+  uint32_t mask;
+  uint32_t value;
+  uint32_t err_mask;
+  int retries; // WB_OP_POLL - additional reads allowed (0 - single check)
+
+};
+
+// Message of combined interface transaction (like Linux i2c_msg)
+// messages are transferred in order with repeated start between them
+#define WB_MSG_RD 0x0001 // read, write otherwise
+#define WB_MSG_PROBE 0x0002 // chip busy check (ack polling), no ack is not reported
+
+struct wb_msg {
+
+  uint32_t addr; // chip address
+  int flags;
+  vector<uint32_t> buf; // data to write, or data read (size = number of bytes to read)
+
+};
+
 struct wb_data {
 
   vector<uint32_t> data_send; // data to send through Wishbone or interface
@@ -85,4 +147,18 @@ struct wb_data {
 
 };
 
+// Transfer run by scheduler together with transfers on other interfaces
+// (commLink::fmc_schedule)
+enum { WB_JOB_SEND, WB_JOB_READ, WB_JOB_SEND_READ, WB_JOB_TRANSFER };
+
+struct wb_job {
+
+  string int_name; // interface (like SI571_I2C_DRV)
+  int type;
+  wb_data data; // WB_JOB_SEND, WB_JOB_READ, WB_JOB_SEND_READ (as for fmc_send etc.)
+  vector<struct wb_msg> msgs; // WB_JOB_TRANSFER (as for fmc_transfer)
+  int status; // result of transfer
+
+};
+
 #endif /* DATA_H_ */
@@ -9,6 +9,10 @@
 
 #include "common.h"
 
+// IDELAY taps are found by link training (ISLA216P_train), values below
+// are used only for channels that fail training (DELAY_LINES_NO_INIT -
+// channel not available, not trained)
+
 // adc0 -0.483ns -> IDELAY_TAP(7)
 // adc1 -0.897ns -> IDELAY_TAP(12)
 // adc2 -0.609ns -> IDELAY_TAP(8)
@@ -12,6 +12,11 @@
 
 using namespace std;
 
+struct wb_data;
+struct wb_msg;
+struct wb_op;
+struct wb_job;
+
 class WBInt_drv {
 public:
 	WBInt_drv() {};
@@ -23,6 +28,19 @@ public:
 	virtual int int_read_data(struct wb_data* data) =0;
 	virtual int int_send_read_data(struct wb_data* data) =0;
 
+	// Combined transaction (messages with repeated start, see struct wb_msg)
+	// return - 0 ok, 1 not supported by interface, other errors
+	virtual int int_transfer(vector<struct wb_msg>& /* msgs */) { return 1; };
+
+	// Split transfer used by scheduler (commLink::fmc_schedule)
+	// int_prepare - operations of transfer, they are run by scheduler
+	// (interleaved with other interfaces), interface stays locked until int_complete
+	// return - 0 ok, 1 not supported (job is run directly)
+	virtual int int_prepare(struct wb_job* /* job */, vector<struct wb_op>& /* ops */) { return 1; };
+	// err - result of operations
+	// return - result of transfer
+	virtual int int_complete(struct wb_job* /* job */, vector<struct wb_op>& /* ops */, int err) { return err; };
+
 };
 
 #endif /* WBINT_DRV_H_ */
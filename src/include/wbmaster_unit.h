@@ -12,14 +12,35 @@
 
 using namespace std;
 
+struct wb_data;
+struct wb_op;
+
 class WBMaster_unit {
 public:
 	WBMaster_unit() {};
 	virtual ~WBMaster_unit() {};
 
+	// return - 0 ok, WB_STATUS_* error code (also stored in data->status)
 	virtual int wb_send_data(struct wb_data* data) =0;
 	virtual int wb_read_data(struct wb_data* data) =0;
 
+	// Executes batch of operations in order (see struct wb_op, data.h)
+	// stops at first error, read values are stored in ops[i].data
+	// default - one request per operation, masters with faster path override it
+	// return - 0 ok, WB_STATUS_* error code
+	virtual int wb_exec(vector<struct wb_op>& ops);
+
+	// minimum time between two operations reaching the bus (us), 0 - unknown
+	// (lets interface drivers skip status polling the link is slower than)
+	virtual int wb_op_time_us() { return 0; };
+
+protected:
+
+	// single operation of batch (polling included)
+	int wb_exec_op(struct wb_op& op);
+	// WB_OP_POLL: -1 - condition not met yet, 0 - ok, WB_STATUS_CHECK_ERR - error bits set
+	static int wb_poll_status(const struct wb_op& op);
+
 };
 
 #endif /* WBMASTER_UNIT_H_ */
@@ -9,6 +9,8 @@ gpio_int::gpio_int() {
 
 	//cout << showbase << internal << setfill('0') << setw(8);
 
+	batch = 0;
+
 }
 
 // core_addr not used
@@ -25,14 +27,170 @@ int gpio_int::int_reg(WBMaster_unit* wb_master, uint32_t core_addr) {
 // err != 0, there was error (mostly -EIO)
 int gpio_int::int_send_data(struct wb_data* data) {
 	
-	wb_master->wb_send_data(data);
+	return wb_master->wb_send_data(data);
+}
+
+int gpio_int::int_read_data(struct wb_data* data) {
+
+	return wb_master->wb_read_data(data);
+}
+
+// field value is aligned to lowest bit of mask
+static uint32_t field_shift(uint32_t mask) {
+
+	uint32_t shift = 0;
+
+	while (mask != 0 && (mask & 0x1) == 0) {
+		mask >>= 1;
+		shift++;
+	}
+
+	return shift;
+}
+
+int gpio_int::gpio_write(uint32_t addr, uint32_t value) {
+
+	wb_data data;
+	int err;
+
+	data.wb_addr = addr;
+	data.data_send.push_back(value);
+
+	err = wb_master->wb_send_data(&data);
+
+	if (err) {
+		// value in register is not known
+		shadow.erase(addr);
+		return err;
+	}
+
+	shadow[addr] = value;
 
 	return 0;
 }
 
-int gpio_int::int_read_data(struct wb_data* data) {
+int gpio_int::gpio_shadow(uint32_t addr, uint32_t* value) {
+
+	map<uint32_t, uint32_t>::iterator reg_it;
+	wb_data data;
+	int err;
+
+	reg_it = pending.find(addr);
+	if (reg_it != pending.end()) {
+		*value = reg_it->second;
+		return 0;
+	}
+
+	reg_it = shadow.find(addr);
+	if (reg_it != shadow.end()) {
+		*value = reg_it->second;
+		return 0;
+	}
+
+	data.wb_addr = addr;
+	err = wb_master->wb_read_data(&data);
+
+	if (err == 0 && data.data_read.size() == 0)
+		err = WB_STATUS_NO_RESPONSE;
+
+	if (err)
+		return err;
+
+	shadow[addr] = data.data_read[0];
+	*value = data.data_read[0];
 
-	wb_master->wb_read_data(data);
-	
 	return 0;
 }
+
+int gpio_int::gpio_get(const struct gpio_field& field, uint32_t* val) {
+
+	wb_data data;
+	int err;
+
+	data.wb_addr = field.addr;
+	err = wb_master->wb_read_data(&data);
+
+	if (err == 0 && data.data_read.size() == 0)
+		err = WB_STATUS_NO_RESPONSE;
+
+	if (err)
+		return err;
+
+	*val = (data.data_read[0] & field.mask) >> field_shift(field.mask);
+
+	return 0;
+}
+
+int gpio_int::gpio_set(const struct gpio_field& field, uint32_t val) {
+
+	uint32_t value;
+	int err;
+
+	err = gpio_shadow(field.addr, &value);
+	if (err)
+		return err;
+
+	value = (value & ~field.mask) | ((val << field_shift(field.mask)) & field.mask);
+
+	if (batch) {
+		pending[field.addr] = value;
+		return 0;
+	}
+
+	// nothing changed
+	if (shadow[field.addr] == value)
+		return 0;
+
+	return gpio_write(field.addr, value);
+}
+
+int gpio_int::gpio_pulse(const struct gpio_field& field, uint32_t val, uint32_t back, int wait_us) {
+
+	int err;
+
+	err = gpio_set(field, val);
+	if (err)
+		return err;
+
+	// pulse must be visible on output
+	if (batch) {
+		err = gpio_commit();
+		gpio_begin();
+		if (err)
+			return err;
+	}
+
+	usleep(wait_us);
+
+	return gpio_set(field, back);
+}
+
+void gpio_int::gpio_begin() {
+
+	batch = 1;
+}
+
+int gpio_int::gpio_commit() {
+
+	map<uint32_t, uint32_t>::iterator reg_it, shadow_it;
+	int err = 0;
+
+	batch = 0;
+
+	for (reg_it = pending.begin(); reg_it != pending.end() && err == 0; reg_it++) {
+
+		shadow_it = shadow.find(reg_it->first);
+
+		if (shadow_it == shadow.end() || shadow_it->second != reg_it->second)
+			err = gpio_write(reg_it->first, reg_it->second);
+	}
+
+	pending.clear();
+
+	return err;
+}
+
+void gpio_int::gpio_invalidate(uint32_t addr) {
+
+	shadow.erase(addr);
+}
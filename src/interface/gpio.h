@@ -8,6 +8,14 @@
 
 #include "data.h"
 
+#include <map>
+
+// Field of control register (like function pin in WB_CLK_CTRL)
+struct gpio_field {
+  uint32_t addr; // Wishbone register address
+  uint32_t mask; // field bits in register
+};
+
 class gpio_int : public WBInt_drv {
 public:
 
@@ -20,8 +28,31 @@ public:
   int int_read_data(struct wb_data* data);
   int int_send_read_data(struct wb_data* data) { cout << "GPIO not implemented method" << endl; return 1; };
 
+  // Field access, register values are kept in shadow copy
+  // (register is read only on first write to it)
+  // val - field value (not shifted)
+  int gpio_get(const struct gpio_field& field, uint32_t* val); // always reads register (status bits)
+  int gpio_set(const struct gpio_field& field, uint32_t val);
+  int gpio_clear(const struct gpio_field& field) { return gpio_set(field, 0); };
+  // field = val, wait_us, field = back (like reset pulse)
+  int gpio_pulse(const struct gpio_field& field, uint32_t val, uint32_t back, int wait_us);
+
+  // Updates between gpio_begin and gpio_commit are merged, one write per register
+  void gpio_begin();
+  int gpio_commit();
+
+  // register changed outside of this driver, read it again on next update
+  void gpio_invalidate(uint32_t addr);
+
 private:
 
+  int gpio_write(uint32_t addr, uint32_t value);
+  int gpio_shadow(uint32_t addr, uint32_t* value); // value of register from shadow
+
+  map<uint32_t, uint32_t> shadow; // register address -> value
+  map<uint32_t, uint32_t> pending; // updates not written yet (in batch)
+  int batch;
+
   WBMaster_unit* wb_master;
   uint32_t core_addr;
   wb_data data_;
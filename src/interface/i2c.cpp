@@ -6,12 +6,50 @@
 //============================================================================
 #include "i2c.h"
 
+#include <sys/time.h>
+#include <algorithm>
+
 #define MAX_REPEAT 10
 
+// bits on I2C bus per byte (8 data + ack)
+#define I2C_BYTE_BITS 9
+// status reads allowed when polling in batch
+#define I2C_POLL_RETRIES (10 * MAX_REPEAT)
+
+// Waiting for end of transfer
+// status is read again without sleeping if transfer should end in less than this
+#define I2C_SPIN_US 50
+// status reads without sleeping after expected end of transfer
+#define I2C_SPIN_MAX 4
+// transfer taking longer is an error (at least 10 ms)
+#define I2C_TIMEOUT_BYTES 100
+#define I2C_TIMEOUT_MIN_US 10000
+
+static int elapsed_us(const struct timeval* start) {
+
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+
+	return (now.tv_sec - start->tv_sec) * 1000000 + (now.tv_usec - start->tv_usec);
+}
+
 i2c_int::i2c_int() {
 
 	//cout << showbase << internal << setfill('0') << setw(8);
 
+	byte_time_us = 0;
+	xfer_time_us = 0;
+	if_mode = 0;
+
+	pthread_mutex_init(&lock, NULL);
+
+}
+
+i2c_int::~i2c_int() {
+
+	pthread_mutex_destroy(&lock);
+
 }
 
 int i2c_int::int_reg(WBMaster_unit* wb_master, uint32_t core_addr) {
@@ -25,40 +63,57 @@ int i2c_int::int_reg(WBMaster_unit* wb_master, uint32_t core_addr) {
 
 }
  
+// Waits for end of byte transfer (TIP = 0, or IF = 1 in interrupt flag mode)
+// Sleeps until transfer is expected to end (average of measured transfers),
+// then reads status without sleeping for a while, then backs off
 int i2c_int::i2c_check_transfer(int ack_check) {
 
+	struct timeval start;
+	uint32_t done_mask = if_mode ? I2C_SR_IF : I2C_SR_TIP;
+	uint32_t done_value = if_mode ? I2C_SR_IF : 0;
 	int err = 0;
-	int repeat = 0;
+	int spin = 0;
+	int elapsed, timeout_us;
+
+	timeout_us = std::max(I2C_TIMEOUT_BYTES * byte_time_us, I2C_TIMEOUT_MIN_US);
+
+	gettimeofday(&start, NULL);
 
 	// wait for TIP to negate
-	while(1) { // TIP = 0, transfer complete
+	while(1) {
 
-		data_.wb_addr = core_addr | I2C_SR;
-		wb_master->wb_read_data(&data_);
+		err = wb_read(I2C_SR);
+		if (err)
+			return err;
 
-		if ( (data_.data_read[0] & I2C_SR_TIP) == 0)
-			break;
+		elapsed = elapsed_us(&start);
 
-		usleep(1000);
-		repeat++;
+		if ( (data_.data_read[0] & done_mask) == done_value)
+			break;
 
-		if (repeat > MAX_REPEAT) {
+		if (elapsed > timeout_us) {
 			// write status register
 			cout << "i2c_drv: i2c TIP error" << endl;
 			err = 1;
 			return err;
 		}
+
+		if (xfer_time_us - elapsed > I2C_SPIN_US)
+			usleep(xfer_time_us - elapsed);
+		else if (spin++ >= I2C_SPIN_MAX)
+			usleep(std::max(byte_time_us, 1));
 	}
 
+	// moving average of transfer time (seen from host, link latency included)
+	xfer_time_us = (7 * xfer_time_us + elapsed) / 8;
+
 	if (ack_check == 0) // not checking if core is in reading mode
 		return err;
 
-	// check RxAck (should be 0)
-	data_.wb_addr = core_addr | I2C_SR;
-	wb_master->wb_read_data(&data_);
-
+	// check RxAck (should be 0), valid in the same status read
 	if ((data_.data_read[0] & I2C_SR_RXACK) != 0) {
-		cout << "i2c_drv: i2c ack err" << endl;
+		if (ack_check == 1)
+			cout << "i2c_drv: i2c ack err" << endl;
 		return 1;
 	}
 
@@ -66,177 +121,428 @@ int i2c_int::i2c_check_transfer(int ack_check) {
 
 }
 
+// Interrupt flag mode - end of transfer is signalled by IF,
+// flag is acknowledged (IACK) with next command
+int i2c_int::i2c_set_if_mode(int enable) {
+
+	int err;
+
+	err = wb_write(I2C_CTR, I2C_CTR_EN | (enable ? I2C_CTR_INT : 0));
+	if (err)
+		return err;
+
+	// clear flag left by previous transfers
+	err = wb_write(I2C_CR, I2C_CR_IACK);
+	if (err)
+		return err;
+
+	if_mode = enable;
+
+	return 0;
+}
+
+// command register value
+uint32_t i2c_int::i2c_cmd(uint32_t cmd) {
+
+	return if_mode ? (cmd | I2C_CR_IACK) : cmd;
+}
+
 int i2c_int::i2c_init(int sys_freq, int i2c_freq)
 {
 	/* set frequency of i2c to I2C_FREQ (from SYS_FREQ) */
 	float f_freq = (float)sys_freq/(5.0 * (float)i2c_freq) - 1.0;
 	uint16_t freq = f_freq;
+	int err;
 
 	//cout << showbase << internal << setfill('0');
 
 	printf("i2c_drv: freq: 0x%04x, core_addr: 0x%08x\n", freq, core_addr);
 
-	data_.data_send[0] = freq & 0xFF;
-	data_.wb_addr = core_addr | I2C_PRER_LO;
-	wb_master->wb_send_data(&data_);
+	err = wb_write(I2C_PRER_LO, freq & 0xFF);
+	if (err)
+		return err;
 
-	data_.data_send[0] = (freq & 0xFF00) >> 8;
-	data_.wb_addr = core_addr | I2C_PRER_HI;
-	wb_master->wb_send_data(&data_);
+	err = wb_write(I2C_PRER_HI, (freq & 0xFF00) >> 8);
+	if (err)
+		return err;
 
-	data_.wb_addr = core_addr | I2C_PRER_LO;
-	wb_master->wb_read_data(&data_);
+	err = wb_read(I2C_PRER_LO);
+	if (err)
+		return err;
 	cout << "i2c_drv: I2C_PRER_LO: 0x" << std::hex << data_.data_read[0] << endl;
 
-	data_.wb_addr = core_addr | I2C_PRER_HI;
-	wb_master->wb_read_data(&data_);
+	err = wb_read(I2C_PRER_HI);
+	if (err)
+		return err;
 	cout << "i2c_drv: I2C_PRER_HI: 0x" << std::hex << data_.data_read[0] << endl;
 
 	// enable core
-	data_.data_send[0] = I2C_CTR_EN;
-	data_.wb_addr = core_addr | I2C_CTR;
-	wb_master->wb_send_data(&data_);
+	err = wb_write(I2C_CTR, I2C_CTR_EN);
+	if (err)
+		return err;
 
-	data_.wb_addr = core_addr | I2C_CTR;
-	wb_master->wb_read_data(&data_);
+	err = wb_read(I2C_CTR);
+	if (err)
+		return err;
 	cout << "i2c_drv: I2C_CTR: 0x" << std::hex << data_.data_read[0] << endl;
 
-	data_.wb_addr = core_addr | I2C_SR;
-	wb_master->wb_read_data(&data_);
+	err = wb_read(I2C_SR);
+	if (err)
+		return err;
 	cout << "i2c_drv: I2C_SR: 0x" << std::hex << data_.data_read[0] << endl;
 
-	i2c_mode_stop = 1;
+	byte_time_us = (I2C_BYTE_BITS * 1000000 + i2c_freq - 1) / i2c_freq;
+	xfer_time_us = byte_time_us;
+	if_mode = 0;
 
 	return 0;
 }
 
-// send data to i2c chip
+// Wishbone access to core registers
 // err = 0, everything ok
-// err != 0, there was error (mostly -EIO)
-int i2c_int::int_send_data(struct wb_data* data) {
-	
-	unsigned int i, err = 0, num_data;
+// err != 0, Wishbone master error (WB_STATUS_*)
+int i2c_int::wb_write(uint32_t reg, uint32_t value) {
 
-	num_data = data->data_send.size();
+	data_.data_send[0] = value;
+	data_.wb_addr = core_addr | reg;
 
-	// send address in write mode (write = 0x0, read = 0x1)
-	data_.data_send[0] = (data->extra[0] << 1) & 0xFE;
-	data_.wb_addr = core_addr | I2C_TXR;
-	wb_master->wb_send_data(&data_);
+	return wb_master->wb_send_data(&data_);
+}
 
-	// start transfer
-	data_.data_send[0] = I2C_CR_STA | I2C_CR_WR;
-	data_.wb_addr = core_addr | I2C_CR;
-	wb_master->wb_send_data(&data_);
+int i2c_int::wb_read(uint32_t reg) {
 
-	err = i2c_check_transfer(1);
-	if (err)
-		return err;	
+	int err;
 
-	// send data
-	for (i = 0; i < num_data; i++) {
+	data_.wb_addr = core_addr | reg;
+	err = wb_master->wb_read_data(&data_);
 
-		// write data to transmit register
-		data_.data_send[0] = data->data_send[i];
-		data_.wb_addr = core_addr | I2C_TXR;
-		wb_master->wb_send_data(&data_);
+	if (err == 0 && data_.data_read.size() == 0)
+		err = WB_STATUS_NO_RESPONSE;
 
-		// if this is last byte, then stop transfer
-		if (i == (num_data - 1) && i2c_mode_stop == 1) {// used for repeated start
-			data_.data_send[0] = I2C_CR_STO | I2C_CR_WR;
-			data_.wb_addr = core_addr | I2C_CR;
-			wb_master->wb_send_data(&data_);
-		}
-		else {
-			data_.data_send[0] = I2C_CR_WR;
-			data_.wb_addr = core_addr | I2C_CR;
-			wb_master->wb_send_data(&data_);
-		}
+	return err;
+}
+
+// Message by message, every byte checked separately (used when batch fails)
+// err = 0, everything ok
+// err != 0, there was error (mostly -EIO)
+int i2c_int::i2c_transfer_slow(vector<struct wb_msg>& msgs) {
+
+	unsigned int k, i, num_data;
+	int err = 0, rd, last, stop;
+
+	for (k = 0; k < msgs.size(); k++) {
+
+		rd = (msgs[k].flags & WB_MSG_RD) != 0;
+		last = (k == msgs.size() - 1);
+		num_data = msgs[k].buf.size();
 
-		err = i2c_check_transfer(1);
+		// send address (write = 0x0, read = 0x1)
+		err = wb_write(I2C_TXR, ((msgs[k].addr << 1) & 0xFE) | rd);
 		if (err)
 			return err;
 
-	}
+		// (repeated) start
+		err = wb_write(I2C_CR, i2c_cmd(I2C_CR_STA | I2C_CR_WR));
+		if (err)
+			return err;
 
-	// transmission done
-	//cout << "i2c_drv: i2c send transfer done" << endl;
+		err = i2c_check_transfer((msgs[k].flags & WB_MSG_PROBE) ? 2 : 1);
+		if (err) {
+			// chip is busy, release the bus for next probe
+			if (msgs[k].flags & WB_MSG_PROBE)
+				wb_write(I2C_CR, i2c_cmd(I2C_CR_STO));
+			return err;
+		}
+
+		// nothing to transfer (like chip presence check)
+		if (num_data == 0 && last) {
+			err = wb_write(I2C_CR, i2c_cmd(I2C_CR_STO));
+			if (err)
+				return err;
+		}
+
+		for (i = 0; i < num_data; i++) {
+
+			// if this is last byte, then stop transfer
+			stop = (last && i == (num_data - 1)) ? I2C_CR_STO : 0;
+
+			if (rd) {
+				// last byte of read is not acknowledged
+				err = wb_write(I2C_CR, i2c_cmd(stop | I2C_CR_RD | (i == (num_data - 1) ? I2C_CR_ACK : 0)));
+				if (err)
+					return err;
+
+				err = i2c_check_transfer(0);
+				if (err)
+					return err;
+
+				// store data
+				err = wb_read(I2C_RXR);
+				if (err)
+					return err;
+				msgs[k].buf[i] = data_.data_read[0];
+			}
+			else {
+				// write data to transmit register
+				err = wb_write(I2C_TXR, msgs[k].buf[i]);
+				if (err)
+					return err;
+
+				err = wb_write(I2C_CR, i2c_cmd(stop | I2C_CR_WR));
+				if (err)
+					return err;
+
+				err = i2c_check_transfer(1);
+				if (err)
+					return err;
+			}
+		}
+	}
 
 	return err;
 }
 
-int i2c_int::int_read_data(struct wb_data* data) {
+// Wait for end of byte transfer (TIP = 0), with ack_check RxAck has to be 0
+// Every operation of batch reaches the bus at least wb_op_time_us after the
+// previous one, if byte is transferred faster there is nothing to poll for
+void i2c_int::batch_wait(vector<struct wb_op>& ops, int ack_check) {
+
+	struct wb_op op;
+	int op_time = wb_master->wb_op_time_us();
+
+	op.type = WB_OP_POLL;
+	op.addr = core_addr | I2C_SR;
+	op.data = 0;
+	op.mask = if_mode ? I2C_SR_IF : I2C_SR_TIP;
+	op.value = if_mode ? I2C_SR_IF : 0;
+	op.err_mask = ack_check ? I2C_SR_RXACK : 0;
+	op.retries = I2C_POLL_RETRIES;
+
+	if (op_time > 0 && byte_time_us > 0 && byte_time_us < op_time) {
+		// transfer is over by the time next operation arrives
+		if (ack_check == 0)
+			return;
+		// single status read to check RxAck
+		op.retries = 0;
+	}
 
-	unsigned int i, err = 0, num_data;
-	data->data_read.clear();
+	ops.push_back(op);
+}
 
-	num_data = data->extra[1];
-	
-	// send address in read mode (write = 0x0, read = 0x1)
-	data_.data_send[0] = (data->extra[0] << 1)  | 0x1;
-	data_.wb_addr = core_addr | I2C_TXR;
-	wb_master->wb_send_data(&data_);
+static void batch_write(vector<struct wb_op>& ops, uint32_t addr, uint32_t value) {
 
-	// start transfer
-	data_.data_send[0] = I2C_CR_STA | I2C_CR_WR;
-	data_.wb_addr = core_addr | I2C_CR;
-	wb_master->wb_send_data(&data_);
+	struct wb_op op;
 
-	err = i2c_check_transfer(1);
-	if (err)
-		return err;	
+	op.type = WB_OP_WRITE;
+	op.addr = addr;
+	op.data = value;
+	op.mask = op.value = op.err_mask = 0;
+	op.retries = 0;
 
-	// read data and store it in data_array
-	for (i = 0; i < num_data; i++) {
+	ops.push_back(op);
+}
 
-		// if this is last byte, then stop transfer
-		if (i == (num_data - 1)) {
-			data_.data_send[0] = I2C_CR_STO | I2C_CR_RD | I2C_CR_ACK;
-			data_.wb_addr = core_addr | I2C_CR;
-			wb_master->wb_send_data(&data_);
-		}
-		else {
-			data_.data_send[0] = I2C_CR_RD | !I2C_CR_ACK;
-			data_.wb_addr = core_addr | I2C_CR;
-			wb_master->wb_send_data(&data_);
+// Whole transaction as one batch, same sequence as i2c_transfer_slow
+void i2c_int::batch_msgs(vector<struct wb_op>& ops, const vector<struct wb_msg>& msgs) {
+
+	struct wb_op op;
+	unsigned int k, i, num_data;
+	uint32_t stop;
+	int rd, last;
+
+	op.type = WB_OP_READ;
+	op.addr = core_addr | I2C_RXR;
+	op.data = 0;
+	op.mask = op.value = op.err_mask = 0;
+	op.retries = 0;
+
+	for (k = 0; k < msgs.size(); k++) {
+
+		rd = (msgs[k].flags & WB_MSG_RD) != 0;
+		last = (k == msgs.size() - 1);
+		num_data = msgs[k].buf.size();
+
+		// address, (repeated) start
+		batch_write(ops, core_addr | I2C_TXR, ((msgs[k].addr << 1) & 0xFE) | rd);
+		batch_write(ops, core_addr | I2C_CR, i2c_cmd(I2C_CR_STA | I2C_CR_WR));
+		batch_wait(ops, 1);
+
+		if (num_data == 0 && last)
+			batch_write(ops, core_addr | I2C_CR, i2c_cmd(I2C_CR_STO));
+
+		for (i = 0; i < num_data; i++) {
+
+			stop = (last && i == (num_data - 1)) ? I2C_CR_STO : 0;
+
+			if (rd) {
+				batch_write(ops, core_addr | I2C_CR,
+						i2c_cmd(stop | I2C_CR_RD | (i == (num_data - 1) ? I2C_CR_ACK : 0)));
+				batch_wait(ops, 0);
+				ops.push_back(op);
+			}
+			else {
+				batch_write(ops, core_addr | I2C_TXR, msgs[k].buf[i]);
+				batch_write(ops, core_addr | I2C_CR, i2c_cmd(stop | I2C_CR_WR));
+				batch_wait(ops, 1);
+			}
 		}
+	}
+}
 
-		err = i2c_check_transfer(0);
-		if (err)
+// Read bytes (RXR reads) of executed batch are stored in buffers of read messages
+// err - result of batch, if it failed (no ack, lost response) transaction is
+// repeated message by message to find the error
+int i2c_int::batch_done(vector<struct wb_op>& ops, vector<struct wb_msg>& msgs, int err) {
+
+	unsigned int i, k, n;
+
+	if (err) {
+		// transaction broken somewhere in the middle, release the bus
+		wb_write(I2C_CR, i2c_cmd(I2C_CR_STO));
+
+		// busy chip (no ack) is expected result of probe
+		if (msgs.size() == 1 && (msgs[0].flags & WB_MSG_PROBE))
 			return err;
 
-		// store data
-		data_.wb_addr = core_addr | I2C_RXR;
-		wb_master->wb_read_data(&data_);
-		data->data_read.push_back(data_.data_read[0]);
+		usleep(1000);
+		return i2c_transfer_slow(msgs);
+	}
+
+	k = 0;
+	n = 0;
+
+	for (i = 0; i < ops.size(); i++) {
+
+		if (ops[i].type != WB_OP_READ)
+			continue;
 
+		// next read message with space left
+		while (!(msgs[k].flags & WB_MSG_RD) || n == msgs[k].buf.size()) {
+			k++;
+			n = 0;
+		}
+
+		msgs[k].buf[n++] = ops[i].data;
+	}
+
+	return 0;
+}
+
+// Messages of wb_data request (extra0 - i2c addr, extra1 - number of data read)
+// send - write, read - read, send + read - write then read (repeated start)
+static void data_msgs(int type, struct wb_data* data, vector<struct wb_msg>& msgs) {
+
+	struct wb_msg msg;
+
+	msgs.clear();
+	msg.addr = data->extra[0];
+
+	if (type == WB_JOB_SEND || type == WB_JOB_SEND_READ) {
+		msg.flags = 0;
+		msg.buf = data->data_send;
+		msgs.push_back(msg);
 	}
-	
-	//dev_info(fmc->hwdev, "i2c_drv: i2c read transfer end\n");
+
+	if (type == WB_JOB_READ || type == WB_JOB_SEND_READ) {
+		msg.flags = WB_MSG_RD;
+		msg.buf.assign(data->extra[1], 0);
+		msgs.push_back(msg);
+	}
+}
+
+// Transaction is executed as one batch
+// Transactions on one core are serialized, different cores may be used in parallel
+int i2c_int::int_transfer(vector<struct wb_msg>& msgs) {
+
+	vector<struct wb_op> ops;
+	int err;
+
+	if (msgs.size() == 0)
+		return 0;
+
+	pthread_mutex_lock(&lock);
+
+	batch_msgs(ops, msgs);
+
+	err = wb_master->wb_exec(ops);
+	err = batch_done(ops, msgs, err);
+
+	pthread_mutex_unlock(&lock);
 
 	return err;
 }
 
-// write reg pointer and then read data
-int i2c_int::int_send_read_data(struct wb_data* data) {
+// Same batch as int_transfer, executed by scheduler, core is locked until int_complete
+int i2c_int::int_prepare(struct wb_job* job, vector<struct wb_op>& ops) {
+
+	if (job->type != WB_JOB_TRANSFER)
+		data_msgs(job->type, &job->data, job->msgs);
+
+	pthread_mutex_lock(&lock);
+
+	batch_msgs(ops, job->msgs);
 
-	int err = 0; 
+	return 0;
+}
+
+int i2c_int::int_complete(struct wb_job* job, vector<struct wb_op>& ops, int err) {
 
-	i2c_mode_stop = 0;
+	if (job->msgs.size() > 0)
+		err = batch_done(ops, job->msgs, err);
+
+	pthread_mutex_unlock(&lock);
 
-	err = int_send_data(data);
 	if (err)
 		return err;
 
-    err = int_read_data(data);
+	if (job->type == WB_JOB_READ || job->type == WB_JOB_SEND_READ)
+		job->data.data_read = job->msgs.back().buf;
+
+	return 0;
+}
+
+int i2c_int::int_send_data(struct wb_data* data) {
+
+	vector<struct wb_msg> msgs;
+
+	data_msgs(WB_JOB_SEND, data, msgs);
+
+	return int_transfer(msgs);
+}
+
+int i2c_int::int_read_data(struct wb_data* data) {
+
+	vector<struct wb_msg> msgs;
+	int err;
+
+	data->data_read.clear();
+
+	data_msgs(WB_JOB_READ, data, msgs);
+
+	err = int_transfer(msgs);
 	if (err)
 		return err;
 
-	i2c_mode_stop = 1;	
+	data->data_read = msgs[0].buf;
 
-	// transfer done
-	//dev_info(fmc->hwdev, "i2c_drv: i2c write read transfer done\n");
+	return 0;
+}
 
-	return err;
+// write reg pointer and then read data (repeated start)
+int i2c_int::int_send_read_data(struct wb_data* data) {
 
+	vector<struct wb_msg> msgs;
+	int err;
+
+	data->data_read.clear();
+
+	data_msgs(WB_JOB_SEND_READ, data, msgs);
+
+	err = int_transfer(msgs);
+	if (err)
+		return err;
+
+	data->data_read = msgs[1].buf;
+
+	return 0;
 }
@@ -9,6 +9,8 @@
 
 #include "data.h"
 
+#include <pthread.h>
+
 /* I2C register */
 #define I2C_PRER_LO (0x00 << WB_GR_SHIFT) // clock
 #define I2C_PRER_HI (0x01 << WB_GR_SHIFT)
@@ -45,9 +47,12 @@ public:
 
   // proper destructor implementation!
   i2c_int();
-  ~i2c_int() {};
+  ~i2c_int();
 
   int i2c_init(int sys_freq, int i2c_freq); // config frequency (in Hz)
+  // 1 - wait for interrupt flag (I2C_SR_IF) instead of TIP, 0 - TIP (default)
+  // call after i2c_init
+  int i2c_set_if_mode(int enable);
 
   int int_reg(WBMaster_unit* wb_master, uint32_t core_addr); // used by commLink
 
@@ -57,15 +62,43 @@ public:
   int int_read_data(struct wb_data* data);
   int int_send_read_data(struct wb_data* data);
 
+  // any number of write/ read messages with repeated start between them,
+  // stop after the last one; read messages get buffer filled
+  int int_transfer(vector<struct wb_msg>& msgs);
+
+  // transfer run by scheduler (commLink::fmc_schedule)
+  int int_prepare(struct wb_job* job, vector<struct wb_op>& ops);
+  int int_complete(struct wb_job* job, vector<struct wb_op>& ops, int err);
+
 private:
 
+  // ack_check - 0 not checked, 1 checked, 2 checked, no ack not reported (WB_MSG_PROBE)
   int i2c_check_transfer(int ack_check);
+  uint32_t i2c_cmd(uint32_t cmd);
+
+  // Batched transactions - whole I2C transaction is one batch of Wishbone
+  // operations (WBMaster_unit::wb_exec), status is polled only if the link
+  // is faster than byte transfer on I2C bus
+  void batch_wait(vector<struct wb_op>& ops, int ack_check);
+  void batch_msgs(vector<struct wb_op>& ops, const vector<struct wb_msg>& msgs);
+  int batch_done(vector<struct wb_op>& ops, vector<struct wb_msg>& msgs, int err);
+
+  // Per-byte transaction (every access checked separately)
+  // used when batch fails
+  int i2c_transfer_slow(vector<struct wb_msg>& msgs);
+
+  // core register access, read value is in data_.data_read[0]
+  int wb_write(uint32_t reg, uint32_t value);
+  int wb_read(uint32_t reg);
 
   WBMaster_unit* wb_master;
   uint32_t core_addr;
-  int i2c_mode_stop; // 1 - normal stop after write, 0 - don't send stop (used for repeated start)
+  int byte_time_us; // transfer of byte + ack on I2C bus
+  int xfer_time_us; // measured transfer time (moving average)
+  int if_mode;
 
   wb_data data_;
+  pthread_mutex_t lock; // one transaction at a time on this core
 
 };
 
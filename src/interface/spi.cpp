@@ -7,15 +7,35 @@
 //============================================================================
 #include "spi.h"
 
+#include <algorithm>
+
 enum { MODE_WRITE, MODE_READ, MODE_WRITE_READ };
 
 #define MAX_REPEAT 10
-#define REGS_ADDR_MULTIPLY 4
+// CTRL reads allowed when polling GO_BSY in batch
+#define SPI_POLL_RETRIES (10 * MAX_REPEAT)
+#define SPI_CTRL_CHAR_LEN 0x7F
+// char_len = 0 transfers whole shift register
+#define SPI_MAX_BITS 128
 
 spi_int::spi_int() {
 
 	//cout << showbase << internal << setfill('0') << setw(8);
 
+	ctrl_cfg = 0;
+	sclk_freq = 0;
+	ss_cache = 0;
+	bidir_cache = 0;
+	cache_valid = 0;
+
+	pthread_mutex_init(&lock, NULL);
+
+}
+
+spi_int::~spi_int() {
+
+	pthread_mutex_destroy(&lock);
+
 }
 
 int spi_int::int_reg(WBMaster_unit* wb_master, uint32_t core_addr) {
@@ -34,140 +54,266 @@ int spi_int::spi_init(int sys_freq, int spi_freq, int config)
 	/* set frequency of SPI to SPI_BIDIR_FREQ (from SYS_FREQ) */
 	float f_freq = (float)sys_freq/(2.0 * (float)spi_freq) - 1.0;
 	uint16_t freq = f_freq;
+	int err;
 
 	//cout << "freq: " << f_freq << " " << freq << " " << hex << freq << endl;
 
-	data_.data_send[0] = freq;
-	data_.wb_addr = core_addr | SPI_BIDIR_DIVIDER;
-	wb_master->wb_send_data(&data_);
+	err = wb_write(SPI_BIDIR_DIVIDER, freq);
+	if (err)
+		return err;
 
-	data_.wb_addr = core_addr | SPI_BIDIR_DIVIDER;
-	wb_master->wb_read_data(&data_);
+	err = wb_read(SPI_BIDIR_DIVIDER);
+	if (err)
+		return err;
 
 	cout << "spi_drv: spi_divider: 0x" << hex << data_.data_read[0] << endl;
 
 	// write config data
-	data_.data_send[0] = config;
-	data_.wb_addr = core_addr | SPI_BIDIR_CTRL;
-	wb_master->wb_send_data(&data_);
+	err = wb_write(SPI_BIDIR_CTRL, config);
+	if (err)
+		return err;
 
-	data_.wb_addr = core_addr | SPI_BIDIR_CTRL;
-	wb_master->wb_read_data(&data_);
+	err = wb_read(SPI_BIDIR_CTRL);
+	if (err)
+		return err;
 
 	cout << "spi_drv: spi_ctrl: 0x" << hex << data_.data_read[0] << endl;
 
+	ctrl_cfg = data_.data_read[0] & ~(SPI_CTRL_CHAR_LEN | SPI_BIDIR_CTRL_GO_BSY);
+
 	// turn off bidir mode
-	data_.data_send[0] = 0x00;
-	data_.wb_addr = core_addr | SPI_BIDIR_CFG_BIDIR;
-	wb_master->wb_send_data(&data_);
+	err = wb_write(SPI_BIDIR_CFG_BIDIR, 0x00);
+	if (err)
+		return err;
+
+	// SCLK from divider
+	sclk_freq = sys_freq / (2 * (freq + 1));
+	cache_valid = 0;
 
 	return 0;
 }
 
-int spi_int::spi_transfer(int mode, struct wb_data* data) {
+int spi_int::spi_set_read_mode(uint32_t chip_select, int tx_bits) {
 
-	unsigned int i, err, repeat = 0;
-	data->data_read.clear();
+	if (tx_bits < 0 || tx_bits > SPI_CTRL_CHAR_LEN) {
+		cout << "spi_drv: wrong turnaround bit: " << dec << tx_bits << endl;
+		return 1;
+	}
 
-	data_.wb_addr = core_addr | SPI_BIDIR_CTRL;
-	wb_master->wb_read_data(&data_);
-	uint32_t config = data_.data_read[0];
+	pthread_mutex_lock(&lock);
 
-//cout << "cfg: " << hex << config << endl;
+	if (tx_bits == 0)
+		read_mode.erase(chip_select);
+	else
+		read_mode[chip_select] = tx_bits;
 
-	// chip_addr - SS line
-	data_.data_send[0] = data->extra[0];
-	data_.wb_addr = core_addr | SPI_BIDIR_SS;
-	wb_master->wb_send_data(&data_);
+	pthread_mutex_unlock(&lock);
 
-	if (data->extra[1] > 0x7F) {
-		cout << "spi_drv: spi char len error" << endl;
-		return 1;
-	}
+	return 0;
+}
 
-	//cout << "data send spi1: " << hex << data->data_send[0] << endl;
-	//cout << "size " << data->data_send.size() << endl;
+static void batch_op(vector<struct wb_op>& ops, int type, uint32_t addr, uint32_t value) {
 
-	// write data to TX regs
-	if (mode == MODE_WRITE || mode == MODE_WRITE_READ) {
-		for (i = 0; i < data->data_send.size(); i++) {
-			//cout << "data send spi: " << hex << data->data_send[i] << endl;
-			data_.data_send[0] = data->data_send[i];
-			data_.wb_addr = core_addr | (SPI_BIDIR_TX0 + REGS_ADDR_MULTIPLY*i); // i or 4*i, depending on address space (0,1,2,3 or 0,4,8,c)
-			wb_master->wb_send_data(&data_);
+	struct wb_op op;
+
+	op.type = type;
+	op.addr = addr;
+	op.data = value;
+	op.mask = op.value = op.err_mask = 0;
+	op.retries = 0;
+
+	ops.push_back(op);
+}
+
+// Transfer planner
+// SS and CFG_BIDIR are written only if changed, CTRL configuration is known from
+// spi_init so char_len is written together with GO, only TX/RX words covered
+// by char_len are written/read; GO_BSY is polled only if shifting takes longer than
+// one link operation (otherwise transfer is over before next operation arrives)
+// Reads from 3-wire chips use bidirectional mode, data is in RX regs
+void spi_int::spi_plan(int mode, struct wb_data* data, vector<struct wb_op>& ops) {
+
+	struct wb_op poll;
+	unsigned int i, bits, words, shift_us;
+	uint32_t bidir = 0, rx_reg = SPI_RX_MISO_0;
+	int op_time = wb_master->wb_op_time_us();
+	map<uint32_t, int>::iterator mode_it;
+
+	if (mode == MODE_WRITE_READ) {
+		mode_it = read_mode.find(data->extra[0]);
+		if (mode_it != read_mode.end()) {
+			bidir = SPI_BIDIR_CFG_EN | (mode_it->second << SPI_BIDIR_CFG_CHANGE_SHIFT);
+			rx_reg = SPI_BIDIR_RX0;
 		}
 	}
 
-	// char_len is 7 bit
-	// config already done	
-	config &= 0xFFFFFF80;
-	//cout << "cfg num " << hex << (config | (uint8_t)data->extra[1]) << endl;
-	data_.data_send[0] = config | (uint8_t)data->extra[1];
-	data_.wb_addr = core_addr | SPI_BIDIR_CTRL;
-	wb_master->wb_send_data(&data_);
+	// chip_addr - SS line
+	if (!cache_valid || ss_cache != data->extra[0]) {
+		batch_op(ops, WB_OP_WRITE, core_addr | SPI_BIDIR_SS, data->extra[0]);
+		ss_cache = data->extra[0];
+	}
+
+	if (!cache_valid || bidir_cache != bidir) {
+		batch_op(ops, WB_OP_WRITE, core_addr | SPI_BIDIR_CFG_BIDIR, bidir);
+		bidir_cache = bidir;
+	}
 
-	// transfer start
-	data_.wb_addr = core_addr | SPI_BIDIR_CTRL;
-	wb_master->wb_read_data(&data_);
-	config = data_.data_read[0];
+	cache_valid = 1;
 
+	// char_len = 0 - maximum length
+	bits = data->extra[1] ? data->extra[1] : SPI_MAX_BITS;
+	words = (bits + 31) / 32;
 
-	data_.data_send[0] = config | SPI_BIDIR_CTRL_GO_BSY;
+	// write data to TX regs, words beyond char_len are not shifted out
+	if (mode == MODE_WRITE || mode == MODE_WRITE_READ)
+		for (i = 0; i < data->data_send.size() && i < words; i++)
+			// word registers follow each other (TX0 - TX3)
+			batch_op(ops, WB_OP_WRITE, core_addr | (SPI_BIDIR_TX0 + (i << WB_GR_SHIFT)), data->data_send[i]);
 
-	//cout << "cfg start " << hex << data_.data_send[0] << endl;
+	// char_len is 7 bit, transfer start
+	batch_op(ops, WB_OP_WRITE, core_addr | SPI_BIDIR_CTRL, ctrl_cfg | data->extra[1] | SPI_BIDIR_CTRL_GO_BSY);
 
-	data_.wb_addr = core_addr | SPI_BIDIR_CTRL;
-	wb_master->wb_send_data(&data_);
+	shift_us = sclk_freq > 0 ? (bits * 1000000 + sclk_freq - 1) / sclk_freq : 0;
 
 	// check if done (GO == 0)
-	while(1) {
+	if (sclk_freq == 0 || op_time == 0 || shift_us >= (unsigned int)op_time) {
+		poll.type = WB_OP_POLL;
+		poll.addr = core_addr | SPI_BIDIR_CTRL;
+		poll.data = 0;
+		poll.mask = SPI_BIDIR_CTRL_GO_BSY;
+		poll.value = 0;
+		poll.err_mask = 0;
+		// status read takes at least 1 us
+		poll.retries = std::max((unsigned int)SPI_POLL_RETRIES, shift_us);
+		ops.push_back(poll);
+	}
 
-		data_.wb_addr = core_addr | SPI_BIDIR_CTRL;
-		wb_master->wb_read_data(&data_);
+	// get data
+	if (mode == MODE_READ || mode == MODE_WRITE_READ)
+		for (i = 0; i < words; i++)
+			batch_op(ops, WB_OP_READ, core_addr | (rx_reg + (i << WB_GR_SHIFT)), 0);
+}
 
-		if ( (data_.data_read[0] & SPI_BIDIR_CTRL_GO_BSY) == 0)
-			break;
+// Read data of executed plan, after error state of core is unknown
+int spi_int::spi_done(vector<struct wb_op>& ops, struct wb_data* data, int err) {
 
-		usleep(1000);
-		repeat++;
+	unsigned int i;
 
-		if (repeat > MAX_REPEAT) {
-			// write status register
-			cout << "spi_drv: spi write transfer error (timeout)" << endl;
-			err = 1;
-			return err;
-		}
+	data->data_read.clear();
+
+	if (err) {
+		cache_valid = 0;
+		cout << "spi_drv: spi transfer error (0x" << hex << err << ")" << endl;
+		return err;
 	}
 
-	//cout << "spi_drv: spi transfer done" << endl;
-	data_.data_read.clear();
+	for (i = 0; i < ops.size(); i++)
+		if (ops[i].type == WB_OP_READ)
+			data->data_read.push_back(ops[i].data);
+
+	return 0;
+}
+
+int spi_int::spi_transfer(int mode, struct wb_data* data) {
+
+	vector<struct wb_op> ops;
+	int err;
+
 	data->data_read.clear();
-	// get data
-	for (i = 0; i < 4; i++) {
-		//data_.wb_addr = core_addr | (SPI_BIDIR_RX0 + REGS_ADDR_MULTIPLY*i); // i or 4*i, depending on address space (0,1,2,3 or 0,4,8,c)
-		data_.wb_addr = core_addr | (SPI_RX_MISO_0 + REGS_ADDR_MULTIPLY*i); // i or 4*i, depending on address space (0,1,2,3 or 0,4,8,c)
-		wb_master->wb_read_data(&data_);
-		data->data_read.push_back(data_.data_read[0]);
-		//cout << "data spi: 0x" << hex << data_.data_read[0] << endl;
+
+	if (data->extra[1] > SPI_CTRL_CHAR_LEN) {
+		cout << "spi_drv: spi char len error" << endl;
+		return 1;
 	}
 
+	spi_plan(mode, data, ops);
+
+	err = wb_master->wb_exec(ops);
+
+	return spi_done(ops, data, err);
+}
+
+// Transfers on one core are serialized, different cores may be used in parallel
+int spi_int::spi_transfer_locked(int mode, struct wb_data* data) {
+
+	int err;
+
+	pthread_mutex_lock(&lock);
+	err = spi_transfer(mode, data);
+	pthread_mutex_unlock(&lock);
+
+	return err;
+}
+
+// Same plan as spi_transfer, core is locked until int_complete
+int spi_int::int_prepare(struct wb_job* job, vector<struct wb_op>& ops) {
+
+	int mode;
+
+	// messages are I2C only, bad char len is reported by spi_transfer
+	if (job->type == WB_JOB_TRANSFER || job->data.extra[1] > SPI_CTRL_CHAR_LEN)
+		return 1;
+
+	if (job->type == WB_JOB_SEND)
+		mode = MODE_WRITE;
+	else if (job->type == WB_JOB_READ)
+		mode = MODE_READ;
+	else
+		mode = MODE_WRITE_READ;
+
+	pthread_mutex_lock(&lock);
+
+	spi_plan(mode, &job->data, ops);
+
 	return 0;
+}
+
+int spi_int::int_complete(struct wb_job* job, vector<struct wb_op>& ops, int err) {
+
+	err = spi_done(ops, &job->data, err);
+
+	pthread_mutex_unlock(&lock);
+
+	return err;
+}
+
+// Wishbone access to core registers
+// err = 0, everything ok
+// err != 0, Wishbone master error (WB_STATUS_*)
+int spi_int::wb_write(uint32_t reg, uint32_t value) {
+
+	data_.data_send[0] = value;
+	data_.wb_addr = core_addr | reg;
+
+	return wb_master->wb_send_data(&data_);
+}
+
+int spi_int::wb_read(uint32_t reg) {
+
+	int err;
+
+	data_.wb_addr = core_addr | reg;
+	err = wb_master->wb_read_data(&data_);
+
+	if (err == 0 && data_.data_read.size() == 0)
+		err = WB_STATUS_NO_RESPONSE;
 
+	return err;
 }
 
 int spi_int::int_send_data(struct wb_data* data) {
 
-	return spi_transfer(MODE_WRITE, data);
+	return spi_transfer_locked(MODE_WRITE, data);
 
 }
 int spi_int::int_read_data(struct wb_data* data) {
 
-	return spi_transfer(MODE_READ, data);
+	return spi_transfer_locked(MODE_READ, data);
 
 }
 
 int spi_int::int_send_read_data(struct wb_data* data) {
 
-	return spi_transfer(MODE_WRITE_READ, data);
+	return spi_transfer_locked(MODE_WRITE_READ, data);
 
 }
@@ -10,6 +10,9 @@
 
 #include "data.h"
 
+#include <pthread.h>
+#include <map>
+
 /* SPI BIDIR register */
 #define SPI_BIDIR_RX0        (0x00 << WB_GR_SHIFT) // 0
 #define SPI_BIDIR_RX1        (0x01 << WB_GR_SHIFT) // 1
@@ -37,6 +40,10 @@
 #define SPI_BIDIR_CTRL_RX_NEG 0x0200
 #define SPI_BIDIR_CTRL_GO_BSY 0x0100
 
+/* SPI BIDIR CFG_BIDIR fields */
+#define SPI_BIDIR_CFG_EN 0x01 // MOSI line turns around during transfer (3-wire)
+#define SPI_BIDIR_CFG_CHANGE_SHIFT 1 // bits sent before MOSI becomes input
+
 using namespace std;
 
 // extra field [0] - spi chip address
@@ -47,24 +54,48 @@ public:
 
   // proper destructor implementation!
   spi_int();
-  ~spi_int() {};
+  ~spi_int();
 
   int spi_init(int sys_freq, int spi_freq, int config); // config frequency (in Hz)
 
+  // Read mode of chip (send + read transfers)
+  // tx_bits = 0 - data read from MISO line (4-wire, default)
+  // tx_bits > 0 - 3-wire chip (like ISLA216P), MOSI line turns around after
+  //   tx_bits (instruction), data is read back from shift register
+  int spi_set_read_mode(uint32_t chip_select, int tx_bits);
+
   int int_reg(WBMaster_unit* wb_master, uint32_t core_addr);
 
   int int_send_data(struct wb_data* data);
   int int_read_data(struct wb_data* data);
   int int_send_read_data(struct wb_data* data);
 
+  // transfer run by scheduler (commLink::fmc_schedule)
+  int int_prepare(struct wb_job* job, vector<struct wb_op>& ops);
+  int int_complete(struct wb_job* job, vector<struct wb_op>& ops, int err);
+
 private:
 
   int spi_transfer(int mode, struct wb_data* data);
+  void spi_plan(int mode, struct wb_data* data, vector<struct wb_op>& ops);
+  int spi_done(vector<struct wb_op>& ops, struct wb_data* data, int err);
+  int spi_transfer_locked(int mode, struct wb_data* data);
+
+  // core register access, read value is in data_.data_read[0]
+  int wb_write(uint32_t reg, uint32_t value);
+  int wb_read(uint32_t reg);
 
   WBMaster_unit* wb_master;
   uint32_t core_addr;
+  uint32_t ctrl_cfg; // CTRL written by spi_init (without char_len and GO)
+  int sclk_freq; // SPI clock (Hz)
+  uint32_t ss_cache; // SS register, valid only with cache_valid
+  uint32_t bidir_cache; // CFG_BIDIR register, valid only with cache_valid
+  int cache_valid;
+  map<uint32_t, int> read_mode; // chip select -> turnaround bit (3-wire chips)
 
   wb_data data_;
+  pthread_mutex_t lock; // one transfer at a time on this core
 
 };
 
@@ -56,6 +56,11 @@
 #define LM75A_ADDR_1                    (0x49)
 #define LM75A_ADDR_2                    (0x48)
 
+// Clock frequencies [Hz]
+#define SI571_FOUT_FACTORY              155488221LL // measured startup frequency
+#define SI571_FOUT                      113376415LL // ADC clock
+#define AD9510_REFIN_FREQ               11337642LL // reference clock on AD9510 REFIN input
+
 // Wishbone control register addresses
 #define WB_FMC_STATUS                   (0x00 << WB_GR_SHIFT)
 #define WB_TRG_CTRL                     (0x01 << WB_GR_SHIFT)
@@ -73,6 +78,13 @@
 #define WB_DATA3                        (0x0D << WB_GR_SHIFT)
 #define WB_FPGA_DCM_CTRL                (0x0E << WB_GR_SHIFT)
 
+// Control register fields (gpio_field masks)
+#define WB_CLK_CTRL_SI571_OE            0x01 // Si571 output enable
+#define WB_CLK_CTRL_AD9510_FUNC         0x02 // AD9510 function pin (reset, active low)
+#define WB_MONITOR_CTRL_TEMP_ALARM      0x01 // LM75A temperature alarm (read only)
+#define WB_MONITOR_CTRL_LEDS            0x0E // front panel LEDs
+#define WB_FPGA_CTRL_IDELAYCTRL_RST     0x01 // IDELAYCTRL reset
+
 // DSP control register addresses
 #include "pos_calc_regs.h"
 // DSP control register addresses
@@ -49,10 +49,18 @@
 #define SI571_ADDR 0x49
 #define AD9510_ADDR 0x01
 #define AMC7823_ADDR 0x01
+#define EEPROM_ADDR 0x50
 #define ISLA_ADC0_ADDR 0x01
 #define ISLA_ADC1_ADDR 0x02
 #define ISLA_ADC2_ADDR 0x04
 #define ISLA_ADC3_ADDR 0x08
+// all ADC chips (broadcast write)
+#define ISLA_ADC_ALL_ADDR (ISLA_ADC0_ADDR | ISLA_ADC1_ADDR | ISLA_ADC2_ADDR | ISLA_ADC3_ADDR)
+
+// Clock frequencies [Hz]
+#define SI571_FOUT_FACTORY 155485700LL // measured startup frequency
+#define SI571_FOUT 208927174LL // ADC clock
+#define AD9510_REFIN_FREQ 20892717LL // reference clock on AD9510 REFIN input
 
 // Wishbone control register addresses
 #define WB_FMC_STATUS 0x00
@@ -70,4 +78,14 @@
 #define WB_DATA2 0x0C
 #define WB_DATA3 0x0D
 
+// Control register fields (gpio_field masks)
+#define WB_ADC_ISLA_CTRL_DIVCLKRST 0x01 // ISLA216P clock divider reset (active low)
+#define WB_ADC_ISLA_CTRL_RESET 0x02 // ISLA216P reset (active low)
+#define WB_ADC_ISLA_CTRL_SLEEP 0x0C // ISLA216P power mode
+#define WB_CLK_CTRL_SI571_OE 0x01 // Si571 output enable
+#define WB_CLK_CTRL_AD9510_FUNC 0x02 // AD9510 function pin (reset, active low)
+#define WB_MONITOR_CTRL_DAV 0x01 // AMC7823 data available (active low, read only)
+#define WB_MONITOR_CTRL_LEDS 0x0E // front panel LEDs
+#define WB_FPGA_CTRL_IDELAYCTRL_RST 0x01 // IDELAYCTRL reset
+
 #endif /* FMC_ADC_250M_4CH_REG_MAP_H_ */
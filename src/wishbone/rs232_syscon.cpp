@@ -5,23 +5,63 @@
 //============================================================================
 #include "rs232_syscon.h"
 
-enum { STATUS_NONE, STATUS_SEND_ERR, STATUS_OK, STATUS_UNKNOWN_CMD_ERR, STATUS_ADDR_ERR, STATUS_DATA_ERR,
-  STATUS_Q_ERR, STATUS_TIMEOUT_ERR, STATUS_CMD_ERR, STATUS_ACK_ERR, STATUS_PORT_ERR, STATUS_REPEAT };
-
 enum { TRYB_READ, TRYB_WRITE };
 
-#define MAX_REPEAT 10
-
-#define STATUS_OK 0
-#define STATUS_ERR 1
+// Default retry policy (see set_retry)
+#define RS232_RETRY_MAX 10
+#define RS232_RETRY_BACKOFF_US 1000
+#define RS232_RETRY_BACKOFF_MAX_US 200000
 
 #define MODE_READ 0
 #define MODE_WRITE 1
 
-rs232_syscon_driver::rs232_syscon_driver() {
+// Baud rates tried while negotiating link speed (fastest first)
+// rs232_syscon core detects speed by itself (auto-baud on carriage return)
+// rates not supported by the host are skipped (serial_port::set_baud fails)
+static const int rs232_baud_rates[] = { 921600, 460800, 230400, 115200, 57600, 38400, 19200, 9600 };
+
+#define RS232_NUM_BAUD_RATES (sizeof(rs232_baud_rates)/sizeof(rs232_baud_rates[0]))
+#define RS232_BAUD_DEFAULT 57600
+
+// Response timing
+// whole response (echo, data, status) has to arrive in this time
+#define RS232_RESPONSE_TIMEOUT_US 100000
+// init mode (no status expected) - line is considered idle after this time
+#define RS232_IDLE_TIMEOUT_US 10000
+#define RS232_BUF_SIZE 256
+
+// Requests sent ahead of responses in wb_exec, depths tried while
+// negotiating (deepest first), 1 - no pipelining (core without input buffering)
+static const int rs232_pipeline_depths[] = { 8, 4, 2 };
+
+#define RS232_NUM_PIPELINE_DEPTHS (sizeof(rs232_pipeline_depths)/sizeof(rs232_pipeline_depths[0]))
+#define RS232_PIPELINE_DEPTH 1
+// shortest request ("r <addr>\r"), line time of it is the minimum time
+// between two operations reaching the bus
+#define RS232_MIN_REQUEST_CHARS 8
+// start + 8 data + stop bits
+#define RS232_BITS_PER_CHAR 10
+
+rs232_syscon_driver::rs232_syscon_driver(string port, uint32_t probe_addr) {
 
   debug = 0;
 
+  this->port = port;
+  this->probe_addr = probe_addr;
+  baud_rate = RS232_BAUD_DEFAULT;
+
+  retry.max_repeat = RS232_RETRY_MAX;
+  retry.backoff_us = RS232_RETRY_BACKOFF_US;
+  retry.backoff_max_us = RS232_RETRY_BACKOFF_MAX_US;
+  pipeline_depth = RS232_PIPELINE_DEPTH;
+
+  // recursive - batch may use single requests (polling)
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&lock, &attr);
+  pthread_mutexattr_destroy(&attr);
+
   init();
   reset();
 
@@ -31,7 +71,8 @@ rs232_syscon_driver::rs232_syscon_driver() {
 
 rs232_syscon_driver::~rs232_syscon_driver() {
 
-  serial_port.Close();
+  serial.close_port();
+  pthread_mutex_destroy(&lock);
 }
 
 int rs232_syscon_driver::reset() {
@@ -49,21 +90,17 @@ int rs232_syscon_driver::reset() {
   init_state = 0;
   debug = 0;
 
-  return STATUS_OK;
+  return WB_STATUS_OK;
 
 }
 
 int rs232_syscon_driver::init() {
 
-  string rs232_port;
-
   cout << "RS232_syscon: Init function - WB Master Component" << endl;
   cout << "RS232_syscon: RS-232 interface configuration in progress..." << endl;
 
-  rs232_port = RS232_PORT;
-
-  serial_port.Open(rs232_port.c_str()) ;
-  if ( ! serial_port.good() )
+  // raw mode: 8 data bits, no parity, 1 stop bit, no flow control
+  if ( serial.open_port(port.c_str()) != 0 )
   {
     cout << "[" << __FILE__ << ":" << __LINE__ << "] "
         << "RS232_syscon: Error - can't open RS-232 port. Maybe you did not run as sudo?"
@@ -71,63 +108,213 @@ int rs232_syscon_driver::init() {
     exit(1) ;
   }
   //
-  // Set the baud rate of the serial port.
+  // Set the default baud rate of the serial port (negotiated later).
   //
-  //serial_port.SetBaudRate( SerialStreamBuf::BAUD_115200 ) ; // not working on my machine
-  serial_port.SetBaudRate( SerialStreamBuf::BAUD_57600  ) ;
-  if ( ! serial_port.good() )
+  if ( baud_set(RS232_BAUD_DEFAULT) != 0 )
   {
     cout << "RS232_syscon: Error - can't set transmission speed" << std::endl ;
     exit(1) ;
   }
+
+  init_state = 1;
+
   //
-  // Set the number of data bits.
+  // Find the fastest speed the link works with.
   //
-  serial_port.SetCharSize( SerialStreamBuf::CHAR_SIZE_8 ) ;
-  if ( ! serial_port.good() )
+  if ( baud_negotiate() != 0 )
   {
-    cout << "RS232_syscon: Error - can't set number of bits" << std::endl ;
-    exit(1) ;
+    cout << "RS232_syscon: Warning - baud rate negotiation failed, falling back to "
+        << dec << RS232_BAUD_DEFAULT << " baud" << std::endl ;
+
+    baud_set(RS232_BAUD_DEFAULT);
   }
+
+  cout << "RS232_syscon: Link speed: " << dec << baud_rate << " baud" << endl;
+
   //
-  // Disable parity.
+  // Find how many requests the core accepts ahead of responses.
   //
-  serial_port.SetParity( SerialStreamBuf::PARITY_NONE ) ;
-  if ( ! serial_port.good() )
-  {
-    cout << "RS232_syscon: Error - can't set parity bit" << std::endl ;
-    exit(1) ;
+  pipeline_negotiate();
+
+  cout << "RS232_syscon: Pipeline depth: " << dec << pipeline_depth << endl;
+
+  return WB_STATUS_OK;
+
+}
+
+int rs232_syscon_driver::baud_negotiate() {
+
+  int cached;
+  unsigned int i;
+
+  // no register to probe, stay with default speed
+  if (probe_addr == 0x0)
+    return 1;
+
+  // rate which worked last time for this port
+  cached = baud_cache_read();
+
+  if (cached > 0 && baud_set(cached) == 0 && baud_probe() == 0)
+    return 0;
+
+  for (i = 0; i < RS232_NUM_BAUD_RATES; i++) {
+
+    if (rs232_baud_rates[i] == cached)
+      continue;
+
+    if (baud_set(rs232_baud_rates[i]) != 0)
+      continue;
+
+    if (baud_probe() == 0) {
+      baud_cache_write(baud_rate);
+      return 0;
+    }
+
+    if (debug == 1)
+      cout << "RS232_syscon: No response at " << dec << rs232_baud_rates[i] << " baud" << endl;
   }
-  //
-  // Set the number of stop bits.
-  //
-  serial_port.SetNumOfStopBits( 1 ) ;
-  if ( ! serial_port.good() )
-  {
-    cout << "RS232_syscon: Error - can't set number of stop bits"
-        << std::endl ;
-    exit(1) ;
+
+  return 1;
+}
+
+int rs232_syscon_driver::baud_set(int rate) {
+
+  // not supported by host/adapter
+  if (serial.set_baud(rate) != 0)
+    return 1;
+
+  baud_rate = rate;
+  return 0;
+}
+
+int rs232_syscon_driver::baud_probe() {
+
+  wb_data probe;
+  ostringstream string_addr;
+  int err;
+
+  // let rs232_syscon core detect the new speed (as in reset)
+  init_state = 1;
+  send_interface((char*)"i\r", &dane_);
+  send_interface((char*)"i\r", &dane_);
+
+  // single read request, no repeating
+  probe.wb_addr = probe_addr;
+  probe.status = -1;
+  mode = MODE_READ;
+
+  string_addr << hex << probe_addr;
+  polecenie = std::string("r " + string_addr.str() + "\r");
+
+  serial.flush_input();
+  rx_buf.clear();
+  if (serial.write_all(polecenie.c_str(), polecenie.size()) != 0)
+    return 1;
+
+  init_state = 0;
+  err = read_interface(&probe);
+  init_state = 1;
+
+  if (err != 0 || probe.status != WB_STATUS_OK || probe.data_read.size() == 0)
+    return 1;
+
+  return 0;
+}
+
+int rs232_syscon_driver::pipeline_negotiate() {
+
+  unsigned int i;
+
+  pipeline_depth = RS232_PIPELINE_DEPTH;
+
+  // no register to probe, stay with request/response
+  if (probe_addr == 0x0)
+    return 1;
+
+  for (i = 0; i < RS232_NUM_PIPELINE_DEPTHS; i++) {
+
+    if (pipeline_probe(rs232_pipeline_depths[i]) == 0) {
+      pipeline_depth = rs232_pipeline_depths[i];
+      return 0;
+    }
+
+    if (debug == 1)
+      cout << "RS232_syscon: No pipelining at depth " << dec << rs232_pipeline_depths[i] << endl;
   }
-  //
-  // Turn off hardware flow control.
-  //
-  serial_port.SetFlowControl( SerialStreamBuf::FLOW_CONTROL_NONE ) ;
-  if ( ! serial_port.good() )
-  {
-    cout << "RS232_syscon: Error - can't set flow control (handshaking)"
-        << std::endl ;
-    exit(1) ;
+
+  return 1;
+}
+
+int rs232_syscon_driver::pipeline_probe(int depth) {
+
+  vector<struct wb_op> ops(depth);
+  int state = init_state;
+  int err, i;
+
+  // same register read back-to-back, core without input buffering drops
+  // some of the requests (no response)
+  for (i = 0; i < depth; i++) {
+    ops[i].type = WB_OP_READ;
+    ops[i].addr = probe_addr;
+    ops[i].data = 0;
   }
 
-  init_state = 1;
+  pipeline_depth = depth;
+  init_state = 0;
+  err = exec_pipelined(ops);
+  init_state = state;
+  pipeline_depth = RS232_PIPELINE_DEPTH;
+
+  // let core drop partial request left after failed probe (as in reset)
+  if (err != 0) {
+    init_state = 1;
+    send_interface((char*)"i\r", &dane_);
+    init_state = state;
+    return 1;
+  }
 
-  return STATUS_OK;
+  return 0;
+}
 
+// cache file keeps rate negotiated for the port (like /tmp/rs232_syscon_ttyUSB0.baud)
+static string baud_cache_path(string port) {
+
+  return std::string(RS232_BAUD_CACHE_DIR) + "/rs232_syscon_" +
+      port.substr(port.rfind('/') + 1) + ".baud";
+}
+
+int rs232_syscon_driver::baud_cache_read() {
+
+  ifstream cache(baud_cache_path(port).c_str());
+  int rate = 0;
+
+  if (!cache.good())
+    return 0;
+
+  cache >> rate;
+
+  if (cache.fail())
+    return 0;
+
+  return rate;
+}
+
+void rs232_syscon_driver::baud_cache_write(int rate) {
+
+  ofstream cache(baud_cache_path(port).c_str());
+
+  if (!cache.good())
+    return;
+
+  cache << rate << endl;
 }
 
 int rs232_syscon_driver::wb_send_data(struct wb_data* data) {
 
   ostringstream string_addr, string_data;
+  int err;
+
+  pthread_mutex_lock(&lock);
 
   mode = MODE_WRITE;
 
@@ -143,11 +330,13 @@ int rs232_syscon_driver::wb_send_data(struct wb_data* data) {
   if (debug == 1)
     cout << "RS232_syscon: Data sent: " << polecenie;
 
-  send_interface(polecenie, data);
-
   //debug = 0;
 
-  return STATUS_OK;
+  err = send_interface(polecenie, data);
+
+  pthread_mutex_unlock(&lock);
+
+  return err;
 
 }
 
@@ -155,6 +344,9 @@ int rs232_syscon_driver::wb_read_data(struct wb_data* data) {
 
   string txt;
   ostringstream string_addr;
+  int err;
+
+  pthread_mutex_lock(&lock);
 
   mode = MODE_READ;
   data->data_read.clear();
@@ -174,58 +366,259 @@ int rs232_syscon_driver::wb_read_data(struct wb_data* data) {
   if (debug == 1)
     cout << "Data sent on Wishbone bus: " << txt;
 
-  send_interface(polecenie, data);
-
   //debug = 0;
 
-  return STATUS_OK;
+  err = send_interface(polecenie, data);
+
+  pthread_mutex_unlock(&lock);
+
+  return err;
 
 }
 
+// Response is complete when status is received (write) or
+// data field is received (read) - no need to wait for timeout
+// return - position after the response, 0 - not complete
+size_t rs232_syscon_driver::response_complete(const string& data_str, struct wb_data* data) {
 
-int rs232_syscon_driver::send_interface(string polecenie, struct wb_data* data) {
+  size_t data_pos, end;
+  ostringstream str_addr;
+  string dane_temp;
+  unsigned int i;
 
-  static int i_repeat = 0;
+  if ((data_pos = data_str.find("\r\r\n")) == string::npos)
+    return 0;
 
-  serial_port.write(polecenie.c_str(), polecenie.size());
+  // error codes (C? A? D? Q? B! ? !)
+  if ((end = data_str.find_first_of("?!", data_pos)) != string::npos)
+    return end + 1;
 
-  usleep(10000);//usleep(50000);
-  //sleep(1);
+  if (mode == MODE_WRITE || data == NULL) {
+    if ((end = data_str.find("OK", data_pos)) == string::npos)
+      return 0;
+    return end + 2;
+  }
 
-  if (serial_port.bad()) {
-    cout << "RS232_syscon: write() failed!" << endl;
-    cout << "Check connection and restart application" << endl;
+  str_addr << hex << data->wb_addr;
+  dane_temp = str_addr.str();
+
+  for (i = 0; i < dane_temp.size(); i++)
+    dane_temp[i] = toupper((int)dane_temp[i]);
+
+  dane_temp += " : ";
+
+  if ((data_pos = data_str.find(dane_temp, data_pos)) == string::npos)
+    return 0;
+
+  // 8 hex digits of data
+  end = data_pos + dane_temp.size() + 8;
+
+  if (data_str.size() < end)
+    return 0;
+
+  return end;
+}
+
+void rs232_syscon_driver::set_retry(struct wb_retry retry) {
+
+  this->retry = retry;
+}
+
+void rs232_syscon_driver::set_pipeline(int depth) {
+
+  pipeline_depth = std::max(depth, 1);
+}
+
+int rs232_syscon_driver::wb_op_time_us() {
+
+  return (RS232_MIN_REQUEST_CHARS * RS232_BITS_PER_CHAR * 1000000 + baud_rate - 1) / baud_rate;
+}
+
+string rs232_syscon_driver::op_request(const struct wb_op& op) {
+
+  ostringstream req;
+
+  req << hex;
+
+  if (op.type == WB_OP_WRITE)
+    req << "w " << op.addr << " " << op.data << "\r";
+  else
+    req << "r " << op.addr << "\r";
+
+  return req.str();
+}
+
+// Requests of batch are sent in groups (up to pipeline_depth), then responses
+// are read in order. Group ends at poll operation, as next operations depend on it.
+// Errors are not repeated here - request may have been executed already,
+// caller decides what to do (like I2C driver running transaction again)
+int rs232_syscon_driver::wb_exec(vector<struct wb_op>& ops) {
+
+  int err;
+
+  // request by request, other threads may use the link in between
+  if (pipeline_depth <= 1)
+    return WBMaster_unit::wb_exec(ops);
+
+  pthread_mutex_lock(&lock);
+  err = exec_pipelined(ops);
+  pthread_mutex_unlock(&lock);
+
+  return err;
+}
+
+int rs232_syscon_driver::exec_pipelined(vector<struct wb_op>& ops) {
+
+  wb_data op_data;
+  string requests;
+  unsigned int i, j, last;
+  int err;
+
+  for (i = 0; i < ops.size(); i = last + 1) {
+
+    requests.clear();
+
+    for (last = i; ; last++) {
+
+      requests += op_request(ops[last]);
+
+      if (ops[last].type == WB_OP_POLL || last + 1 == ops.size() ||
+          last + 1 - i == (unsigned int)pipeline_depth)
+        break;
+    }
+
+    serial.flush_input();
+    rx_buf.clear();
+
+    if (serial.write_all(requests.c_str(), requests.size()) != 0) {
+      cout << "RS232_syscon: write() failed!" << endl;
+      return WB_STATUS_SEND_ERR;
+    }
+
+    for (j = i; j <= last; j++) {
+
+      mode = (ops[j].type == WB_OP_WRITE) ? MODE_WRITE : MODE_READ;
+      op_data.wb_addr = ops[j].addr;
+      op_data.data_read.clear();
+
+      err = read_interface(&op_data);
+      if (err)
+        return err;
+
+      if (ops[j].type == WB_OP_WRITE)
+        continue;
+
+      if (op_data.data_read.size() == 0)
+        return WB_STATUS_NO_RESPONSE;
 
-    data->status = STATUS_SEND_ERR;
-    exit(1);
+      ops[j].data = op_data.data_read[0];
+    }
+
+    // poll not finished with first read
+    if (ops[last].type == WB_OP_POLL) {
+
+      err = wb_poll_status(ops[last]);
+
+      if (err < 0 && ops[last].retries > 0) {
+        ops[last].retries--;
+        err = wb_exec_op(ops[last]);
+      }
+      else if (err < 0)
+        err = WB_STATUS_CHECK_ERR;
+
+      if (err)
+        return err;
+    }
   }
 
+  return WB_STATUS_OK;
+}
+
+// Reopen port after link was lost (like USB-serial adapter reset)
+int rs232_syscon_driver::reconnect() {
+
+  int state = init_state;
+
+  cout << "RS232_syscon: Reopening " << port << "..." << endl;
+
+  if (serial.open_port(port.c_str()) != 0 || serial.set_baud(baud_rate) != 0) {
+    cout << "RS232_syscon: Error - can't reopen RS-232 port" << endl;
+    return WB_STATUS_PORT_ERR;
+  }
+
+  // let rs232_syscon core detect speed again
+  init_state = 1;
+  send_request((char*)"i\r", &dane_);
+  send_request((char*)"i\r", &dane_);
+  init_state = state;
+
+  return WB_STATUS_OK;
+}
+
+// Single request, no repeating
+int rs232_syscon_driver::send_request(string polecenie, struct wb_data* data) {
+
+  // drop leftovers of previous response (like status sent after read data)
+  serial.flush_input();
+  rx_buf.clear();
+
+  if (mode == MODE_READ && data != NULL)
+    data->data_read.clear();
+
+  if (serial.write_all(polecenie.c_str(), polecenie.size()) != 0) {
+    cout << "RS232_syscon: write() failed!" << endl;
+
+    if (data != NULL)
+      data->status = WB_STATUS_SEND_ERR;
+
+    return WB_STATUS_SEND_ERR;
+  }
 
   // Status read (RS232_syscon: OK, ERR itp)
-  while (read_interface(data) == STATUS_REPEAT) {
+  return read_interface(data);
+}
+
+// Request is repeated (with growing wait) as long as error is transient
+// and retry policy allows it, otherwise error is returned to the caller
+int rs232_syscon_driver::send_interface(string polecenie, struct wb_data* data) {
+
+  int err, i_repeat;
+  int backoff_us = retry.backoff_us;
+
+  for (i_repeat = 0; ; i_repeat++) {
 
-    if (i_repeat >= MAX_REPEAT) {
-      cout << endl << "RS232_syscon: Exceeded maximum number of read requests to Wishbone Master driver" << endl <<
-          "RS232_syscon: Communication lost (no communication)..." << endl <<
-          "Application exits" << endl;
-      exit(1);
+    err = send_request(polecenie, data);
+
+    if (err == WB_STATUS_OK || !WB_STATUS_TRANSIENT(err))
+      break;
+
+    if (i_repeat >= retry.max_repeat) {
+      cout << endl << "RS232_syscon: Exceeded maximum number of requests to Wishbone Master driver" << endl <<
+          "RS232_syscon: Communication lost (no communication)..." << endl;
+      break;
     }
 
-    cout << endl << "RS232_syscon: Error while reading data from Wishbone bus, repeating request...";
-    i_repeat++;
-    send_interface(polecenie, data);
-  }
+    cout << endl << "RS232_syscon: Error while accessing Wishbone bus, repeating request...";
+
+    usleep(backoff_us);
+    backoff_us = std::min(2 * backoff_us, retry.backoff_max_us);
 
-  i_repeat = 0;
+    if (err == WB_STATUS_SEND_ERR || err == WB_STATUS_PORT_ERR)
+      reconnect();
+  }
 
+  if (data != NULL)
+    data->status = err;
 
-  return 0;
+  return err;
 }
 
 int rs232_syscon_driver::read_interface(struct wb_data* data) {
 
   string dane_temp;
-  char next_byte;
+  char buf[RS232_BUF_SIZE];
+  int n, wait_us;
+  size_t end;
   string data_str;
   string data_read;
   size_t data_pos;
@@ -234,26 +627,54 @@ int rs232_syscon_driver::read_interface(struct wb_data* data) {
   stringstream str_addr;
   uint32_t data_int;
 
-  data_str.clear();
+  // start with data left by previous response (pipelined requests)
+  data_str = rx_buf;
+  rx_buf.clear();
 
-  while( serial_port.rdbuf()->in_avail() > 0  )
-  {
-    serial_port.get(next_byte);
-    data_str += next_byte;
+  // Read in blocks until response is complete (or line is idle in init mode)
+  wait_us = RS232_RESPONSE_TIMEOUT_US;
+  end = 0;
+  n = 0;
 
-    //std::cout << std::hex << static_cast<int>(next_byte) << " ";
-    usleep(500);
+  if (init_state == 1)
+    wait_us = RS232_IDLE_TIMEOUT_US;
+  else
+    end = response_complete(data_str, data);
+
+  while (end == 0 && (n = serial.read_some(buf, sizeof(buf), wait_us)) > 0) {
+
+    data_str.append(buf, n);
+
+    if (init_state == 0)
+      end = response_complete(data_str, data);
+  }
+
+  if (n < 0) {
+    cout << "RS232_syscon: read() failed!" << endl;
+
+    if (data != NULL)
+      data->status = WB_STATUS_PORT_ERR;
+
+    return WB_STATUS_PORT_ERR;
   }
 
   if (init_state == 1)
-    return 0;
+    return WB_STATUS_OK;
+
+  // keep beginning of next response
+  if (end != 0) {
+    rx_buf = data_str.substr(end);
+    data_str.erase(end);
+  }
 
   // Wskaznik na poczatek wlasciwych danych
   if ((data_pos = data_str.find("\r\r\n")) == string::npos)
-    return STATUS_REPEAT;
+    return WB_STATUS_NO_RESPONSE;
 
   data_read.clear();
   data_read.assign(data_str, data_pos + 3, data_str.size() - data_pos);
+  // status is searched after the echo of request
+  data_status = data_read;
 
   if (mode == MODE_READ) {
     // odczyt danych
@@ -271,7 +692,7 @@ int rs232_syscon_driver::read_interface(struct wb_data* data) {
     dane_temp += " : ";
 
     if ((data_pos = data_read.find(dane_temp)) == string::npos)
-        return STATUS_REPEAT;
+        return WB_STATUS_NO_RESPONSE;
 
     data_read.erase(0 , data_pos + dane_temp.size()); // erase beginning of string with address
     // erase end of string with status
@@ -287,97 +708,100 @@ int rs232_syscon_driver::read_interface(struct wb_data* data) {
 
     if (debug == 1)
       cout << "RS232_syscon: Data read from Wishbone bus: " << data_read << endl;
+
+    // complete data field, status may still be on its way
+    data->status = WB_STATUS_OK;
   }
 
   // Check if no error
   //err = strstr(buffer, "OK");
-  if (data_str.find("OK") != string::npos) {
+  if (data_status.find("OK") != string::npos) {
 
     if (data != NULL)
-      data->status = STATUS_OK;
+      data->status = WB_STATUS_OK;
 
     if (debug == 1)
       cout << "RS232_syscon: Correct data transfer" << endl;
 
-    return 0;
+    return WB_STATUS_OK;
   }
 
   //err = strstr(buffer, "C?");
-  if (data_str.find("C?") != string::npos) {
+  if (data_status.find("C?") != string::npos) {
 
     if (data != NULL)
-      data->status = STATUS_UNKNOWN_CMD_ERR;
+      data->status = WB_STATUS_UNKNOWN_CMD_ERR;
 
     cout << "RS232_syscon: Unknown command" << endl;
 
-    return 1;
+    return WB_STATUS_UNKNOWN_CMD_ERR;
   }
 
   //err = strstr(buffer, "A?");
-  if (data_str.find("A?") != string::npos) {
+  if (data_status.find("A?") != string::npos) {
 
     if (data != NULL)
-      data->status = STATUS_ADDR_ERR;
+      data->status = WB_STATUS_ADDR_ERR;
 
     cout << "RS232_syscon: Invalid address field" << endl;
 
-    return 1;
+    return WB_STATUS_ADDR_ERR;
   }
 
   //err = strstr(buffer, "D?");
-  if (data_str.find("D?") != string::npos) {
+  if (data_status.find("D?") != string::npos) {
 
     if (data != NULL)
-      data->status = STATUS_DATA_ERR;
+      data->status = WB_STATUS_DATA_ERR;
 
     cout << "RS232_syscon: Invalid data field" << endl;
 
-    return 1;
+    return WB_STATUS_DATA_ERR;
   }
 
   //err = strstr(buffer, "Q?");
-  if (data_str.find("Q?") != string::npos) {
+  if (data_status.find("Q?") != string::npos) {
 
     if (data != NULL)
-      data->status = STATUS_Q_ERR;
+      data->status = WB_STATUS_Q_ERR;
 
     cout << "RS232_syscon: Invalid number of data field" << endl;
 
-    return 1;
+    return WB_STATUS_Q_ERR;
   }
 
   //err = strstr(buffer, "B!");
-  if (data_str.find("B!") != string::npos) {
+  if (data_status.find("B!") != string::npos) {
 
     if (data != NULL)
-      data->status = STATUS_TIMEOUT_ERR;
+      data->status = WB_STATUS_BUS_TIMEOUT;
 
     cout << "RS232_syscon: Timeout error (no access to Wishbone bus)" << endl;
 
-    return 1;
+    return WB_STATUS_BUS_TIMEOUT;
   }
 
   //err = strstr(buffer, "?");
-  if (data_str.find("?") != string::npos) {
+  if (data_status.find("?") != string::npos) {
 
     if (data != NULL)
-      data->status = STATUS_CMD_ERR;
+      data->status = WB_STATUS_CMD_ERR;
 
     cout << "RS232_syscon: Command which was sent was too long" << endl;
 
-    return 1;
+    return WB_STATUS_CMD_ERR;
   }
 
   //err = strstr(buffer, "!");
-  if (data_str.find("!") != string::npos) {
+  if (data_status.find("!") != string::npos) {
 
     if (data != NULL)
-      data->status = STATUS_ACK_ERR;
+      data->status = WB_STATUS_ACK_ERR;
 
     cout << "RS232_syscon: Error (err_i) or watchdog alert (no ack_i) - could be caused by invalid IP core address" << endl;
 
-    return 1;
+    return WB_STATUS_ACK_ERR;
   }
 
-  return 0;
+  return WB_STATUS_OK;
 }
@@ -7,11 +7,13 @@
 #define __RS232_SYSCON_H
 
 #include "data.h"
+#include "serial_port.h"
 
 #include <mxml.h>
-#include <SerialStream.h>
+#include <pthread.h>
 
 #include <iostream>
+#include <fstream>
 #include <unistd.h>
 #include <cstdlib>
 #include <algorithm>
@@ -19,30 +21,85 @@
 #include <stdlib.h>
 
 #define RS232_PORT "/dev/ttyUSB0"
-// -lserial
-using namespace LibSerial;
+// directory for per-port cache of the negotiated baud rate
+#define RS232_BAUD_CACHE_DIR "/tmp"
 
 class rs232_syscon_driver : public WBMaster_unit {
 public:
 
+  // port - serial device
+  // probe_addr - Wishbone register read to check the link while negotiating
+  //              baud rate (like FMC status register)
   // proper destructor implementation!
-  rs232_syscon_driver();
+  rs232_syscon_driver(string port = RS232_PORT, uint32_t probe_addr = 0x0);
   ~rs232_syscon_driver();
 
-  // return - 1 error, 0 ok
+  // return - 0 ok, WB_STATUS_* error code (data.h)
   int wb_send_data(struct wb_data* data);
-  // return - 1 error, 0 ok
+  // return - 0 ok, WB_STATUS_* error code (data.h)
   int wb_read_data(struct wb_data* data);
 
+  // how transient errors (no response, link lost) are repeated
+  // before error is returned to the caller
+  void set_retry(struct wb_retry retry);
+  struct wb_retry get_retry() { return retry; };
+
+  // batch of operations, up to pipeline depth requests are sent before
+  // responses are read (see set_pipeline)
+  int wb_exec(vector<struct wb_op>& ops);
+  // time of shortest request on the line at current baud rate
+  int wb_op_time_us();
+
+  // number of requests sent ahead of responses in wb_exec
+  // 1 - request/response, > 1 needs core with input buffering
+  // depth is negotiated while connecting (probe register), this overrides it
+  void set_pipeline(int depth);
+
+  // serial port file descriptor (for poll/epoll over many links)
+  int get_fd() { return serial.get_fd(); };
+
 private:
 
-  SerialStream serial_port;
+  serial_port serial;
+  string port;
+  uint32_t probe_addr;
+  int baud_rate;
+  struct wb_retry retry;
+  int pipeline_depth;
+  // requests from different threads (interface cores) are not interleaved
+  pthread_mutex_t lock;
+  // received data not consumed by previous response (pipelined requests)
+  string rx_buf;
 
   int init();
   int reset();
 
+  // baud rate negotiation
+  // try rates from fastest down, return 0 if link works at one of them
+  int baud_negotiate();
+  int baud_set(int rate);
+  // 0 - probe register read correctly
+  int baud_probe();
+  int baud_cache_read();
+  void baud_cache_write(int rate);
+
+  // pipeline depth negotiation
+  // largest depth at which back-to-back probe reads are all answered
+  int pipeline_negotiate();
+  // 0 - depth probe reads answered correctly
+  int pipeline_probe(int depth);
+
+  // send_interface - repeats request according to retry policy
+  // send_request - single request
   int send_interface(string polecenie, struct wb_data* data = NULL);
+  int send_request(string polecenie, struct wb_data* data = NULL);
+  int reconnect();
   int read_interface(struct wb_data* data = NULL);
+  int exec_pipelined(vector<struct wb_op>& ops);
+  // request string for batch operation
+  string op_request(const struct wb_op& op);
+  // end of response in data_str, 0 - response not complete yet
+  size_t response_complete(const string& data_str, struct wb_data* data);
 
   wb_data dane_;
   string polecenie;
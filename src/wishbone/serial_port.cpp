@@ -0,0 +1,217 @@
+//============================================================================
+// Author      : Andrzej Wojenski
+// Version     : 1.0
+// Description : Raw serial port transport (termios, non-blocking file descriptor)
+//============================================================================
+#include "serial_port.h"
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+
+// termios speed constants
+static const struct {
+  int rate;
+  speed_t speed;
+} serial_speeds[] = {
+#ifdef B921600
+  { 921600, B921600 },
+#endif
+#ifdef B460800
+  { 460800, B460800 },
+#endif
+#ifdef B230400
+  { 230400, B230400 },
+#endif
+  { 115200, B115200 },
+  { 57600,  B57600 },
+  { 38400,  B38400 },
+  { 19200,  B19200 },
+  { 9600,   B9600 }
+};
+
+#define SERIAL_NUM_SPEEDS (sizeof(serial_speeds)/sizeof(serial_speeds[0]))
+
+serial_port::serial_port() {
+
+  fd = -1;
+
+}
+
+serial_port::~serial_port() {
+
+  close_port();
+
+}
+
+int serial_port::open_port(const char* dev) {
+
+  struct termios tio;
+
+  close_port();
+
+  fd = open(dev, O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (fd < 0)
+    return 1;
+
+  if (tcgetattr(fd, &tio) != 0) {
+    close_port();
+    return 1;
+  }
+
+  // raw mode: no echo, no line editing, no character translation
+  cfmakeraw(&tio);
+
+  // 8N1, receiver on, ignore modem lines, no hardware flow control
+  tio.c_cflag &= ~(CSIZE | PARENB | CSTOPB | CRTSCTS);
+  tio.c_cflag |= CS8 | CREAD | CLOCAL;
+  // no software flow control
+  tio.c_iflag &= ~(IXON | IXOFF | IXANY);
+
+  // read() returns immediately, waiting is done with poll()
+  tio.c_cc[VMIN] = 0;
+  tio.c_cc[VTIME] = 0;
+
+  if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+    close_port();
+    return 1;
+  }
+
+  tcflush(fd, TCIOFLUSH);
+
+  return 0;
+}
+
+void serial_port::close_port() {
+
+  if (fd < 0)
+    return;
+
+  close(fd);
+  fd = -1;
+
+}
+
+int serial_port::set_baud(int rate) {
+
+  struct termios tio;
+  unsigned int i;
+
+  if (fd < 0)
+    return 1;
+
+  for (i = 0; i < SERIAL_NUM_SPEEDS; i++)
+    if (serial_speeds[i].rate == rate)
+      break;
+
+  if (i == SERIAL_NUM_SPEEDS)
+    return 1;
+
+  if (tcgetattr(fd, &tio) != 0)
+    return 1;
+
+  cfsetispeed(&tio, serial_speeds[i].speed);
+  cfsetospeed(&tio, serial_speeds[i].speed);
+
+  if (tcsetattr(fd, TCSANOW, &tio) != 0)
+    return 1;
+
+  return 0;
+}
+
+int serial_port::flush_input() {
+
+  if (fd < 0)
+    return 1;
+
+  return (tcflush(fd, TCIFLUSH) != 0);
+}
+
+int serial_port::wait_fd(short events, int timeout_us) {
+
+  struct pollfd pfd;
+  int ret;
+
+  pfd.fd = fd;
+  pfd.events = events;
+  pfd.revents = 0;
+
+  do {
+    // poll resolution is 1 ms, round up
+    ret = poll(&pfd, 1, (timeout_us + 999) / 1000);
+  } while (ret < 0 && errno == EINTR);
+
+  if (ret < 0)
+    return -1;
+
+  if (ret > 0 && (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)))
+    return -1;
+
+  return ret;
+}
+
+int serial_port::write_all(const char* buf, size_t len) {
+
+  ssize_t n;
+
+  if (fd < 0)
+    return 1;
+
+  while (len > 0) {
+
+    n = write(fd, buf, len);
+
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+
+      // driver buffer is full, wait for space
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        if (wait_fd(POLLOUT, 1000000) <= 0)
+          return 1;
+        continue;
+      }
+
+      return 1;
+    }
+
+    buf += n;
+    len -= n;
+  }
+
+  return 0;
+}
+
+int serial_port::read_some(char* buf, size_t len, int timeout_us) {
+
+  ssize_t n;
+  int ret;
+
+  if (fd < 0)
+    return -1;
+
+  // try without waiting first (data may be already in driver buffer)
+  n = read(fd, buf, len);
+
+  if (n > 0)
+    return n;
+
+  if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+    return -1;
+
+  ret = wait_fd(POLLIN, timeout_us);
+  if (ret <= 0)
+    return ret;
+
+  n = read(fd, buf, len);
+
+  if (n < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+      return 0;
+    return -1;
+  }
+
+  return n;
+}
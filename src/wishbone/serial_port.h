@@ -0,0 +1,50 @@
+//============================================================================
+// Author      : Andrzej Wojenski
+// Version     : 1.0
+// Description : Raw serial port transport (termios, non-blocking file descriptor)
+//               Used by RS232-Wishbone Master driver. File descriptor is exposed
+//               so many ports can be multiplexed with poll/epoll.
+//============================================================================
+#ifndef __SERIAL_PORT_H
+#define __SERIAL_PORT_H
+
+#include <stddef.h>
+
+class serial_port {
+public:
+
+  serial_port();
+  ~serial_port();
+
+  // return - 0 ok, 1 error
+  // raw mode, 8 data bits, no parity, 1 stop bit, no flow control
+  int open_port(const char* dev);
+  void close_port();
+  int is_open() { return fd >= 0; };
+
+  // return - 0 ok, 1 rate not supported or error
+  int set_baud(int rate);
+
+  // drop data received but not read yet
+  int flush_input();
+
+  // write whole buffer (waits while driver buffer is full)
+  // return - 0 ok, 1 error
+  int write_all(const char* buf, size_t len);
+
+  // read data which is available, waits up to timeout_us for the first byte
+  // return - number of bytes read, 0 - timeout, -1 error
+  int read_some(char* buf, size_t len, int timeout_us);
+
+  // for event loops (poll/epoll) handling many ports
+  int get_fd() { return fd; };
+
+private:
+
+  int wait_fd(short events, int timeout_us);
+
+  int fd;
+
+};
+
+#endif // __SERIAL_PORT_H
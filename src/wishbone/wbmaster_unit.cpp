@@ -0,0 +1,66 @@
+//============================================================================
+// Author      : Andrzej Wojenski
+// Version     : 1.0
+// Description : Default batch execution for Wishbone master software drivers
+//============================================================================
+#include "data.h"
+
+int WBMaster_unit::wb_poll_status(const struct wb_op& op) {
+
+  if ((op.data & op.mask) != op.value)
+    return -1;
+
+  if ((op.data & op.err_mask) != 0)
+    return WB_STATUS_CHECK_ERR;
+
+  return WB_STATUS_OK;
+}
+
+int WBMaster_unit::wb_exec_op(struct wb_op& op) {
+
+  wb_data data;
+  int err, i;
+
+  data.wb_addr = op.addr;
+
+  if (op.type == WB_OP_WRITE) {
+    data.data_send.push_back(op.data);
+    return wb_send_data(&data);
+  }
+
+  for (i = 0; ; i++) {
+
+    err = wb_read_data(&data);
+    if (err)
+      return err;
+
+    if (data.data_read.size() == 0)
+      return WB_STATUS_NO_RESPONSE;
+
+    op.data = data.data_read[0];
+
+    if (op.type == WB_OP_READ)
+      return WB_STATUS_OK;
+
+    err = wb_poll_status(op);
+    if (err >= 0)
+      return err;
+
+    if (i >= op.retries)
+      return WB_STATUS_CHECK_ERR;
+  }
+}
+
+int WBMaster_unit::wb_exec(vector<struct wb_op>& ops) {
+
+  unsigned int i;
+  int err;
+
+  for (i = 0; i < ops.size(); i++) {
+    err = wb_exec_op(ops[i]);
+    if (err)
+      return err;
+  }
+
+  return WB_STATUS_OK;
+}